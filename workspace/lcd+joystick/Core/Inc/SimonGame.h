@@ -3,6 +3,13 @@
 
 #include <stdint.h>
 #include "joystick.h"
+#include "eventq.h"
+#include "swtimer.h"
+#include "pt.h"
+
+#define SEQUENCE_MAX  100   // longest sequence, a game that reaches it is over
+#define PLAYERS_MAX   8     // players taking turns on one device
+#define PLAYER_NONE   PLAYERS_MAX   // end of the elimination list
 
 typedef enum 
 {
@@ -11,41 +18,92 @@ typedef enum
   PLAYER_MENU,
   PLAYER_SELECT,
   ONE_PLAYER,
-  TWO_PLAYERS,
+  MULTI_PLAYER,
   GAME_RESULT,
   PLAY_AGAIN,
   SLEEP,
-  WAKE_UP
+  WAKE_UP,
+  MENU,             // parent of START, PLAY_AGAIN and PLAYER_MENU
+  GAME_STATE_COUNT
 } GameState ; 
 
+// Players are numbered from 0. Those still in the game form a ring through
+// nextPlayer; a player who fails is unlinked and pushed on the elimination
+// list, which reuses the same links.
 typedef struct 
 {
   uint8_t numPlayers;
   uint8_t currentPlayer;
+  uint8_t previousPlayer;             // player before currentPlayer in the ring
+  uint8_t playersLeft;                // players in the ring
+  uint8_t eliminated;                 // last player out, PLAYER_NONE while nobody is
   uint32_t sequenceSpeed;
-  uint8_t sequence[100];
+  uint8_t sequence[SEQUENCE_MAX];     // Simon's sequence, or the chain the players build
   uint8_t sequenceLength;
   uint8_t round;
-  uint8_t playerInputs[2][100];
-  uint8_t playerScores[2];
+  uint8_t nextPlayer[PLAYERS_MAX];
+  uint16_t playerScores[PLAYERS_MAX];
 } GameInfo ;
 
-typedef struct {
-    GameState state;
-    GameInfo info;
-} Game;
-
 typedef struct 
 {
-  uint8_t stable;
   uint8_t state;
   GPIO_TypeDef *port; 
   uint16_t pin;
 } Button;
 
+// Timer posting an event when it expires. The generation number travels in
+// the event parameter so events of a timer restarted since are dropped.
+typedef struct
+{
+  SWTimer timer;
+  EventQueue* queue;
+  uint8_t type;
+  volatile uint8_t gen;
+} EventTimer;
+
+typedef struct {
+    GameState state;
+    GameInfo info;
+    Joystick_HandleTypeDef* joystick;
+
+    // Shared with interrupts: the TIM2 tick debounces the buttons and the
+    // timer callbacks queue events, the main loop only reads the queue
+    volatile uint8_t ready;         // set at the end of Game_Init, TIM2 ticks before are ignored
+    EventQueue events;
+    Button buttons[4];              // color buttons and their LEDs, 0-Red 1-Blue 2-Yellow 3-Green
+    Button joystickButton;
+    uint8_t debounceTicks;          // TIM2 ticks since the buttons were last sampled
+    uint8_t toneColor;              // color of the note being played
+    volatile uint32_t pressCycles;  // DWT count when the last color press was queued
+
+    // Main loop only
+    EventTimer stateTimer, inactivityTimer, sampleTimer, scrollTimer;
+    SWTimer toneTimer, buzzerTimer;
+    PT roundPt, turnPt;             // game mode thread and the turn it is running
+    uint8_t turnIndex;
+    uint8_t awaitingButton;         // playerTurn waits for input turnIndex
+    uint8_t resultPlayer;           // next player of the scoreboard, PLAYER_NONE at its end
+    uint8_t linked;                 // one player game on the sequence Simon sent the boards
+    uint8_t peerGlyph;              // last color pressed on a linked board
+    uint16_t seed;                  // rand() seed of the next one player games, 0 reads the joystick
+    uint16_t noteMs;                // note length of Simon's sequence in a new game
+    uint16_t latencyUs;             // last color press, queued to dispatched
+    uint16_t latencyMaxUs;
+    uint8_t countdown;              // seconds left before a menu screen goes to SLEEP
+    uint8_t directionDelay;
+    JoyStickDirection lastDirection;
+} Game;
+
 void Game_Init(Game* game);
 void Game_Run(Game* game, Joystick_HandleTypeDef* joystick);
-void computerTurn(Game* game);
-void playerTurn(Game* game);
+void Game_Tick(Game* game);
+uint8_t Game_PostEvent(Game* game, uint8_t type, uint8_t param);
+int Game_AwaitedInput(const Game* game);
+void Game_SetSeed(Game* game, uint16_t seed);
+void Game_SetSpeed(Game* game, uint16_t noteMs);
+uint8_t debounceButtons(GPIO_TypeDef *port, uint16_t pin, Button *button, int pre);
+PT_THREAD(computerTurn(PT* pt, Game* game, const GameEvent* event));
+PT_THREAD(playerTurn(PT* pt, Game* game, const GameEvent* event));
 
 #endif
\ No newline at end of file
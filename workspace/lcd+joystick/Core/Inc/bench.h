@@ -0,0 +1,17 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include "joystick.h"
+
+#define BENCH_RUNS       1000   // runs of the quick kernels
+#define BENCH_SLOW_RUNS  20     // runs of the kernels that wait on the LCD, ADC or UART
+
+#ifdef SIMON_BENCH
+
+// Time every kernel with the DWT cycle counter and print one report line each on USART1
+void Bench_Run(Joystick_HandleTypeDef* joystick);
+
+#endif
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+// State of one board. The firmware is the only board it runs on, so its
+// modules keep their state in file-level variables. The host batch runner
+// of test/host plays many boards at once, one per thread, so there the
+// variables of the modules it builds are thread-local
+#ifdef SIMON_HOST
+#define BOARD_STATE  _Thread_local
+#else
+#define BOARD_STATE
+#endif
+
+#endif
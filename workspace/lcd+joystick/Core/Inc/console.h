@@ -0,0 +1,44 @@
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+#include "SimonGame.h"
+
+// Command console on USART1, built with make -f STM32Make.make CONSOLE=UART.
+// One command per line, answered with a line starting "ok" or "err":
+//
+//   press r|b|y|g      color button press, or its index 0 to 3
+//   joy up|down|press  joystick direction or switch
+//   seed N             rand() seed of the next one player games, 1 to 4095,
+//                      0 reads the joystick again
+//   speed MS           length of Simon's notes, 50 to 2000 ms
+//   info               state, GameInfo and Simon's sequence as r/b/y/g
+//   load               CPU busy over 1 s and 10 s, and the share of the
+//                      TIM2, SysTick, UART and I2C handlers, in percent
+//   isr                longest run, jitter and budget in us, and runs over
+//                      budget of each handler, as tim2=max/jitter/budget/over
+//   isr reset          clear the longest runs, jitters and runs over budget
+//   isr NAME US        budget of tim2, systick, uart or i2c, 1 to 10000 us
+#define CONSOLE_RX_SIZE     128     // circular DMA buffer, must be a power of two
+#define CONSOLE_SPEED_MIN   50
+#define CONSOLE_SPEED_MAX   2000
+#define CONSOLE_BUDGET_MAX  10000   // us, for isr NAME US
+
+#ifdef CONSOLE_UART
+
+// Start receiving commands for a game
+void Console_Init(Game* game);
+
+// Run the commands received since the last call, from the main loop
+void Console_Poll(void);
+
+// 1 if bytes arrived since the last Console_Poll, checked before sleeping
+uint8_t Console_Pending(void);
+
+// USART1 reception callbacks, from the HAL callbacks of usart.c
+void Console_RxEvent(uint16_t size);
+void Console_RxError(void);
+
+#endif
+
+#endif
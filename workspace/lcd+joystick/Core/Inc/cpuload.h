@@ -0,0 +1,88 @@
+#ifndef CPULOAD_H
+#define CPULOAD_H
+
+#include <stdint.h>
+
+/*
+ * CPU load from the time the main loop spends asleep in WFI, counted with
+ * the DWT cycle counter over windows of CPULOAD_WINDOW_MS, with the time
+ * spent in the interrupt handlers counted per source. Each handler also
+ * keeps its longest run, the jitter of its entries if it runs on a timer,
+ * and the runs over its budget.
+ */
+#define CPULOAD_WINDOW_MS   1000
+#define CPULOAD_AVERAGE     10      // windows in the long average, 10 s
+
+// Budgets of the handlers, in us. Override with -D, or at run time with
+// CpuLoad_SetBudget
+#ifndef CPULOAD_BUDGET_TIM2_US
+#define CPULOAD_BUDGET_TIM2_US      50
+#endif
+#ifndef CPULOAD_BUDGET_SYSTICK_US
+#define CPULOAD_BUDGET_SYSTICK_US   5
+#endif
+#ifndef CPULOAD_BUDGET_UART_US
+#define CPULOAD_BUDGET_UART_US      50
+#endif
+#ifndef CPULOAD_BUDGET_I2C_US
+#define CPULOAD_BUDGET_I2C_US       50
+#endif
+
+// Periods of the handlers run by a timer, for the jitter of their entries
+#define CPULOAD_PERIOD_TIM2_US      10000
+#define CPULOAD_PERIOD_SYSTICK_US   1000
+
+// Interrupt handlers timed on their own
+typedef enum
+{
+  CPULOAD_TIM2 = 0,       // button debouncing and the game tick
+  CPULOAD_SYSTICK,        // HAL tick
+  CPULOAD_UART,           // USART1, LPUART1 and their DMA channels
+  CPULOAD_I2C,            // LCD backpack transfers of LCD_I2C builds
+  CPULOAD_ISRS
+} CpuLoadIsr;
+
+// Shares of the core time, in per mille
+typedef struct
+{
+  uint16_t load;                  // busy in the last window, 1000 minus idle
+  uint16_t load10s;               // busy over the last CPULOAD_AVERAGE windows
+  uint16_t isr[CPULOAD_ISRS];     // in each handler in the last window
+} CpuLoadStats;
+
+// Timing of one handler since the start or the last CpuLoad_ResetIsrStats
+typedef struct
+{
+  uint32_t runs;
+  uint32_t maxCycles;       // longest run
+  uint32_t jitterCycles;    // largest distance of an entry from one period
+                            // after the previous entry, timer handlers only
+  uint32_t budgetCycles;    // longer runs are violations
+  uint32_t violations;
+} CpuLoadIsrStats;
+
+// Start the first window, once the cycle counter runs
+void CpuLoad_Init(void);
+
+// Add cycles spent asleep, from the idle path
+void CpuLoad_Idle(uint32_t cycles);
+
+// Account a handler run, from its end; start is Cycles_Now() on entry
+void CpuLoad_Isr(CpuLoadIsr isr, uint32_t start);
+
+// Close the window once CPULOAD_WINDOW_MS passed, from the main loop
+void CpuLoad_Update(void);
+
+// Shares of the last complete windows
+const CpuLoadStats* CpuLoad_Stats(void);
+
+// Timing of a handler
+const CpuLoadIsrStats* CpuLoad_IsrStats(CpuLoadIsr isr);
+
+// Change the budget of a handler
+void CpuLoad_SetBudget(CpuLoadIsr isr, uint32_t us);
+
+// Clear the longest runs, jitters and violations, keeping the budgets
+void CpuLoad_ResetIsrStats(void);
+
+#endif
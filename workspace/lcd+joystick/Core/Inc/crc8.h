@@ -0,0 +1,25 @@
+#ifndef CRC8_H
+#define CRC8_H
+
+#include <stdint.h>
+
+// CRC-8 with the polynomial 0x07 and no reflection, checking the frames of
+// the link and the telemetry and the records of the flash store. Continues
+// from crc, so a message in pieces gives the CRC of the whole
+static inline uint8_t Crc8_Update(uint8_t crc, const uint8_t* bytes, uint8_t length)
+{
+  while (length--)
+  {
+    crc ^= *bytes++;
+    for (uint8_t bit = 0; bit < 8; bit++)
+    { crc = (crc & 0x80) ? (uint8_t)(crc << 1) ^ 0x07 : (uint8_t)(crc << 1); }
+  }
+  return crc;
+}
+
+static inline uint8_t Crc8(const uint8_t* bytes, uint8_t length)
+{
+  return Crc8_Update(0, bytes, length);
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdint.h>
+#include "main.h"
+
+/*
+ * Core clock cycle counter of the DWT unit, for measuring short intervals.
+ * The counter wraps every 2^32 cycles, about 134 s at 32 MHz, so only
+ * differences between two readings are meaningful.
+ */
+
+// Enable and clear the cycle counter
+static inline void Cycles_Init(void)
+{
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Current cycle count
+static inline uint32_t Cycles_Now(void)
+{
+  return DWT->CYCCNT;
+}
+
+// Convert a number of cycles to nanoseconds
+static inline uint32_t Cycles_ToNs(uint32_t cycles)
+{
+  return (uint32_t)((uint64_t)cycles * 1000000000u / SystemCoreClock);
+}
+
+// Convert nanoseconds to a number of cycles, rounding up
+static inline uint32_t Cycles_FromNs(uint32_t ns)
+{
+  return (uint32_t)(((uint64_t)ns * SystemCoreClock + 999999999u) / 1000000000u);
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef EVENTQ_H
+#define EVENTQ_H
+
+#include <stdint.h>
+
+#define EVENTQ_SIZE 16   // must be a power of two
+
+typedef enum
+{
+  EV_NONE = 0,
+  EV_JOY_PRESS,      // joystick switch pressed
+  EV_JOY_UP,         // joystick pushed up
+  EV_JOY_DOWN,       // joystick pushed down
+  EV_JOY_SAMPLE,     // time to sample the joystick axes
+  EV_BUTTON,         // color button pressed, param = color index
+  EV_TIMEOUT,        // state timer expired
+  EV_INACTIVE,       // no user input for too long
+  EV_SOUND_DONE,     // note or buzzer finished
+  EV_ROUND,          // start the game mode thread
+  EV_SCROLL,         // time to move the marquee one column
+  EV_LINK,           // news from a linked board, param = LINK_EVENT(kind, arg)
+  EV_COUNT
+} GameEventType;
+
+typedef struct
+{
+  uint8_t type;
+  uint8_t param;
+} GameEvent;
+
+typedef struct
+{
+  GameEvent buffer[EVENTQ_SIZE];
+  volatile uint8_t head;     // next slot to write
+  volatile uint8_t tail;     // next slot to read
+  uint8_t peak;              // highest number of queued events seen
+  uint16_t dropped;          // events lost because the queue was full
+} EventQueue;
+
+// Empty the queue and reset its statistics
+void EventQueue_Init(EventQueue* queue);
+
+// Add an event, safe to call from interrupts. Returns 0 if the queue was full
+uint8_t EventQueue_Push(EventQueue* queue, uint8_t type, uint8_t param);
+
+// Remove the oldest event. Returns 0 if the queue was empty
+uint8_t EventQueue_Pop(EventQueue* queue, GameEvent* event);
+
+// Number of events waiting
+uint8_t EventQueue_Count(const EventQueue* queue);
+
+#endif
@@ -0,0 +1,30 @@
+#ifndef FLASHSTORE_H
+#define FLASHSTORE_H
+
+#include <stdint.h>
+#include "main.h"
+
+typedef enum
+{
+  STORE_HIGH_SCORE = 0,    // best one player score
+  STORE_BEST_ROUND,        // highest round reached in any mode
+  STORE_GAMES_PLAYED,      // number of finished games
+  STORE_JOY_CENTER,        // calibrated joystick X center
+  STORE_BOOTS,             // boots of a LINK=UART build, its HELLO boot count
+  STORE_KEY_COUNT          // at most 8 keys
+} StoreKey;
+
+// Scan the reserved flash pages and rebuild the RAM index of latest values
+void Store_Init(void);
+
+// Latest value of a key. Returns 0 if the key was never written
+uint8_t Store_Get(StoreKey key, uint32_t* value);
+
+// Append a new value for a key, compacting into the other page when full
+HAL_StatusTypeDef Store_Put(StoreKey key, uint32_t value);
+
+// ECC double error from the NMI handler. Returns 1 if it hit the store and
+// was taken care of, 0 if the NMI is not the store's
+uint8_t Store_EccError(void);
+
+#endif
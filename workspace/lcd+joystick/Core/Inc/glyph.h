@@ -0,0 +1,41 @@
+#ifndef GLYPH_H
+#define GLYPH_H
+
+#include <stdint.h>
+
+#define GLYPH_SLOTS       8      // CGRAM holds eight 5x8 glyphs
+#define GLYPH_ROWS        8      // bytes of one glyph, 5 pixels in the low bits
+#define GLYPH_CODE_BASE   0x08   // codes 0x08-0x0F show CGRAM too and are never a string end
+#define GLYPH_FULL_BLOCK  0xFF   // all pixels on, in the character ROM
+
+// Glyphs of the registry, their pixels are kept in flash
+typedef enum
+{
+  GLYPH_BAR_1 = 0,      // progress bar cell with 1 to 4 columns lit
+  GLYPH_BAR_2,
+  GLYPH_BAR_3,
+  GLYPH_BAR_4,
+  GLYPH_RED,            // color icons, 0-Red 1-Blue 2-Yellow 3-Green
+  GLYPH_BLUE,
+  GLYPH_YELLOW,
+  GLYPH_GREEN,
+  GLYPH_HOURGLASS,      // countdown
+  GLYPH_COUNT,
+  GLYPH_NONE = GLYPH_COUNT
+} GlyphId;
+
+// Forget what CGRAM holds, its content is undefined after power-up
+void Glyph_Init(void);
+
+// Character code showing the glyph, uploading it into the least recently
+// used slot if it is not resident. An upload leaves the address counter
+// in CGRAM, so set the DDRAM address before writing characters.
+uint8_t Glyph_Code(GlyphId id);
+
+// Glyph resident in a slot, GLYPH_NONE if the slot is empty
+GlyphId Glyph_Resident(uint8_t slot);
+
+// Pixel rows of a glyph of the registry
+const uint8_t* Glyph_Rows(GlyphId id);
+
+#endif
@@ -13,6 +13,7 @@ typedef struct
     uint32_t yChannel;         // ADC channel for Y-axis
     GPIO_TypeDef* buttonPort;  // GPIO port for SW
     uint16_t buttonPin;        // GPIO pin for SW
+    uint16_t centerX;          // calibrated rest position of the X axis
 } Joystick_HandleTypeDef;
 
 typedef enum 
@@ -30,8 +31,11 @@ void Joystick_Init(Joystick_HandleTypeDef* joystick,
                    GPIO_TypeDef* buttonPort,
                    uint16_t buttonPin);
 
-// Calibrate joystick to find center position
-void Joystick_Calibrate(Joystick_HandleTypeDef *joystick);
+// Calibrate joystick to find center position, returns the center
+uint16_t Joystick_Calibrate(Joystick_HandleTypeDef *joystick);
+
+// Use a stored center if a quick reading agrees with it, returns 1 if accepted
+uint8_t Joystick_UseCenter(Joystick_HandleTypeDef *joystick, uint16_t center);
 
 // Get joystick direction
 JoyStickDirection Joystick_GetDirection(Joystick_HandleTypeDef *joystick);
@@ -39,7 +43,4 @@ JoyStickDirection Joystick_GetDirection(Joystick_HandleTypeDef *joystick);
 // Read X and Y axes (0–4095)
 void Joystick_ReadXY(Joystick_HandleTypeDef* joystick, uint16_t* xy);
 
-// Check if joystick button is pressed
-uint8_t Joystick_Pressed(Joystick_HandleTypeDef* joystick);
-
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "main.h"
 #include "gpio.h"
 #include "tim.h"
+#include "lcdgeom.h"
 
 #define	pin_E	    GPIO_PIN_1
 #define	pin_RS	    GPIO_PIN_0
@@ -26,3 +27,5 @@ extern void LCD_PrintI(uint32_t num);
 extern void LCD_PrintH(uint32_t num);
 extern void LCD_PrintB8(uint8_t num);
 extern void LCD_PrintB16(uint16_t num);
+extern void LCD_Flush(void);   // start sending what was queued, I2C backpack only
+extern void LCD_Sync(void);    // wait until all of it reached the display
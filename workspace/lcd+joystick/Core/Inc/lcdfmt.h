@@ -0,0 +1,27 @@
+#ifndef LCDFMT_H
+#define LCDFMT_H
+
+#include <stdint.h>
+#include "lcdgeom.h"
+
+#define LCDFMT_COLS  LCD_COLS   // characters of one display line, the buffer holds one more
+
+/*
+ * Build display lines without the printf machinery. Every routine writes
+ * at position pos of a LCDFMT_COLS + 1 byte line, stops at the last column,
+ * keeps the line null terminated and returns the position after the text.
+ */
+
+// Append a string
+uint8_t LcdFmt_Str(char* line, uint8_t pos, const char* text);
+
+// Append an unsigned number in decimal
+uint8_t LcdFmt_Dec(char* line, uint8_t pos, uint32_t value);
+
+// Append a number right justified in a field of width columns
+uint8_t LcdFmt_DecRight(char* line, uint8_t pos, uint32_t value, uint8_t width);
+
+// Fill with spaces up to column width
+uint8_t LcdFmt_Pad(char* line, uint8_t pos, uint8_t width);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef LCDGEOM_H
+#define LCDGEOM_H
+
+/*
+ * Display geometry, fixed at compile time with make LCD_SIZE=20X4 (or
+ * 40X2), the LCM1602A 16x2 of the board otherwise. Every HD44780 display
+ * keeps two DDRAM lines of 40 characters at 0x00 and 0x40; a four row
+ * display shows the first half of each line on rows 0 and 1 and the
+ * second half on rows 2 and 3.
+ */
+
+#if defined(LCD_SIZE_20X4)
+#define LCD_COLS  20
+#define LCD_ROWS  4
+#elif defined(LCD_SIZE_40X2)
+#define LCD_COLS  40
+#define LCD_ROWS  2
+#else
+#define LCD_COLS  16
+#define LCD_ROWS  2
+#endif
+
+#define LCD_DDRAM_LINE   40     // DDRAM characters of one controller line
+#define LCD_DDRAM_LINE2  0x40   // DDRAM address of the second controller line
+
+// DDRAM address of the first column of a row
+#if LCD_ROWS > 2
+#define LCD_ROW_ADDR(row)  ((((row) & 1) ? LCD_DDRAM_LINE2 : 0) + ((row) >> 1) * LCD_COLS)
+#else
+#define LCD_ROW_ADDR(row)  ((row) << 6)
+#endif
+
+#endif
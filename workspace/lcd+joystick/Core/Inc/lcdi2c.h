@@ -0,0 +1,36 @@
+#ifndef LCDI2C_H
+#define LCDI2C_H
+
+#include <stdint.h>
+
+// Display on a PCF8574 I2C backpack instead of the six GPIO lines, built
+// with make -f STM32Make.make LCD_BUS=I2C
+#define LCDI2C_ADDRESS     (0x27 << 1)   // PCF8574 with A2..A0 open, 0x3F for a PCF8574A
+#define LCDI2C_BUFFER      256           // bytes per buffer, a 16x2 screen change fits in one
+#define LCDI2C_TIMEOUT_MS  30            // longest wait for a transfer, a full buffer takes 23 ms at 100 kHz
+
+// PCF8574 port bits on the common backpacks, DB7..DB4 on P7..P4
+#define LCDI2C_RS          0x01
+#define LCDI2C_E           0x04
+#define LCDI2C_BACKLIGHT   0x08
+
+#ifdef LCD_I2C
+
+// Empty both buffers, called by LCD_Init
+void LcdI2c_Init(void);
+
+// Append one E strobe with RS and DB7..DB4 (nibble bits 3..0) to the buffer
+void LcdI2c_Nibble(uint8_t rs, uint8_t nibble);
+
+// Hand the buffer to the DMA, now or after the transfer under way, and switch to the other one
+void LcdI2c_Flush(void);
+
+// Wait until every byte handed over so far is on the bus
+void LcdI2c_Sync(void);
+
+// Transfers dropped on a bus error or a timeout since power-on
+uint32_t LcdI2c_Dropped(void);
+
+#endif
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LCDMODEL_H
+#define LCDMODEL_H
+
+#include <stdint.h>
+#include "lcdgeom.h"
+
+// Soak builds always watch the display bus
+#if defined(SIMON_SOAK) && !defined(LCD_MODEL)
+#define LCD_MODEL
+#endif
+
+// Timing builds (VARIANT=LCDTIMING) also check every pin edge against the datasheet
+#ifdef SIMON_LCDTIMING
+#define LCD_TIMING
+#endif
+#if defined(LCD_TIMING) && !defined(LCD_MODEL)
+#define LCD_MODEL
+#endif
+
+#define LCD_MODEL_ROWS      LCD_ROWS
+#define LCD_MODEL_COLS      LCD_COLS
+#define LCD_MODEL_LINES     2                // controller lines of DDRAM
+#define LCD_MODEL_LINE_LEN  LCD_DDRAM_LINE   // DDRAM bytes per line
+
+typedef struct
+{
+  uint32_t strobes;     // E pulses, one per nibble in 4-bit mode
+  uint32_t commands;    // decoded instructions
+  uint32_t writes;      // decoded DDRAM / CGRAM data writes
+  uint32_t clears;      // clear display instructions
+} LcdModelStats;
+
+typedef enum
+{
+  LCD_LINE_RS,
+  LCD_LINE_E,
+  LCD_LINE_DATA         // DB7..DB4 as one nibble
+} LcdModelLine;
+
+typedef enum
+{
+  LCD_CHECK_TAS,        // RS set up before E rises
+  LCD_CHECK_PWEH,       // E high pulse width
+  LCD_CHECK_TCYCE,      // E cycle time
+  LCD_CHECK_TDSW,       // data set up before E falls
+  LCD_CHECK_TH,         // data held after E falls
+  LCD_CHECK_TAH,        // RS held after E falls
+  LCD_CHECK_EXEC,       // previous instruction finished before the next transfer
+  LCD_CHECK_COUNT
+} LcdModelCheck;
+
+typedef struct
+{
+  const char* name;
+  uint32_t minNs;         // datasheet minimum, 0 for the execution time check
+  uint32_t samples;       // intervals measured
+  uint32_t violations;    // intervals shorter than the minimum
+  int32_t worstMarginNs;  // smallest measured minus required time
+} LcdTimingCheck;
+
+#ifdef LCD_MODEL
+
+// Power-on state of the controller: 8-bit interface, empty display
+void LcdModel_Reset(void);
+
+// Decode the bus on the falling edge of E. nibble holds DB7..DB4 in bits 3..0
+void LcdModel_Strobe(uint8_t rs, uint8_t nibble);
+
+// Visible characters of each line, null terminated
+void LcdModel_Render(char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1]);
+
+// Bus activity since the previous call, returns 0 if the display did not change
+uint8_t LcdModel_TakeFrame(LcdModelStats* stats);
+
+// Character generator RAM, 8 glyphs of 8 rows
+const uint8_t* LcdModel_Cgram(void);
+
+// Columns the display is shifted left, 0 to LCD_MODEL_LINE_LEN - 1
+uint8_t LcdModel_Shift(void);
+
+#endif
+
+#ifdef LCD_TIMING
+#include "cycles.h"
+
+// Record a level change of one line, cycles is the DWT count when it happened
+void LcdModel_Edge(LcdModelLine line, uint8_t level, uint32_t cycles);
+
+// Results of one timing check
+const LcdTimingCheck* LcdModel_TimingCheck(LcdModelCheck check);
+
+#define LCD_EDGE(line, level)  LcdModel_Edge((line), (level), Cycles_Now())
+#else
+#define LCD_EDGE(line, level)
+#endif
+
+#endif
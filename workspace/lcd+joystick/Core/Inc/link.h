@@ -0,0 +1,114 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdint.h>
+#include "eventq.h"
+
+// Linked play between boards over LPUART1, built with
+// make -f STM32Make.make LINK=UART. Every frame on the wire is
+//
+//   SOF  node  seq  type  length  payload[length]  crc8
+//
+// with the CRC-8 (polynomial 0x07) of node to the end of the payload.
+// HELLO and ACK frames are sent once; every other frame is resent until
+// each board linked when it was first sent has acknowledged it.
+#define LINK_SOF              0x7E
+#define LINK_HEADER           5       // SOF, node, seq, type, length
+#define LINK_PAYLOAD_MAX      32
+#define LINK_FRAME_MAX        (LINK_HEADER + LINK_PAYLOAD_MAX + 1)
+#define LINK_SEQUENCE_MAX     ((LINK_PAYLOAD_MAX - 1) * 4)   // colors of a START frame
+#define LINK_PEERS_MAX        4       // other boards on the link
+#define LINK_OUTBOX           4       // frames waiting for their acknowledgements
+#define LINK_HELLO_MS         500     // heartbeat, also how the boards find each other
+#define LINK_PEER_TIMEOUT_MS  1600    // a board silent this long has left
+#define LINK_RETRY_MS         20      // resend interval of an unacknowledged frame
+#define LINK_RETRIES          5       // resends before a frame is given up
+#define LINK_RX_SIZE          256     // circular DMA buffer, must be a power of two
+#define LINK_TX_SIZE          256     // bytes queued for the DMA, must be a power of two
+
+// Frame types and their payload
+typedef enum
+{
+  LINK_HELLO = 0,     // 32-bit board id and boot count, least significant byte first
+  LINK_ACK,           // node and seq of the frame acknowledged
+  LINK_START,         // length, then the sequence four colors per byte, from Simon
+  LINK_START_REQ,     // none, asks Simon to start a linked game
+  LINK_INPUT,         // round, index and color of a press
+  LINK_SCORE          // round, score low and high byte, 1 once the game is over
+} LinkFrameType;
+
+// EV_LINK parameter, what happened in the high nibble and a detail in the low one
+#define LINK_EVENT(kind, arg)   (uint8_t)(((kind) << 4) | ((arg) & 0x0F))
+#define LINK_EVENT_KIND(param)  ((param) >> 4)
+#define LINK_EVENT_ARG(param)   ((param) & 0x0F)
+
+typedef enum
+{
+  LINK_EV_PEERS = 0,  // a board joined or left, arg = boards linked
+  LINK_EV_START,      // Simon started a linked game, Link_Sequence holds its colors
+  LINK_EV_START_REQ,  // a board asks Simon to start
+  LINK_EV_INPUT,      // a board pressed a color, arg = color
+  LINK_EV_SCORE       // a board sent its score, arg = its slot
+} LinkEventKind;
+
+typedef struct
+{
+  uint32_t rxFrames;      // frames received intact
+  uint32_t rxErrors;      // frames failing the CRC or length check, START frames
+                          // with a bad sequence length, and UART errors
+  uint32_t txDropped;     // frames that did not fit the buffers
+  uint32_t retries;       // frames resent
+  uint32_t lost;          // frames given up after LINK_RETRIES resends
+} LinkStats;
+
+#ifdef LINK_UART
+
+// Start receiving and announce the board, events go to queue
+void Link_Init(EventQueue* queue);
+
+// Decode the frames received, acknowledge them, resend and send the heartbeat.
+// Called from the main loop before it looks at the event queue.
+void Link_Poll(void);
+
+// 1 if bytes arrived since the last Link_Poll, checked before sleeping
+uint8_t Link_Pending(void);
+
+// Boards linked besides this one
+uint8_t Link_Peers(void);
+
+// 1 if this board is Simon: the one with the lowest id of those linked
+uint8_t Link_IsSimon(void);
+
+// Send the sequence of a new linked game to every board, from Simon
+void Link_SendStart(const uint8_t* sequence, uint8_t length);
+
+// Colors of the last START frame received, returns their count or 0 if
+// they do not fit in size
+uint8_t Link_Sequence(uint8_t* sequence, uint8_t size);
+
+// Ask Simon to start a linked game
+void Link_SendStartRequest(void);
+
+// Reflect a press of this board on the others
+void Link_SendInput(uint8_t round, uint8_t index, uint8_t color);
+
+// Share the score of this board, done once its game is over
+void Link_SendScore(uint8_t round, uint16_t score, uint8_t done);
+
+// Place of a score among the boards of the current linked game, 1 for the best
+uint8_t Link_Rank(uint16_t score);
+
+// Highest score the other boards sent in the current linked game
+uint16_t Link_BestScore(void);
+
+// Frame counters since Link_Init
+const LinkStats* Link_Stats(void);
+
+// LPUART1 callbacks, from the HAL callbacks of usart.c
+void Link_TxDone(void);
+void Link_RxEvent(uint16_t size);
+void Link_RxError(void);
+
+#endif
+
+#endif
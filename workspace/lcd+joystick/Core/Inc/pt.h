@@ -0,0 +1,64 @@
+#ifndef PT_H
+#define PT_H
+
+#include <stdint.h>
+
+/*
+ * Stackless coroutines (protothreads) built on a switch statement.
+ *
+ * A thread function keeps its resume point in a PT and returns each time it
+ * has to wait, so local variables do not survive a wait: keep them in a
+ * struct that outlives the call. Two waits must not share a source line, and
+ * a thread body must not contain its own switch statement around a wait.
+ */
+
+typedef struct
+{
+  uint16_t lc;   // line to resume at, 0 to start from the top
+} PT;
+
+#define PT_WAITING  0
+#define PT_YIELDED  1
+#define PT_EXITED   2
+#define PT_ENDED    3
+
+#define PT_THREAD(name_args) char name_args
+
+// Restart a thread from the top
+#define PT_INIT(pt)   ((pt)->lc = 0)
+
+#define PT_BEGIN(pt)  { char PT_YIELD_FLAG = 1; (void)PT_YIELD_FLAG; \
+                        switch ((pt)->lc) { case 0:
+
+#define PT_END(pt)    } (pt)->lc = 0; return PT_ENDED; }
+
+// Return until cond is true, cond is checked right away
+#define PT_WAIT_UNTIL(pt, cond)                 \
+  do {                                          \
+    (pt)->lc = __LINE__; case __LINE__:         \
+    if (!(cond)) { return PT_WAITING; }         \
+  } while (0)
+
+// Return at least once, then until cond is true
+#define PT_YIELD_UNTIL(pt, cond)                \
+  do {                                          \
+    PT_YIELD_FLAG = 0;                          \
+    (pt)->lc = __LINE__; case __LINE__:         \
+    if (!PT_YIELD_FLAG || !(cond)) { return PT_YIELDED; } \
+  } while (0)
+
+// Run a child thread until it exits or ends
+#define PT_SPAWN(pt, child, thread)             \
+  do {                                          \
+    PT_INIT(child);                             \
+    PT_WAIT_UNTIL(pt, (thread) >= PT_EXITED);   \
+  } while (0)
+
+// Leave the thread early, the caller sees PT_EXITED
+#define PT_EXIT(pt)                             \
+  do {                                          \
+    (pt)->lc = 0;                               \
+    return PT_EXITED;                           \
+  } while (0)
+
+#endif
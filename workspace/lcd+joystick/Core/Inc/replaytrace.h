@@ -0,0 +1,85 @@
+#ifndef REPLAYTRACE_H
+#define REPLAYTRACE_H
+
+// Generated by tools/trace2h.py from session.log, 73 records
+
+#include "trace.h"
+
+static const TraceRecord replayTrace[] =
+{
+  {  300, 0x1000},   // joy press 0
+  {   20, 0x3000},   // joy down 0
+  {    1, 0xf125},   // seed 293
+  {    0, 0x1000},   // joy press 0
+  {  300, 0x5003},   // button 3
+  {  150, 0x5003},   // button 3
+  {   23, 0x5002},   // button 2
+  {  300, 0x5003},   // button 3
+  {    4, 0x5002},   // button 2
+  {   23, 0x5000},   // button 0
+  {  150, 0x5003},   // button 3
+  {    8, 0x5002},   // button 2
+  {   30, 0x5000},   // button 0
+  {    6, 0x5003},   // button 3
+  {  300, 0x5003},   // button 3
+  {   19, 0x5002},   // button 2
+  {   26, 0x5000},   // button 0
+  {   26, 0x5003},   // button 3
+  {   17, 0x5003},   // button 3
+  {  150, 0x5003},   // button 3
+  {   24, 0x5002},   // button 2
+  {   23, 0x5000},   // button 0
+  {   24, 0x5003},   // button 3
+  {   11, 0x5003},   // button 3
+  {   21, 0x5000},   // button 0
+  {  300, 0x5003},   // button 3
+  {   25, 0x5002},   // button 2
+  {   15, 0x5002},   // button 2
+  {  700, 0x1000},   // joy press 0
+  {   20, 0x3000},   // joy down 0
+  {   16, 0xf485},   // seed 1157
+  {    0, 0x1000},   // joy press 0
+  {  300, 0x5003},   // button 3
+  {  150, 0x5003},   // button 3
+  {    8, 0x5000},   // button 0
+  {  300, 0x5001},   // button 1
+  {  700, 0x1000},   // joy press 0
+  {   22, 0x3000},   // joy down 0
+  {    7, 0xfbd4},   // seed 3028
+  {    0, 0x1000},   // joy press 0
+  {  300, 0x5001},   // button 1
+  {  150, 0x5001},   // button 1
+  {   25, 0x5001},   // button 1
+  {  300, 0x5003},   // button 3
+  {  700, 0x1000},   // joy press 0
+  {   23, 0x3000},   // joy down 0
+  {    1, 0xf9c0},   // seed 2496
+  {    0, 0x1000},   // joy press 0
+  {  300, 0x5000},   // button 0
+  {  150, 0x5000},   // button 0
+  {   22, 0x5001},   // button 1
+  {  300, 0x5000},   // button 0
+  {   15, 0x5001},   // button 1
+  {   12, 0x5003},   // button 3
+  {  150, 0x5000},   // button 0
+  {   25, 0x5001},   // button 1
+  {   11, 0x5003},   // button 3
+  {   10, 0x5001},   // button 1
+  {  300, 0x5002},   // button 2
+  {  700, 0x1000},   // joy press 0
+  {   17, 0xf970},   // seed 2416
+  {    0, 0x1000},   // joy press 0
+  {  550, 0x5002},   // button 2
+  {  700, 0x5002},   // button 2
+  {   24, 0x5000},   // button 0
+  {  850, 0x5002},   // button 2
+  {    8, 0x5000},   // button 0
+  {   24, 0x5000},   // button 0
+  {  300, 0x1000},   // joy press 0
+  {   28, 0xf4dc},   // seed 1244
+  {    0, 0x1000},   // joy press 0
+  {  550, 0x5002},   // button 2
+  {  700, 0x5000},   // button 0
+};
+
+#endif
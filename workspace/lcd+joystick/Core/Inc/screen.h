@@ -0,0 +1,69 @@
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdint.h>
+#include "lcdfmt.h"
+#include "glyph.h"
+
+#define SCREEN_ROWS        LCD_ROWS
+#define SCREEN_FIELDS_MAX  (2 * SCREEN_ROWS)
+#define SCREEN_BLANK       UINT32_MAX   // FIELD_NUMBER value leaving the field blank
+#define SCREEN_BAR_STEPS   5    // pixel columns of one character cell
+// Characters of a marquee row. Two row displays wrap around a whole DDRAM
+// line; the rows of a four row display share the lines, so they do not scroll.
+#if LCD_ROWS > 2
+#define SCREEN_LINE_LEN    LCD_COLS
+#else
+#define SCREEN_LINE_LEN    LCD_DDRAM_LINE
+#endif
+
+// Value of a SCREEN_BAR field showing done out of total over width cells
+#define SCREEN_BAR(done, total, width) \
+  ((total) ? (uint32_t)(done) * (width) * SCREEN_BAR_STEPS / (total) : 0)
+
+typedef enum
+{
+  FIELD_NUMBER,     // unsigned decimal, SCREEN_BLANK leaves the columns blank
+  FIELD_TEXT,       // value selects one of texts
+  FIELD_GLYPH,      // value is a GlyphId, GLYPH_NONE leaves the column blank
+  FIELD_BAR         // value is the count of lit pixel columns, see SCREEN_BAR
+} ScreenFieldKind;
+
+// Field of a template, filled from one entry of the values array
+typedef struct
+{
+  uint8_t row;
+  uint8_t col;
+  uint8_t width;               // columns owned by the field, blanked when the value gets shorter
+  uint8_t kind;                // ScreenFieldKind
+  const char* const* texts;    // texts of a FIELD_TEXT, NULL otherwise
+} ScreenField;
+
+// Constant layout of a screen, kept in flash
+typedef struct
+{
+  const char* rows[SCREEN_ROWS];   // fixed text, the fields overwrite their columns, NULL for blank
+  uint8_t fieldCount;              // at most SCREEN_FIELDS_MAX
+  const ScreenField* fields;
+} ScreenTemplate;
+
+// Clear the display and start tracking its content
+void Screen_Init(void);
+
+// Show a template with its field values, writing only the characters that change
+void Screen_Show(const ScreenTemplate* screen, const uint32_t* values);
+
+// Change one value of the screen shown last
+void Screen_Set(uint8_t field, uint32_t value);
+
+// Write up to SCREEN_LINE_LEN characters per row into DDRAM, showing the first LCD_COLS
+void Screen_Marquee(const char* const rows[SCREEN_ROWS]);
+
+// Move the marquee one column left with a display shift instruction.
+// Returns 0 without shifting once the end of the longest row is visible.
+uint8_t Screen_Scroll(void);
+
+// Blank the display with one clear instruction
+void Screen_Clear(void);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+#include <stdint.h>
+#include "SimonGame.h"
+
+#define SOAK_SEED             1       // seed of the first game, change to reproduce a report
+#define SOAK_MAX_ROUND        30      // rounds after which the bot gives a wrong answer
+#define SOAK_REPORT_GAMES     1000    // games between two progress reports on USART1
+#define SOAK_HISTOGRAM_GAMES  10000   // games between two round and score histograms
+
+#ifdef SIMON_SOAK
+
+#define SOAK_SCORE_BUCKET     64      // points per score histogram bucket
+#define SOAK_SCORE_BUCKETS    32      // the last bucket also counts higher scores
+
+typedef struct
+{
+  uint32_t played;                          // finished games
+  uint32_t roundsPlayed;                    // rounds played over all games
+  uint32_t violations;                      // invariant or transition violations
+  uint32_t games[PLAYERS_MAX];              // finished games per player count
+  uint32_t rounds[SOAK_MAX_ROUND + 1];      // games per last round reached
+  uint32_t scores[2][SOAK_SCORE_BUCKETS];   // player scores of one and several player games
+  uint32_t frames;                          // screens checked against the golden frames
+  uint64_t strobes;                         // LCD bus transactions of those screens
+  uint32_t maxStrobes;                      // most bus transactions of one screen
+  uint32_t clears;                          // clear display instructions
+  uint32_t goldenSeen;                      // golden frames shown, one bit each
+  uint16_t events[GAME_STATE_COUNT];        // event types dispatched in each state
+  uint16_t transitions[GAME_STATE_COUNT];   // leaf states entered from each state
+} SoakStats;
+
+// Start the run over from another seed, 0 for SOAK_SEED, before Game_Init
+void Soak_Init(uint32_t seed);
+
+// Play as the bot or advance virtual time by one tick, called instead of WFI
+void Soak_Idle(Game* game);
+
+// Record the event type dispatched in the current state for the coverage report
+void Soak_OnDispatch(Game* game, uint8_t type);
+
+// Check a state change against the allowed transitions
+void Soak_OnTransition(Game* game, uint8_t from, uint8_t to);
+
+// Statistics of the run so far
+const SoakStats* Soak_Stats(void);
+
+// Print the games per mode, the histograms, the display and the coverage
+// counts of a run on USART1, every SOAK_HISTOGRAM_GAMES games of Soak_Stats()
+void Soak_Report(const SoakStats* run);
+
+// Number of golden frames a run never showed, each printed on USART1 if
+// print is set. The host test fails a long run on any
+uint8_t Soak_GoldenUnseen(const SoakStats* run, uint8_t print);
+
+#ifdef SIMON_REPLAY
+// Print a tone started by the game
+void Soak_OnTone(Game* game, uint8_t color, uint32_t ms);
+
+// 1 once the whole trace was posted and the game settled
+uint8_t Soak_ReplayDone(void);
+#endif
+
+#endif
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef SWTIMER_H
+#define SWTIMER_H
+
+#include <stdint.h>
+
+#define SWTIMER_TICK_MS      10   // TIM2 period elapsed interval
+#define SWTIMER_LEVEL_BITS   6
+#define SWTIMER_LEVEL_SLOTS  (1u << SWTIMER_LEVEL_BITS)
+#define SWTIMER_LEVELS       4    // 2^24 ticks, about 46 hours at 10 ms
+
+typedef void (*SWTimer_Callback)(void *arg);
+
+typedef struct SWTimer
+{
+  struct SWTimer *next;
+  struct SWTimer **pprev;    // link that points at this timer, NULL when idle
+  uint32_t expires;          // absolute tick at which the timer fires
+  uint32_t period;           // reload in ticks, 0 for one-shot
+  SWTimer_Callback callback; // runs in TIM2 interrupt context, keep it short
+  void *arg;
+} SWTimer;
+
+// Reset the wheel, must be called before TIM2 interrupts are started
+void SWTimer_Init(void);
+
+// Advance the wheel by one tick and run expired callbacks (called from TIM2 ISR)
+void SWTimer_Tick(void);
+
+// Arm a timer to fire after delayMs, then every periodMs (0 for one-shot)
+void SWTimer_Start(SWTimer *timer, uint32_t delayMs, uint32_t periodMs,
+                   SWTimer_Callback callback, void *arg);
+
+// Disarm a timer, safe to call on a timer that is not running
+void SWTimer_Stop(SWTimer *timer);
+
+// Check if a timer is currently armed
+uint8_t SWTimer_IsRunning(const SWTimer *timer);
+
+// Current wheel time in ticks
+uint32_t SWTimer_Now(void);
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "SimonGame.h"
+
+// Telemetry frames on USART1, built with make -f STM32Make.make TELEMETRY=UART:
+//
+//   SOF  length  seq  mask (4 bytes)  fields  crc8
+//
+// length counts seq to the end of the fields and the CRC-8 (polynomial
+// 0x07) covers length to the end of the fields. mask has one bit per
+// TelemetryField and only the fields that changed follow, in that order,
+// least significant byte first. Every TELEMETRY_KEYFRAME_MS a frame carries
+// all of them so a dashboard joining late catches up.
+#define TELEMETRY_SOF           0x7E
+#define TELEMETRY_HEADER        7       // SOF, length, seq, mask
+#define TELEMETRY_PERIOD_MS     250     // at most one frame per period
+#define TELEMETRY_KEYFRAME_MS   5000
+
+typedef enum
+{
+  TELEMETRY_STATE = 0,      // GameState, 1 byte
+  TELEMETRY_ROUND,          // 1 byte
+  TELEMETRY_LENGTH,         // sequence length, 1 byte
+  TELEMETRY_PLAYERS,        // numPlayers, 1 byte
+  TELEMETRY_PLAYER,         // currentPlayer, 1 byte
+  TELEMETRY_LEFT,           // playersLeft, 1 byte
+  TELEMETRY_QUEUE,          // events queued, 1 byte
+  TELEMETRY_QUEUE_PEAK,     // 1 byte
+  TELEMETRY_DROPPED,        // events lost to a full queue, 2 bytes
+  TELEMETRY_TX_QUEUED,      // bytes waiting for the USART1 DMA, 2 bytes
+  TELEMETRY_LATENCY,        // last color press, queued to dispatched, us, 2 bytes
+  TELEMETRY_LATENCY_MAX,    // 2 bytes
+  TELEMETRY_LOAD,           // CPU busy over the last second, per mille, 2 bytes
+  TELEMETRY_LOAD_10S,       // over the last 10 s, 2 bytes
+  TELEMETRY_ISR_TIM2,       // share of the last second in each handler, per
+  TELEMETRY_ISR_SYSTICK,    // mille, in CpuLoadIsr order, 2 bytes each
+  TELEMETRY_ISR_UART,
+  TELEMETRY_ISR_I2C,
+  TELEMETRY_MAX_TIM2,       // longest run of each handler since the start,
+  TELEMETRY_MAX_SYSTICK,    // us, in CpuLoadIsr order, 2 bytes each
+  TELEMETRY_MAX_UART,
+  TELEMETRY_MAX_I2C,
+  TELEMETRY_JITTER_TIM2,    // largest lateness or earliness of an entry, us,
+  TELEMETRY_JITTER_SYSTICK, // 2 bytes each
+  TELEMETRY_OVER_BUDGET,    // runs of all handlers over their budget, 2 bytes
+  TELEMETRY_SCORES,         // count, then count scores of 2 bytes, last field
+  TELEMETRY_FIELDS
+} TelemetryField;
+
+#ifdef TELEMETRY_UART
+
+// Queue a frame with the fields that changed if TELEMETRY_PERIOD_MS passed
+// since the last one, from the main loop
+void Telemetry_Poll(const Game* game);
+
+#endif
+
+#endif
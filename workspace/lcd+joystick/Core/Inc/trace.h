@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+#define TRACE_RECORDS       2048  // RAM ring of 8 KB, a 60 round one player game
+#define TRACE_LINE_RECORDS  8     // records per line sent on USART1
+#define TRACE_WAIT          14    // record type that only carries time
+#define TRACE_SEED          15    // record type of the rand() seed of a one player game
+
+// Record type in the top 4 bits of value, event parameter or seed in the low 12
+#define TRACE_VALUE(type, param)  ((uint16_t)(((type) << 12) | ((param) & 0x0FFF)))
+#define TRACE_TYPE(value)         ((value) >> 12)
+#define TRACE_PARAM(value)        ((value) & 0x0FFF)
+
+// One input event, sent on USART1 as 8 hex digits: delta then value
+typedef struct
+{
+  uint16_t delta;   // wheel ticks since the previous record
+  uint16_t value;   // TRACE_VALUE of a GameEventType, TRACE_WAIT or TRACE_SEED
+} TraceRecord;
+
+#ifdef SIMON_TRACE
+
+// Empty the ring and take the current wheel tick as time base
+void Trace_Start(void);
+
+// Append an input event or seed, stamped with the current wheel tick
+void Trace_Input(uint8_t type, uint16_t param);
+
+// Send the records not sent yet on USART1, blocking
+void Trace_Flush(void);
+
+#define TRACE_START()              Trace_Start()
+#define TRACE_INPUT(type, param)   Trace_Input((type), (param))
+#define TRACE_FLUSH()              Trace_Flush()
+#else
+#define TRACE_START()
+#define TRACE_INPUT(type, param)
+#define TRACE_FLUSH()
+#endif
+
+#endif
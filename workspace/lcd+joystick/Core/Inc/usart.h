@@ -29,19 +29,46 @@ extern "C" {
 #include "main.h"
 
 /* USER CODE BEGIN Includes */
-
+// The console and the telemetry share the transmit DMA of USART1
+#if defined(CONSOLE_UART) || defined(TELEMETRY_UART)
+#define USART1_DMA_TX
+#endif
 /* USER CODE END Includes */
 
 extern UART_HandleTypeDef huart1;
+#ifdef CONSOLE_UART
+extern DMA_HandleTypeDef hdma_usart1_rx;
+#endif
+#ifdef USART1_DMA_TX
+extern DMA_HandleTypeDef hdma_usart1_tx;
+#endif
+#ifdef LINK_UART
+extern UART_HandleTypeDef hlpuart1;
+extern DMA_HandleTypeDef hdma_lpuart1_rx;
+extern DMA_HandleTypeDef hdma_lpuart1_tx;
+#endif
 
 /* USER CODE BEGIN Private defines */
-
+#define USART1_TX_SIZE  256   // bytes queued for the transmit DMA, must be a power of two
 /* USER CODE END Private defines */
 
 void MX_USART1_UART_Init(void);
+#ifdef LINK_UART
+void MX_LPUART1_UART_Init(void);
+#endif
 
 /* USER CODE BEGIN Prototypes */
+#ifdef USART1_DMA_TX
+// Queue bytes for the transmit DMA of USART1, 0 if they do not fit
+uint8_t USART1_Send(const void* data, uint16_t length);
 
+// Room left in the transmit queue
+uint16_t USART1_TxFree(void);
+
+// Start the DMA on the bytes queued if it is idle, from the main loop in
+// case an earlier start found the port busy
+void USART1_Kick(void);
+#endif
 /* USER CODE END Prototypes */
 
 #ifdef __cplusplus
@@ -3,405 +3,1206 @@
 #include "gpio.h"
 #include "tim.h"
 #include "usart.h"
-#include <stdio.h> 
+#include "swtimer.h"
+#include "eventq.h"
+#include "flashstore.h"
+#include "soak.h"
+#include "trace.h"
+#include "screen.h"
+#include "link.h"
+#include "console.h"
+#include "telemetry.h"
+#include "cpuload.h"
+#include "cycles.h"
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
-static int buttonTimer = 0;
-static Button redButton = {0, 0, LEDR_GPIO_Port, LEDR_Pin}, 
-              blueButton = {0, 0, LEDB_GPIO_Port, LEDB_Pin}, 
-              yellowButton = {0, 0, LEDY_GPIO_Port, LEDY_Pin}, 
-              greenButton = {0, 0, LEDG_GPIO_Port, LEDG_Pin};
-static char lineOne[17] = {0}, lineTwo[17] = {0};
+#define START_TIMEOUT_MS  10000  // return to SLEEP after 10 seconds without input
+#define NOTE_GAP_MS       500    // silence between two colors of Simon's sequence
+#define BUZZER_MS         1000   // wrong input buzzer duration
+#define JOY_SAMPLE_MS     50     // joystick axis sampling interval in PLAYER_SELECT
+#define MARQUEE_STEP_MS   200    // marquee scroll interval, one display shift each
+#define DEBOUNCE_TICKS    10     // TIM2 ticks between button samples, 100 ms as before the wheel
+#define SOUND_TONE        0      // EV_SOUND_DONE parameter for a color note
+#define SOUND_BUZZER      1      // EV_SOUND_DONE parameter for the active buzzer
+
+#ifdef SIMON_SOAK
+#define LOG_PRESSES       0      // soak games run far too fast for the 9600 baud log
+#elif defined(LINK_UART) || defined(CONSOLE_UART) || defined(TELEMETRY_UART)
+#define LOG_PRESSES       0      // the 9600 baud log would hold each press back 13 ms
+                                 // and cut into the DMA stream of the console or telemetry
+#else
+#define LOG_PRESSES       1      // log color button presses on USART1
+#endif
+
+#define NO_STATE          GAME_STATE_COUNT        // no parent / no initial child
+#define STATE_HANDLED     (GAME_STATE_COUNT + 1)  // event consumed, stay in state
+#define STATE_UNHANDLED   (GAME_STATE_COUNT + 2)  // let the parent state handle it
+
+typedef struct
+{
+  GPIO_TypeDef *port;
+  uint16_t pin;
+} PinRef;
+
+// Input, LED and passive buzzer prescaler for each color: 0-Red, 1-Blue, 2-Yellow, 3-Green
+static const PinRef colorInputs[4] = {{RedButton_GPIO_Port, RedButton_Pin},
+                                      {BlueButton_GPIO_Port, BlueButton_Pin},
+                                      {YellowButtonm_GPIO_Port, YellowButtonm_Pin},
+                                      {GreenButton_GPIO_Port, GreenButton_Pin}};
+static const PinRef colorLeds[4] = {{LEDR_GPIO_Port, LEDR_Pin}, {LEDB_GPIO_Port, LEDB_Pin},
+                                    {LEDY_GPIO_Port, LEDY_Pin}, {LEDG_GPIO_Port, LEDG_Pin}};
+static const uint16_t colorTones[4] = {283, 189, 225, 378};
+static const char* const colorNames[4] = {"Red", "Blue", "Yellow", "Green"};
+
+static const uint8_t colorGlyphs[4] = {GLYPH_RED, GLYPH_BLUE, GLYPH_YELLOW, GLYPH_GREEN};
+
+// Screens. Each row is padded to the LCD_COLS columns, a field owns its columns
+static const char* const resultTitles[] = {"Game Over!", "New High Score!"};
+static const char* const resultWinners[PLAYERS_MAX + 1] =
+  {"Players Tied", "Player 1 Wins", "Player 2 Wins", "Player 3 Wins", "Player 4 Wins",
+   "Player 5 Wins", "Player 6 Wins", "Player 7 Wins", "Player 8 Wins"};
+// Scoreboard labels by player number, 0 leaves the row blank
+static const char* const scoreLabels[PLAYERS_MAX + 1] =
+  {"", "P1 Score:", "P2 Score:", "P3 Score:", "P4 Score:",
+   "P5 Score:", "P6 Score:", "P7 Score:", "P8 Score:"};
+
+// Menu screens start with the countdown to SLEEP in the last three columns
+#define COUNTDOWN_FIELDS  {1, LCD_COLS - 3, 1, FIELD_GLYPH, NULL}, {1, LCD_COLS - 2, 2, FIELD_NUMBER, NULL}
+#define COUNTDOWN_FIELD   1   // index of the seconds left
+#define SIMON_ICON_FIELD  1   // index of the color icon on simonTurnScreen
+#define PROGRESS_CELLS    4   // width of the progress bar of the player's turn
+#define PEER_ICON_FIELD   2   // index of the color pressed on a linked board
+// One scoreboard row, the label and the score of a player
+#define SCORE_ROW(row)    {row, 0, 10, FIELD_TEXT, scoreLabels}, {row, 10, 5, FIELD_NUMBER, NULL}
+#define RESULT_SCORE_ROWS (SCREEN_ROWS - 2)   // scoreboard rows under the winner
+
+static const ScreenField countdownFields[] = {COUNTDOWN_FIELDS};
+static const ScreenField playerMenuFields[] = {COUNTDOWN_FIELDS, {1, 9, 1, FIELD_NUMBER, NULL}};
+static const ScreenField simonTurnFields[] = {{0, 6, 3, FIELD_NUMBER, NULL},
+                                              {1, LCD_COLS - 1, 1, FIELD_GLYPH, NULL}};
+static const ScreenField roundField[] = {{0, 6, 3, FIELD_NUMBER, NULL}};
+static const ScreenField playerTurnFields[] = {{1, 7, 5, FIELD_NUMBER, NULL},
+                                               {1, LCD_COLS - PROGRESS_CELLS, PROGRESS_CELLS, FIELD_BAR, NULL}};
+static const ScreenField playerNTurnFields[] = {{0, 7, 1, FIELD_NUMBER, NULL},
+                                                {1, 7, 5, FIELD_NUMBER, NULL},
+                                                {1, LCD_COLS - PROGRESS_CELLS, PROGRESS_CELLS, FIELD_BAR, NULL}};
+static const ScreenField resultScoreFields[] = {{0, 0, LCD_COLS, FIELD_TEXT, resultTitles},
+                                                {1, 10, 5, FIELD_NUMBER, NULL}};
+static const ScreenField eliminatedField[] = {{1, 7, 1, FIELD_NUMBER, NULL}};
+#ifdef LINK_UART
+static const ScreenField linkedTurnFields[] = {{1, 7, 5, FIELD_NUMBER, NULL},
+                                               {1, LCD_COLS - PROGRESS_CELLS, PROGRESS_CELLS, FIELD_BAR, NULL},
+                                               {0, LCD_COLS - 1, 1, FIELD_GLYPH, NULL}};
+static const ScreenField rankFields[] = {{0, 5, 1, FIELD_NUMBER, NULL}, {0, 10, 1, FIELD_NUMBER, NULL},
+                                         {1, 11, 5, FIELD_NUMBER, NULL}};
+#endif
+
+// Four rows start the scoreboard under the winner, two rows need screens of their own
+#if LCD_ROWS >= 4
+static const ScreenField resultWinnerFields[] = {{0, 0, LCD_COLS, FIELD_TEXT, resultTitles},
+                                                 {1, 0, LCD_COLS, FIELD_TEXT, resultWinners},
+                                                 SCORE_ROW(2), SCORE_ROW(3)};
+static const ScreenField scoreboardFields[] = {SCORE_ROW(0), SCORE_ROW(1), SCORE_ROW(2), SCORE_ROW(3)};
+#else
+static const ScreenField resultWinnerFields[] = {{0, 0, LCD_COLS, FIELD_TEXT, resultTitles},
+                                                 {1, 0, LCD_COLS, FIELD_TEXT, resultWinners}};
+static const ScreenField scoreboardFields[] = {SCORE_ROW(0), SCORE_ROW(1)};
+#endif
+
+static const char* const welcomeMarquee[SCREEN_ROWS] = {"Welcome to the Simon Game", "Repeat what Simon plays"};
+static const ScreenTemplate startScreen       = {{"Push To Start!", ""}, 2, countdownFields};
+static const ScreenTemplate playAgainScreen   = {{"Play Again?", "Push to Start"}, 2, countdownFields};
+static const ScreenTemplate playerMenuScreen  = {{"How many players", "Up/Down:"}, 3, playerMenuFields};
+static const ScreenTemplate simonTurnScreen   = {{"Round", "Simon's Turn!"}, 2, simonTurnFields};
+static const ScreenTemplate playerTurnScreen  = {{"Player's Turn!", "Score:"}, 2, playerTurnFields};
+static const ScreenTemplate roundScreen       = {{"Round", ""}, 1, roundField};
+static const ScreenTemplate playerNTurnScreen = {{"Player  's Turn", "Score:"}, 3, playerNTurnFields};
+static const ScreenTemplate wrongScreen       = {{"Wrong! Game Over", ""}, 0, NULL};
+static const ScreenTemplate eliminatedScreen  = {{"Wrong!", "Player   is out"}, 1, eliminatedField};
+static const ScreenTemplate resultScoreScreen = {{"", "P1 Score:"}, 2, resultScoreFields};
+static const ScreenTemplate resultWinnerScreen = {{""}, 2 + 2 * RESULT_SCORE_ROWS, resultWinnerFields};
+static const ScreenTemplate scoreboardScreen  = {{""}, 2 * SCREEN_ROWS, scoreboardFields};
+#ifdef LINK_UART
+static const ScreenTemplate linkedTurnScreen  = {{"Player's Turn!", "Score:"}, 3, linkedTurnFields};
+static const ScreenTemplate rankScreen        = {{"Rank   of", "Best peer:"}, 3, rankFields};
+#endif
+
+// Wait inside a thread for ms milliseconds using the state timer
+#define PT_DELAY(pt, event, ms)                           \
+  do {                                                    \
+    armEventTimer(&game->stateTimer, (ms), 0);            \
+    PT_YIELD_UNTIL(pt, (event)->type == EV_TIMEOUT);      \
+  } while (0)
+
+typedef struct
+{
+  uint8_t parent;                                   // enclosing state or NO_STATE
+  uint8_t initial;                                  // child entered when targeted or NO_STATE
+  void (*entry)(Game* game);
+  void (*exit)(Game* game);
+  int (*handler)(Game* game, const GameEvent* event);
+} StateRow;
 
 /**
- * @brief  Initialize the game state and information.
- * @param  game: Pointer to the Game structure to initialize.
+ * @brief  Timer callback queueing the event of an EventTimer.
+ * @param  arg: Pointer to the EventTimer.
  */
-void Game_Init(Game* game)
+static void postTimerEvent(void *arg)
+{
+  EventTimer *eventTimer = (EventTimer *)arg;
+  EventQueue_Push(eventTimer->queue, eventTimer->type, eventTimer->gen);
+}
+
+/**
+ * @brief  Start an EventTimer, invalidating events of its previous run.
+ * @param  eventTimer: Pointer to the EventTimer.
+ * @param  ms: Time until the first event in milliseconds.
+ * @param  periodMs: Reload interval in milliseconds, 0 for a one-shot timer.
+ */
+static void armEventTimer(EventTimer *eventTimer, uint32_t ms, uint32_t periodMs)
+{
+  eventTimer->gen++;
+  SWTimer_Start(&eventTimer->timer, ms, periodMs, postTimerEvent, eventTimer);
+}
+
+/**
+ * @brief  Stop an EventTimer and drop any of its events still queued.
+ * @param  eventTimer: Pointer to the EventTimer.
+ */
+static void stopEventTimer(EventTimer *eventTimer)
 {
-    game->state = WELCOME;
-    memset(&game->info, 0, sizeof(GameInfo));
+  SWTimer_Stop(&eventTimer->timer);
+  eventTimer->gen++;
 }
 
 /**
- * @brief  Display two lines of text on the LCD.
- * @param  lineOne: Pointer to the first line of text (max 16 characters).
- * @param  lineTwo: Pointer to the second line of text (max 16 characters
+ * @brief  Timer callback turning off a color LED and the passive buzzer.
+ * @param  arg: Pointer to the Game playing the note.
  */
-void displayOnLCD(char* lineOne, char* lineTwo)
+static void toneOff(void *arg)
 {
-  LCD_GotoXY(0, 0);
-  LCD_Print(lineOne);
-  LCD_GotoXY(0, 1);
-  LCD_Print(lineTwo);
-  HAL_Delay(1000);
+  Game *game = (Game *)arg;
+  Button *button = &game->buttons[game->toneColor];
+  HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_RESET);
+  HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
+  EventQueue_Push(&game->events, EV_SOUND_DONE, SOUND_TONE);
 }
 
 /**
- * @brief  Compare the player's input sequence with the computer's sequence.
- *         Increment player's score by 1 point for each correct color input.
+ * @brief  Light a color LED and play its tone, both stop on their own.
  * @param  game: Pointer to the Game structure.
+ * @param  color: Color index 0-Red, 1-Blue, 2-Yellow, 3-Green.
+ * @param  ms: Duration of the note in milliseconds.
  */
-void compareSequences(Game* game)
+static void playTone(Game* game, uint8_t color, uint32_t ms)
 {
-  if (game->info.numPlayers == 1)
+  Button *button = &game->buttons[color];
+  HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_SET);
+  __HAL_TIM_SET_PRESCALER(&htim16, colorTones[color]);
+  HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
+  game->toneColor = color;
+  SWTimer_Start(&game->toneTimer, ms, 0, toneOff, game);
+#ifdef SIMON_REPLAY
+  Soak_OnTone(game, color, ms);
+#endif
+}
+
+/**
+ * @brief  Timer callback turning off the active buzzer.
+ * @param  arg: Pointer to the Game sounding the buzzer.
+ */
+static void buzzerOff(void *arg)
+{
+  Game *game = (Game *)arg;
+  HAL_GPIO_WritePin(BUZZA_GPIO_Port, BUZZA_Pin, GPIO_PIN_RESET);
+  EventQueue_Push(&game->events, EV_SOUND_DONE, SOUND_BUZZER);
+}
+
+/**
+ * @brief  Show the wrong input screen and sound the active buzzer, an
+ *         EV_SOUND_DONE event follows once the buzzer stops. The game goes
+ *         on without the current player while two others are left.
+ * @param  game: Pointer to the Game structure.
+ */
+static void wrongInput(Game* game)
+{
+  if (game->info.playersLeft > 2)
+  { Screen_Show(&eliminatedScreen, (uint32_t[]){game->info.currentPlayer + 1}); }
+  else
+  { Screen_Show(&wrongScreen, NULL); }
+  HAL_GPIO_WritePin(BUZZA_GPIO_Port, BUZZA_Pin, GPIO_PIN_SET);
+  SWTimer_Start(&game->buzzerTimer, BUZZER_MS, 0, buzzerOff, game);
+}
+
+/**
+ * @brief  Remove the next event from the queue, dropping timer events that
+ *         were invalidated and logging color button presses on USART1.
+ * @param  game: Pointer to the Game structure.
+ * @param  event: Filled with the next event.
+ * @return 1 if an event was removed, 0 if the queue was empty.
+ */
+static uint8_t nextEvent(Game* game, GameEvent* event)
+{
+  char msg[32];
+
+  while (EventQueue_Pop(&game->events, event))
   {
-    for(int i = 0; i < game->info.sequenceLength; i++)
+    switch (event->type)
     {
-      if(game->info.sequence[i] != game->info.playerInputs[0][i])
+      case EV_TIMEOUT:
+        if (event->param != game->stateTimer.gen)
+        { continue; }
+        break;
+      case EV_INACTIVE:
+        if (event->param != game->inactivityTimer.gen)
+        { continue; }
+        break;
+      case EV_JOY_SAMPLE:
+        if (event->param != game->sampleTimer.gen)
+        { continue; }
+        break;
+      case EV_SCROLL:
+        if (event->param != game->scrollTimer.gen)
+        { continue; }
+        break;
+      case EV_BUTTON:
+        if (LOG_PRESSES)
+        {
+          snprintf(msg, sizeof(msg), "%s pressed\r\n", colorNames[event->param]);
+          HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
+        }
+        break;
+      default:
+        break;
+    }
+    return 1;
+  }
+
+  return 0;
+}
+
+// Bytes the link or the console received and Game_Run did not look at yet
+#ifdef LINK_UART
+#define linkPending()     Link_Pending()
+#else
+#define linkPending()     0
+#endif
+#ifdef CONSOLE_UART
+#define consolePending()  Console_Pending()
+#else
+#define consolePending()  0
+#endif
+
+/**
+ * @brief  Sleep until an interrupt if no event is waiting. Interrupts are
+ *         masked around the check so an event queued just before WFI still
+ *         wakes the core up, and the time asleep counts as idle before the
+ *         interrupt runs. Soak builds advance virtual time instead.
+ * @param  game: Pointer to the Game structure.
+ */
+static void idle(Game* game)
+{
+#ifdef SIMON_SOAK
+  Soak_Idle(game);
+#else
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (EventQueue_Count(&game->events) == 0 && !linkPending() && !consolePending())
+  {
+    uint32_t start = Cycles_Now();
+    __WFI();
+    CpuLoad_Idle(Cycles_Now() - start);
+  }
+  __set_PRIMASK(primask);
+#endif
+}
+
+/*
+ * State actions. Entry and exit actions run on every transition crossing
+ * the state boundary. Handlers return the next state, STATE_HANDLED to stay,
+ * or STATE_UNHANDLED to pass the event on to the parent state.
+ */
+
+// Scroll the WELCOME message through then move on to the Push to start prompt
+static void welcomeEntry(Game* game)
+{
+  Screen_Marquee(welcomeMarquee);
+  armEventTimer(&game->scrollTimer, MARQUEE_STEP_MS, MARQUEE_STEP_MS);
+  armEventTimer(&game->stateTimer, 3000, 0);
+}
+
+static void welcomeExit(Game* game)
+{
+  stopEventTimer(&game->scrollTimer);
+}
+
+static int welcomeHandler(Game* game, const GameEvent* event)
+{
+  switch (event->type)
+  {
+    case EV_SCROLL:
+      if (!Screen_Scroll())
+      { stopEventTimer(&game->scrollTimer); }
+      return STATE_HANDLED;
+
+    case EV_TIMEOUT:
+      return START;
+
+    default:
+      return STATE_UNHANDLED;
+  }
+}
+
+/**
+ * @brief  Restart the countdown to SLEEP of the menu screens, one
+ *         EV_INACTIVE event per second.
+ * @param  game: Pointer to the Game structure.
+ */
+static void restartCountdown(Game* game)
+{
+  game->countdown = START_TIMEOUT_MS / 1000;
+  armEventTimer(&game->inactivityTimer, 1000, 1000);
+}
+
+/**
+ * @brief  Put the players selected in a ring in turn order, player 0 first,
+ *         with no score and nobody eliminated.
+ * @param  info: Pointer to the GameInfo structure.
+ */
+static void seatPlayers(GameInfo* info)
+{
+  for (uint8_t player = 0; player < info->numPlayers; player++)
+  {
+    info->nextPlayer[player] = (player + 1 < info->numPlayers) ? player + 1 : 0;
+    info->playerScores[player] = 0;
+  }
+  info->currentPlayer = 0;
+  info->previousPlayer = info->numPlayers - 1;
+  info->playersLeft = info->numPlayers;
+  info->eliminated = PLAYER_NONE;
+}
+
+/**
+ * @brief  Start a game of the number of players selected on round 1.
+ * @param  game: Pointer to the Game structure.
+ */
+static void newGame(Game* game)
+{
+  game->info.round = 1;
+  game->info.sequenceLength = 1;
+  game->info.sequenceSpeed = game->noteMs;
+  game->linked = 0;
+  seatPlayers(&game->info);
+}
+
+/**
+ * @brief  Seed the random number generator using joystick readings, or with
+ *         the seed set by Game_SetSeed. Soak builds seed it from their own
+ *         replayable stream.
+ * @param  game: Pointer to the Game structure.
+ */
+static void seedRandom(Game* game)
+{
+#ifndef SIMON_SOAK
+  uint16_t seed[2] = {game->seed, 0};
+  if (!game->seed)
+  { Joystick_ReadXY(game->joystick, seed); }
+  srand(seed[0] ^ seed[1]);
+  TRACE_INPUT(TRACE_SEED, seed[0] ^ seed[1]);
+#endif
+}
+
+#ifdef LINK_UART
+/**
+ * @brief  Start a linked one player game from any menu screen. Simon draws
+ *         the whole sequence and sends it when another board asks for a
+ *         game or its own player starts one; the other boards start when
+ *         the sequence arrives.
+ * @param  game: Pointer to the Game structure.
+ * @param  param: EV_LINK parameter.
+ * @return ONE_PLAYER once the sequence is known, STATE_HANDLED otherwise.
+ */
+static int linkedStart(Game* game, uint8_t param)
+{
+  switch (LINK_EVENT_KIND(param))
+  {
+    case LINK_EV_START_REQ:
+      if (!Link_IsSimon())
+      { return STATE_HANDLED; }
+      seedRandom(game);
+      for (uint8_t i = 0; i < SEQUENCE_MAX; i++)
+      { game->info.sequence[i] = rand() % 4; }
+      Link_SendStart(game->info.sequence, SEQUENCE_MAX);
+      break;
+
+    case LINK_EV_START:
+      if (Link_Sequence(game->info.sequence, SEQUENCE_MAX) != SEQUENCE_MAX)
+      { return STATE_HANDLED; }
+      break;
+
+    default:
+      return STATE_HANDLED;
+  }
+
+  game->info.numPlayers = 1;
+  newGame(game);
+  game->linked = 1;
+  game->peerGlyph = GLYPH_NONE;
+  return ONE_PLAYER;
+}
+#endif
+
+/**
+ * @brief  Show the player selection menu with the current choice.
+ * @param  game: Pointer to the Game structure.
+ */
+static void showPlayerMenu(Game* game)
+{
+  Screen_Show(&playerMenuScreen, (uint32_t[]){GLYPH_HOURGLASS, game->countdown, game->info.numPlayers});
+}
+
+// Every menu screen counts down and returns to SLEEP after START_TIMEOUT_MS
+// without input
+static void menuEntry(Game* game)
+{
+  restartCountdown(game);
+}
+
+static void menuExit(Game* game)
+{
+  stopEventTimer(&game->inactivityTimer);
+}
+
+static int menuHandler(Game* game, const GameEvent* event)
+{
+#ifdef LINK_UART
+  if (event->type == EV_LINK)
+  { return linkedStart(game, event->param); }
+#endif
+  if (event->type != EV_INACTIVE)
+  { return STATE_UNHANDLED; }
+  if (--game->countdown == 0)
+  { return SLEEP; }
+  Screen_Set(COUNTDOWN_FIELD, game->countdown);
+  return STATE_HANDLED;
+}
+
+static void startEntry(Game* game)
+{
+  Screen_Show(&startScreen, (uint32_t[]){GLYPH_HOURGLASS, game->countdown});
+}
+
+static void playAgainEntry(Game* game)
+{
+  Screen_Show(&playAgainScreen, (uint32_t[]){GLYPH_HOURGLASS, game->countdown});
+}
+
+// Check if Joystick is pressed to start the game
+static int startHandler(Game* game, const GameEvent* event)
+{
+  return (event->type == EV_JOY_PRESS) ? PLAYER_MENU : STATE_UNHANDLED;
+}
+
+// Display Player selection menu
+static void playerMenuEntry(Game* game)
+{
+  game->info.numPlayers = 1;  // Default to 1 player
+  showPlayerMenu(game);
+}
+
+static void playerSelectEntry(Game* game)
+{
+  armEventTimer(&game->sampleTimer, JOY_SAMPLE_MS, JOY_SAMPLE_MS);
+}
+
+static void playerSelectExit(Game* game)
+{
+  stopEventTimer(&game->sampleTimer);
+}
+
+// Handle Player selection based on joystick UP/DOWN input, UP for one
+// player less and DOWN for one more
+static int playerSelectHandler(Game* game, const GameEvent* event)
+{
+  switch (event->type)
+  {
+    case EV_JOY_UP:
+      if (game->info.numPlayers > 1)
+      { game->info.numPlayers--; }
+      restartCountdown(game);
+      showPlayerMenu(game);
+      return STATE_HANDLED;
+
+    case EV_JOY_DOWN:
+      if (game->info.numPlayers < PLAYERS_MAX)
+      { game->info.numPlayers++; }
+      restartCountdown(game);
+      showPlayerMenu(game);
+      return STATE_HANDLED;
+
+    // Joystick pressed to confirm selection, move to the state which
+    // matches the mode selected
+    case EV_JOY_PRESS:
+      if (game->info.numPlayers > 1)
       {
-        game->state = GAME_RESULT;
-        return;
+        newGame(game);
+        return MULTI_PLAYER;
       }
-      else
-      { game->info.playerScores[0]++; }
-    }
+#ifdef LINK_UART
+      // With boards linked everybody plays Simon's sequence, the other
+      // boards ask Simon for one and start once it arrives
+      if (Link_Peers())
+      {
+        if (Link_IsSimon())
+        { return linkedStart(game, LINK_EVENT(LINK_EV_START_REQ, 0)); }
+        Link_SendStartRequest();
+        return STATE_HANDLED;
+      }
+#endif
+      newGame(game);
+      seedRandom(game);
+      return ONE_PLAYER;
+
+    default:
+      return STATE_UNHANDLED;
+  }
+}
+
+/**
+ * @brief  Show the player's turn screen of the game mode with the score of
+ *         the current player and the progress through the sequence.
+ * @param  game: Pointer to the Game structure.
+ * @param  done: Colors of the sequence entered so far.
+ */
+static void showPlayerTurn(Game* game, uint8_t done)
+{
+  uint8_t player = game->info.currentPlayer;
+  uint32_t bar = SCREEN_BAR(done, game->info.sequenceLength, PROGRESS_CELLS);
+
+#ifdef LINK_UART
+  if (game->linked)
+  {
+    Screen_Show(&linkedTurnScreen, (uint32_t[]){game->info.playerScores[0], bar, game->peerGlyph});
+    return;
+  }
+#endif
+  if (game->info.numPlayers == 1)
+  { Screen_Show(&playerTurnScreen, (uint32_t[]){game->info.playerScores[0], bar}); }
+  else
+  { Screen_Show(&playerNTurnScreen, (uint32_t[]){player + 1, game->info.playerScores[player], bar}); }
+}
+
+/**
+ * @brief  Pass the turn to the next player of the ring, unlinking the
+ *         current player onto the elimination list first if they failed.
+ * @param  info: Pointer to the GameInfo structure.
+ * @param  out: 1 if the current player is eliminated.
+ * @return 1 if the turn went round past the last player, starting a new
+ *         round, 0 otherwise.
+ */
+static uint8_t passTurn(GameInfo* info, uint8_t out)
+{
+  uint8_t player = info->currentPlayer;
+  uint8_t next = info->nextPlayer[player];
+
+  if (out)
+  {
+    info->nextPlayer[info->previousPlayer] = next;
+    info->nextPlayer[player] = info->eliminated;
+    info->eliminated = player;
+    info->playersLeft--;
   }
   else
+  { info->previousPlayer = player; }
+
+  info->currentPlayer = next;
+  return next <= player;   // the ring is kept in player order
+}
+
+/**
+ * @brief  Move the players still in on top of the elimination list, which
+ *         then holds every player, the last ones out first.
+ * @param  info: Pointer to the GameInfo structure.
+ */
+static void closeStandings(GameInfo* info)
+{
+  uint8_t player = info->currentPlayer;
+
+  for (uint8_t left = info->playersLeft; left > 0; left--)
+  {
+    uint8_t next = info->nextPlayer[player];
+    info->nextPlayer[player] = info->eliminated;
+    info->eliminated = player;
+    player = next;
+  }
+  info->playersLeft = 0;
+}
+
+// Game mode threads, one pass of the loop per round. They end with
+// PT_EXITED once the game is over.
+static PT_THREAD(onePlayerThread(PT* pt, Game* game, const GameEvent* event))
+{
+  char status;
+
+  PT_BEGIN(pt);
+  while (1)
+  {
+    Screen_Show(&simonTurnScreen, (uint32_t[]){game->info.round, GLYPH_NONE});
+    PT_DELAY(pt, event, 2000);
+    PT_SPAWN(pt, &game->turnPt, computerTurn(&game->turnPt, game, event));
+
+    showPlayerTurn(game, 0);
+    PT_DELAY(pt, event, 2000);
+    PT_INIT(&game->turnPt);
+    PT_WAIT_UNTIL(pt, (status = playerTurn(&game->turnPt, game, event)) >= PT_EXITED);
+#ifdef LINK_UART
+    if (game->linked)
+    {
+      Link_SendScore(game->info.round, game->info.playerScores[0],
+                     status == PT_EXITED || game->info.sequenceLength == SEQUENCE_MAX);
+    }
+#endif
+    if (status == PT_EXITED)
+    { PT_EXIT(pt); }
+
+    // Prepare for next round, a full sequence ends the game
+    if (game->info.sequenceLength == SEQUENCE_MAX)
+    { PT_EXIT(pt); }
+    game->info.round++;
+    game->info.sequenceLength++;
+  }
+  PT_END(pt);
+}
+
+// The players take turns round the ring, each one repeating the chain built
+// so far and adding one color to it. A wrong input takes the player out and
+// the next one gets the same chain; the game ends with one player left.
+// Finishing a turn scores one point per other player still in.
+static PT_THREAD(multiPlayerThread(PT* pt, Game* game, const GameEvent* event))
+{
+  char status;
+
+  PT_BEGIN(pt);
+  while (1)
   {
-    for(int i = 0; i < game->info.sequenceLength - 1; i++)
+    Screen_Show(&roundScreen, (uint32_t[]){game->info.round});
+    PT_DELAY(pt, event, 1500);
+
+    do
     {
-      if(game->info.playerInputs[0][i] != game->info.playerInputs[1][i])
+      showPlayerTurn(game, 0);
+      PT_DELAY(pt, event, 1500);
+      PT_INIT(&game->turnPt);
+      PT_WAIT_UNTIL(pt, (status = playerTurn(&game->turnPt, game, event)) >= PT_EXITED);
+      if (status == PT_ENDED)
       {
-        game->state = GAME_RESULT;
-        return;
+        game->info.playerScores[game->info.currentPlayer] += game->info.playersLeft - 1;
+
+        // A full sequence ends the game
+        if (game->info.sequenceLength == SEQUENCE_MAX)
+        { PT_EXIT(pt); }
+        game->info.sequenceLength++;
       }
-      else
+    } while (!passTurn(&game->info, status == PT_EXITED) && game->info.playersLeft > 1);
+
+    if (game->info.playersLeft < 2)
+    { PT_EXIT(pt); }
+    game->info.round++;
+  }
+  PT_END(pt);
+}
+
+// Both game modes restart their thread on entry and kick it with EV_ROUND
+static void roundEntry(Game* game)
+{
+  game->awaitingButton = 0;
+  PT_INIT(&game->roundPt);
+  EventQueue_Push(&game->events, EV_ROUND, 0);
+}
+
+static int onePlayerHandler(Game* game, const GameEvent* event)
+{
+#ifdef LINK_UART
+  // Presses on the linked boards show in the corner of the player's turn
+  if (event->type == EV_LINK)
+  {
+    if (LINK_EVENT_KIND(event->param) == LINK_EV_INPUT && game->linked)
+    {
+      game->peerGlyph = colorGlyphs[LINK_EVENT_ARG(event->param) & 0x03];
+      if (game->awaitingButton)
+      { Screen_Set(PEER_ICON_FIELD, game->peerGlyph); }
+    }
+    return STATE_HANDLED;
+  }
+#endif
+  return (onePlayerThread(&game->roundPt, game, event) >= PT_EXITED) ? GAME_RESULT : STATE_HANDLED;
+}
+
+static int multiPlayerHandler(Game* game, const GameEvent* event)
+{
+  return (multiPlayerThread(&game->roundPt, game, event) >= PT_EXITED) ? GAME_RESULT : STATE_HANDLED;
+}
+
+/**
+ * @brief  Update the statistics kept in flash with the game just finished.
+ *         Values that did not change cost no flash write.
+ * @param  game: Pointer to the Game structure.
+ * @return 1 if a one player game beat the stored high score, 0 otherwise.
+ */
+static uint8_t recordGameStats(Game* game)
+{
+  uint32_t value = 0;
+  uint8_t newHighScore = 0;
+
+#if defined(SIMON_SOAK) && !defined(SIMON_HOST)
+  // Millions of soak games would wear the flash out, the host keeps the
+  // store in RAM
+  (void)game;
+  (void)value;
+#else
+  if (!Store_Get(STORE_GAMES_PLAYED, &value))
+  { value = 0; }
+  Store_Put(STORE_GAMES_PLAYED, value + 1);
+
+  if (!Store_Get(STORE_BEST_ROUND, &value) || game->info.round > value)
+  { Store_Put(STORE_BEST_ROUND, game->info.round); }
+
+  if (game->info.numPlayers == 1 &&
+      (!Store_Get(STORE_HIGH_SCORE, &value) || game->info.playerScores[0] > value))
+  {
+    Store_Put(STORE_HIGH_SCORE, game->info.playerScores[0]);
+    newHighScore = game->info.playerScores[0] > 0;
+  }
+#endif
+  return newHighScore;
+}
+
+/**
+ * @brief  Fill the scoreboard rows of a result screen, one player per row
+ *         in the order of the elimination list, and move on past them.
+ * @param  game: Pointer to the Game structure.
+ * @param  values: Filled with the label and the score of each row.
+ * @param  rows: Scoreboard rows of the screen.
+ */
+static void fillScoreboard(Game* game, uint32_t* values, uint8_t rows)
+{
+  for (uint8_t row = 0; row < rows; row++)
+  {
+    uint8_t player = game->resultPlayer;
+
+    if (player == PLAYER_NONE)
+    {
+      values[2 * row] = 0;
+      values[2 * row + 1] = SCREEN_BLANK;
+      continue;
+    }
+    values[2 * row] = player + 1;
+    values[2 * row + 1] = game->info.playerScores[player];
+    game->resultPlayer = game->info.nextPlayer[player];
+  }
+}
+
+static void gameResultEntry(Game* game)
+{
+  uint8_t newHighScore = recordGameStats(game);
+
+  game->resultPlayer = PLAYER_NONE;
+  if (game->info.numPlayers == 1 )
+  {
+    Screen_Show(&resultScoreScreen, (uint32_t[]){newHighScore, game->info.playerScores[0]});
+    armEventTimer(&game->stateTimer, 2000, 0);
+  }
+  else
+  {
+    // resultWinners: 0 tied, otherwise the number of the player with the
+    // highest score
+    uint32_t values[2 + 2 * RESULT_SCORE_ROWS];
+    uint16_t best = game->info.playerScores[0];
+    uint8_t winner = 1;
+
+    for (uint8_t player = 1; player < game->info.numPlayers; player++)
+    {
+      if (game->info.playerScores[player] > best)
       {
-        if(game->info.currentPlayer == 1)
-        { game->info.playerScores[0]++; }
-        else
-        { game->info.playerScores[1]++; }
+        best = game->info.playerScores[player];
+        winner = player + 1;
       }
+      else if (game->info.playerScores[player] == best)
+      { winner = 0; }
     }
+
+    closeStandings(&game->info);
+    game->resultPlayer = game->info.eliminated;
+    values[0] = newHighScore;
+    values[1] = winner;
+    fillScoreboard(game, &values[2], RESULT_SCORE_ROWS);
+    Screen_Show(&resultWinnerScreen, values);
+    armEventTimer(&game->stateTimer, 3000, 0);
+  }
+  TRACE_FLUSH();
+}
+
+// The scoreboard goes on over as many screens as the players need
+static int gameResultHandler(Game* game, const GameEvent* event)
+{
+  if (event->type != EV_TIMEOUT)
+  { return STATE_UNHANDLED; }
+
+  if (game->resultPlayer != PLAYER_NONE)
+  {
+    uint32_t values[2 * SCREEN_ROWS];
+
+    fillScoreboard(game, values, SCREEN_ROWS);
+    Screen_Show(&scoreboardScreen, values);
+    armEventTimer(&game->stateTimer, 3000, 0);
+    return STATE_HANDLED;
+  }
+#ifdef LINK_UART
+  // A linked game ends on the rank among the boards, with the scores they sent so far
+  if (game->linked)
+  {
+    game->linked = 0;
+    Screen_Show(&rankScreen, (uint32_t[]){Link_Rank(game->info.playerScores[0]), Link_Peers() + 1,
+                                          Link_BestScore()});
+    armEventTimer(&game->stateTimer, 3000, 0);
+    return STATE_HANDLED;
+  }
+#endif
+  return PLAY_AGAIN;
+}
+
+static void sleepEntry(Game* game)
+{
+  Screen_Clear();
+}
+
+// Wait for joystick press to wake up
+static int wakeUpHandler(Game* game, const GameEvent* event)
+{
+  return (event->type == EV_JOY_PRESS) ? WELCOME : STATE_UNHANDLED;
+}
+
+static const StateRow stateTable[GAME_STATE_COUNT] =
+{
+  //                parent       initial        entry              exit              handler
+  [WELCOME]       = {NO_STATE,    NO_STATE,      welcomeEntry,      welcomeExit,      welcomeHandler},
+  [MENU]          = {NO_STATE,    START,         menuEntry,         menuExit,         menuHandler},
+  [START]         = {MENU,        NO_STATE,      startEntry,        NULL,             startHandler},
+  [PLAY_AGAIN]    = {MENU,        NO_STATE,      playAgainEntry,    NULL,             startHandler},
+  [PLAYER_MENU]   = {MENU,        PLAYER_SELECT, playerMenuEntry,   NULL,             NULL},
+  [PLAYER_SELECT] = {PLAYER_MENU, NO_STATE,      playerSelectEntry, playerSelectExit, playerSelectHandler},
+  [ONE_PLAYER]    = {NO_STATE,    NO_STATE,      roundEntry,        NULL,             onePlayerHandler},
+  [MULTI_PLAYER]  = {NO_STATE,    NO_STATE,      roundEntry,        NULL,             multiPlayerHandler},
+  [GAME_RESULT]   = {NO_STATE,    NO_STATE,      gameResultEntry,   NULL,             gameResultHandler},
+  [SLEEP]         = {NO_STATE,    WAKE_UP,       sleepEntry,        NULL,             NULL},
+  [WAKE_UP]       = {SLEEP,       NO_STATE,      NULL,              NULL,             wakeUpHandler},
+};
+
+/**
+ * @brief  Check if a state is the same as, or encloses, another state.
+ * @param  ancestor: Possible enclosing state.
+ * @param  state: State to test.
+ */
+static uint8_t isWithin(uint8_t ancestor, uint8_t state)
+{
+  for (; state != NO_STATE; state = stateTable[state].parent)
+  {
+    if (state == ancestor)
+    { return 1; }
   }
+  return 0;
 }
 
 /**
- * @brief  Run the main game loop, managing game states and transitions.
+ * @brief  Move to a new state, running the exit actions up to the closest
+ *         common parent and the entry actions down to the new leaf state.
  * @param  game: Pointer to the Game structure.
- * @param  joystick: Pointer to the Joystick handle structure.
+ * @param  target: State to move to, drilled down through initial children.
  */
-void Game_Run(Game* game, Joystick_HandleTypeDef* joystick)
+static void transition(Game* game, uint8_t target)
 {
-    static int directionDelay = 0;
-    static JoyStickDirection direction = JOY_IDLE, lastDirection = JOY_IDLE;
-    
-    // FSM to manage game states
-    switch(game->state)
-    {
-      // Display WELCOME message and 
-      //Push to start prompt after 2 seconds
-      case WELCOME:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Welcome to the");
-        snprintf(lineTwo, sizeof(lineTwo), "Simon Game");
-        displayOnLCD(lineOne, lineTwo);
-        HAL_Delay(2000);  
-        
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Push To Start!");
-        snprintf(lineTwo, sizeof(lineTwo), "");
-        displayOnLCD(lineOne, lineTwo);
-        game->state = START;
-
-        buttonTimer = 0; 
-        __HAL_TIM_SET_COUNTER(&htim2, 0);
-        break;
+  uint8_t path[GAME_STATE_COUNT];
+  uint8_t depth = 0;
+  uint8_t state = game->state;
 
-      // Check if Joystick is pressed to start the game
-      //Wait 10 seconds and if no input return to SLEEP state
-      case START:
-        while (buttonTimer < 100) // 10 seconds timeout
-        {
-          if (Joystick_Pressed(joystick)) 
-          {  
-            game->state = PLAYER_MENU;  
-            break; 
-          }  
-        }  
-        
-        if (game->state != PLAYER_MENU)
-        { game->state = SLEEP; }
-        break;
+  while (stateTable[target].initial != NO_STATE)
+  { target = stateTable[target].initial; }
 
-      // Display Player selection menu
-      case PLAYER_MENU:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "<1> player OR");
-        snprintf(lineTwo, sizeof(lineTwo), "2 players?");
-        displayOnLCD(lineOne, lineTwo);
-        game->info.numPlayers = 1;  // Default to 1 player
-        game->state = PLAYER_SELECT;
-        break;
+#ifdef SIMON_SOAK
+  Soak_OnTransition(game, game->state, target);
+#endif
 
-      // Handle Player selection based on joystick UP/DOWN input
-      case PLAYER_SELECT:
-        // Read the joystick input to determine the number of players
-        direction = Joystick_GetDirection(joystick);
+  // The state timer only ever belongs to the state that armed it
+  stopEventTimer(&game->stateTimer);
 
-        // Adding "debounce" logic to help resolve jittery input
-        //causing direciton UP to be seen once
-        if(directionDelay < 3 && lastDirection == JOY_UP && direction == JOY_IDLE)
-        {
-          direction = JOY_UP;
-          directionDelay++;
-        }
-        else 
-        { directionDelay = 0; }
+  // Exit up to the common parent, a self transition exits the state too
+  while (state != NO_STATE && (state == target || !isWithin(state, target)))
+  {
+    if (stateTable[state].exit)
+    { stateTable[state].exit(game); }
+    state = stateTable[state].parent;
+  }
 
-        // Update display only if joystick direction has changed
-        if (direction != JOY_IDLE && direction != lastDirection)
-        {
-          
-          if (direction == JOY_UP)
-          {
-            LCD_Cls();
-            snprintf(lineOne, sizeof(lineOne), "<1> player OR");
-            snprintf(lineTwo, sizeof(lineTwo), "2 players?");
-            displayOnLCD(lineOne, lineTwo);
-            game->info.numPlayers = 1;
-            direction = JOY_UP;
-          }    
-          else if (direction == JOY_DOWN) 
-          {
-            LCD_Cls();
-            snprintf(lineOne, sizeof(lineOne), "1 player OR");
-            snprintf(lineTwo, sizeof(lineTwo), "<2> players?");
-            displayOnLCD(lineOne, lineTwo);
-            game->info.numPlayers = 2;
-          }
+  // Enter from just below the common parent down to the target
+  for (uint8_t s = target; s != state; s = stateTable[s].parent)
+  { path[depth++] = s; }
 
-          lastDirection = direction;  // store last direction
-        }   
+  game->state = target;
+  while (depth > 0)
+  {
+    uint8_t s = path[--depth];
+    if (stateTable[s].entry)
+    { stateTable[s].entry(game); }
+  }
+}
 
-        // Check if joystick is pressed to confirm selection
-        // Move to the state which matches the mode selected
-        if (Joystick_Pressed(joystick)) 
-        {
-          if (game->info.numPlayers == 1)
-          {
-            game->state = ONE_PLAYER;
-            game->info.currentPlayer = 1;
+/**
+ * @brief  Pass an event to the current state, bubbling it up to the parent
+ *         states until one of them handles it.
+ * @param  game: Pointer to the Game structure.
+ * @param  event: Pointer to the event.
+ */
+static void dispatch(Game* game, const GameEvent* event)
+{
+#ifdef SIMON_SOAK
+  Soak_OnDispatch(game, event->type);
+#endif
+  for (uint8_t state = game->state; state != NO_STATE; state = stateTable[state].parent)
+  {
+    if (stateTable[state].handler == NULL)
+    { continue; }
 
-            // Seed the random number generator using joystick readings
-            uint16_t seed[2] = {0};
-            Joystick_ReadXY(joystick, seed);
-            srand(seed[0] ^ seed[1]);
-          }
-          else 
-            game->state = TWO_PLAYERS;
-
-          game->info.round = 1;
-          game->info.sequenceLength = 1;
-          game->info.playerScores[0] = 0;
-          game->info.playerScores[1] = 0;
-          game->info.sequenceSpeed = 1000; // Initial speed 1 s
-        }
-        break;
-      
-        // For LCD+Joystick testing purposes only,
-        // Display the mode type selected, wait 2 seconds then
-        // return to the PLAYER SELECT state for further 
-        // joystick to LCD interaction testing
-      case ONE_PLAYER:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Round %d", game->info.round);
-        snprintf(lineTwo, sizeof(lineTwo), "Simon's Turn!");
-        displayOnLCD(lineOne, lineTwo);
-        HAL_Delay(1000);  //wait 1/2 second
-        computerTurn(game);
-
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Player's Turn!");
-        snprintf(lineTwo, sizeof(lineTwo), "Score: %d", game->info.playerScores[0]);
-        displayOnLCD(lineOne, lineTwo);
-        HAL_Delay(1000);  //wait 1/2 second
-        playerTurn(game);
-
-        if(game->state != GAME_RESULT)
-        {
-          // Prepare for next round
-          game->info.round++;
-          game->info.sequenceLength++;
-        }
-        break;
+    int next = stateTable[state].handler(game, event);
+    if (next == STATE_UNHANDLED)
+    { continue; }
 
-      case TWO_PLAYERS:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Round %d", game->info.round);
-        snprintf(lineTwo, sizeof(lineTwo), "");
-        displayOnLCD(lineOne, lineTwo);
-        HAL_Delay(500);  //wait 1/2 second
-        
-        snprintf(lineOne, sizeof(lineOne), "Player 1's Turn");
-        snprintf(lineTwo, sizeof(lineTwo), "Score: %d", game->info.playerScores[0]);
-        displayOnLCD(lineOne, lineTwo);
-        HAL_Delay(500);  //wait 1/2 second
-        game->info.currentPlayer = 1;
-        playerTurn(game);
-
-        if (game->state != GAME_RESULT)
-        {
-          if(game->info.round > 1)
-          {
-            compareSequences(game);
-            if(game->state != GAME_RESULT)
-            { game->info.playerScores[0]++; }
-          }
-               
-          // Player 2's turn
-          game->info.sequenceLength++;
-          LCD_Cls();
-          snprintf(lineOne, sizeof(lineOne), "Player 2's Turn");
-          snprintf(lineTwo, sizeof(lineTwo), "Score: %d", game->info.playerScores[1]);
-          displayOnLCD(lineOne, lineTwo);
-          HAL_Delay(500);  //wait 1/2 second
-          game->info.currentPlayer = 2;
-          playerTurn(game);
-
-          if(game->state != GAME_RESULT)
-          {
-            compareSequences(game);
-            if(game->state != GAME_RESULT)
-            {
-              // Prepare for next round
-              game->info.round++;
-              game->info.sequenceLength++;
-            }
-          }
-        }
-        break;
+    if (next != STATE_HANDLED)
+    { transition(game, next); }
+    return;
+  }
+}
 
-      case GAME_RESULT:
-        LCD_Cls();
-        if (game->info.numPlayers == 1 )
-        {
-          snprintf(lineOne, sizeof(lineOne), "Game Over!");
-          snprintf(lineTwo, sizeof(lineTwo), "P1 Score: %d", game->info.playerScores[0]);
-          displayOnLCD(lineOne, lineTwo);
-          HAL_Delay(1000);  //wait 2 seconds
-        }
-        else
-        {
-          snprintf(lineOne, sizeof(lineOne), "Game Over!");
-          if(game->info.playerScores[0] > game->info.playerScores[1])
-          {
-            snprintf(lineTwo, sizeof(lineTwo), "Player 1 Wins");
-          }
-          else if(game->info.playerScores[0] < game->info.playerScores[1])
-          {
-            snprintf(lineTwo, sizeof(lineTwo), "Player 2 Wins");
-          }
-          else
-          {
-            snprintf(lineTwo, sizeof(lineTwo), "Players Tied");
-          }
-          displayOnLCD(lineOne, lineTwo);
-          HAL_Delay(2000);  //wait 1 second
+/**
+ * @brief  Turn a joystick axis sample into EV_JOY_UP / EV_JOY_DOWN.
+ * @param  game: Pointer to the Game structure.
+ * @param  joystick: Pointer to the Joystick handle structure.
+ * @return The event type to dispatch, EV_NONE if the direction did not change.
+ */
+static uint8_t sampleJoystick(Game* game, Joystick_HandleTypeDef* joystick)
+{
+  // Read the joystick input to determine the number of players
+  JoyStickDirection direction = Joystick_GetDirection(joystick);
 
-          snprintf(lineOne, sizeof(lineOne), "P1 Score: %d", game->info.playerScores[0]);
-          snprintf(lineTwo, sizeof(lineTwo), "P2 Score: %d", game->info.playerScores[1]);
-          displayOnLCD(lineOne, lineTwo);
-          HAL_Delay(2000);  //wait 2 seconds
-        }
-        game->state = PLAY_AGAIN;
-        break;
-      
-      case PLAY_AGAIN:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "Play Again?");
-        snprintf(lineTwo, sizeof(lineTwo), "Push to Start");
-        displayOnLCD(lineOne, lineTwo);
-        game->state = START;
-
-        buttonTimer = 0; 
-        __HAL_TIM_SET_COUNTER(&htim2, 0);
-        break;
+  // Adding "debounce" logic to help resolve jittery input
+  //causing a direction to be seen twice
+  if(game->directionDelay < 3 && game->lastDirection != JOY_IDLE && direction == JOY_IDLE)
+  {
+    direction = game->lastDirection;
+    game->directionDelay++;
+  }
+  else
+  { game->directionDelay = 0; }
 
-      case SLEEP:
-        LCD_Cls();
-        snprintf(lineOne, sizeof(lineOne), "");
-        snprintf(lineTwo, sizeof(lineTwo), "");
-        displayOnLCD(lineOne, lineTwo);
-        game->state = WAKE_UP;
-        break;
+  // Report only if joystick direction has changed, going back to the
+  // center lets the next push of the same direction count again
+  if (direction == game->lastDirection)
+  { return EV_NONE; }
 
-      case WAKE_UP:
-        // Wait for joystick press to wake up
-        if (Joystick_Pressed(joystick)) 
-        { game->state = WELCOME;  } 
-        break;
+  game->lastDirection = direction;  // store last direction
+  if (direction == JOY_IDLE)
+  { return EV_NONE; }
+  return (direction == JOY_UP) ? EV_JOY_UP : EV_JOY_DOWN;
+}
 
-      default:
-        game->state = SLEEP;
-        break;
+/**
+ * @brief  Initialize the game state and information. Must not be called
+ *         again while the game's timers are running.
+ * @param  game: Pointer to the Game structure to initialize.
+ */
+void Game_Init(Game* game)
+{
+    memset(game, 0, sizeof(Game));
+    EventQueue_Init(&game->events);
+
+    for (int color = 0; color < 4; color++)
+    {
+      game->buttons[color].port = colorLeds[color].port;
+      game->buttons[color].pin = colorLeds[color].pin;
     }
+    game->stateTimer.type = EV_TIMEOUT;
+    game->inactivityTimer.type = EV_INACTIVE;
+    game->sampleTimer.type = EV_JOY_SAMPLE;
+    game->scrollTimer.type = EV_SCROLL;
+    game->stateTimer.queue = &game->events;
+    game->inactivityTimer.queue = &game->events;
+    game->sampleTimer.queue = &game->events;
+    game->scrollTimer.queue = &game->events;
+    game->lastDirection = JOY_IDLE;
+    game->noteMs = 1000;   // Initial speed 1 s
+
+    Screen_Init();
+#ifdef LINK_UART
+    Link_Init(&game->events);
+#endif
+#ifdef CONSOLE_UART
+    Console_Init(game);
+#endif
+    CpuLoad_Init();
+    game->state = NO_STATE;
+    TRACE_START();
+    transition(game, WELCOME);
+    game->ready = 1;
+}
+
+/**
+ * @brief  Run the main game loop, dispatching one queued event to the
+ *         state machine or sleeping until the next interrupt.
+ * @param  game: Pointer to the Game structure.
+ * @param  joystick: Pointer to the Joystick handle structure.
+ */
+void Game_Run(Game* game, Joystick_HandleTypeDef* joystick)
+{
+  GameEvent event;
+
+  game->joystick = joystick;
+#ifdef LINK_UART
+  Link_Poll();
+#endif
+#ifdef CONSOLE_UART
+  Console_Poll();
+#endif
+#ifdef TELEMETRY_UART
+  Telemetry_Poll(game);
+#endif
+  CpuLoad_Update();
+  if (!nextEvent(game, &event))
+  {
+    idle(game);
+    return;
+  }
+
+  if (event.type == EV_JOY_SAMPLE)
+  {
+#ifdef SIMON_SOAK
+    // The soak bot posts the joystick directions itself
+    return;
+#endif
+    event.type = sampleJoystick(game, joystick);
+    if (event.type == EV_NONE)
+    { return; }
+  }
+
+  // Joystick press and directions and the color buttons are the inputs
+  if (event.type <= EV_BUTTON)
+  { TRACE_INPUT(event.type, event.param); }
+
+  dispatch(game, &event);
+
+  // Input latency, from the press queued to the game done with it
+  if (event.type == EV_BUTTON)
+  {
+    uint32_t us = Cycles_ToNs(Cycles_Now() - game->pressCycles) / 1000;
+    game->latencyUs = (us < UINT16_MAX) ? us : UINT16_MAX;
+    if (game->latencyUs > game->latencyMaxUs)
+    { game->latencyMaxUs = game->latencyUs; }
+  }
+}
+
+/**
+ * @brief  Queue an input event as if it came from the buttons or joystick.
+ * @param  game: Pointer to the Game structure.
+ * @param  type: GameEventType to queue.
+ * @param  param: Event parameter, the color index for EV_BUTTON.
+ * @return 1 if the event was queued, 0 if the queue was full.
+ */
+uint8_t Game_PostEvent(Game* game, uint8_t type, uint8_t param)
+{
+  if (type == EV_BUTTON)
+  { game->pressCycles = Cycles_Now(); }
+  return EventQueue_Push(&game->events, type, param);
+}
+
+/**
+ * @brief  Seed rand() with a fixed value for the next one player games,
+ *         so a script can replay them.
+ * @param  game: Pointer to the Game structure.
+ * @param  seed: rand() seed up to 4095 as traces keep 12 bits, 0 to seed
+ *         from the joystick again.
+ */
+void Game_SetSeed(Game* game, uint16_t seed)
+{
+  game->seed = seed;
+}
+
+/**
+ * @brief  Set how long Simon plays each color, in the game going on and
+ *         the next ones.
+ * @param  game: Pointer to the Game structure.
+ * @param  noteMs: Note length in milliseconds.
+ */
+void Game_SetSpeed(Game* game, uint16_t noteMs)
+{
+  game->noteMs = noteMs;
+  game->info.sequenceSpeed = noteMs;
+}
+
+/**
+ * @brief  Input the player's turn is waiting for.
+ * @param  game: Pointer to the Game structure.
+ * @return Index of the awaited input in the sequence, -1 if no color button
+ *         press is expected right now.
+ */
+int Game_AwaitedInput(const Game* game)
+{
+  return game->awaitingButton ? game->turnIndex : -1;
 }
 
 
 /**
- * @brief  Handle the computer's turn in the game.
+ * @brief  Handle the computer's turn in the game. Runs as a thread resumed
+ *         with every event received by the game mode state.
+ * @param  pt: Pointer to the thread state.
  * @param  game: Pointer to the Game structure.
+ * @param  event: Pointer to the event being dispatched.
  */
-void computerTurn(Game* game)
+PT_THREAD(computerTurn(PT* pt, Game* game, const GameEvent* event))
 {
+  PT_BEGIN(pt);
+
   // Add one new random color to the end of the sequence
   // 0 - Red, 1 - Blue, 2 - Yellow, 3 - Green
-  int colorRandom = rand() % 4;
-  game->info.sequence[game->info.sequenceLength - 1] = colorRandom;
+  // A linked game has the whole sequence from Simon already
+  if (!game->linked)
+  {
+    int colorRandom = rand() % 4;
+    game->info.sequence[game->info.sequenceLength - 1] = colorRandom;
+  }
 
-  for(int i = 0; i < game->info.sequenceLength; i++)
+  for(game->turnIndex = 0; game->turnIndex < game->info.sequenceLength; game->turnIndex++)
   {
-    
-    // Light up the corresponding LED based on the color code
-    switch(game->info.sequence[i])
-    {
-      case 0: // Red
-        HAL_GPIO_WritePin(LEDR_GPIO_Port, LEDR_Pin, GPIO_PIN_SET);
-        __HAL_TIM_SET_PRESCALER(&htim16,283); 
-        HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
-        HAL_Delay(game->info.sequenceSpeed);
-        HAL_GPIO_WritePin(LEDR_GPIO_Port, LEDR_Pin, GPIO_PIN_RESET);
-        HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
-        break;
-      case 1: // Blue
-        HAL_GPIO_WritePin(LEDB_GPIO_Port, LEDB_Pin, GPIO_PIN_SET);
-        __HAL_TIM_SET_PRESCALER(&htim16,189); 
-        HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
-        HAL_Delay(game->info.sequenceSpeed);
-        HAL_GPIO_WritePin(LEDB_GPIO_Port, LEDB_Pin, GPIO_PIN_RESET);
-        HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
-        break;
-      case 2: // Yellow
-        HAL_GPIO_WritePin(LEDY_GPIO_Port, LEDY_Pin, GPIO_PIN_SET);
-        __HAL_TIM_SET_PRESCALER(&htim16,225); 
-        HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
-        HAL_Delay(game->info.sequenceSpeed);
-        HAL_GPIO_WritePin(LEDY_GPIO_Port, LEDY_Pin, GPIO_PIN_RESET);
-        HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
-        break;
-      case 3: // Green
-        HAL_GPIO_WritePin(LEDG_GPIO_Port, LEDG_Pin, GPIO_PIN_SET);
-        __HAL_TIM_SET_PRESCALER(&htim16,378); 
-        HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
-        HAL_Delay(game->info.sequenceSpeed);
-        HAL_GPIO_WritePin(LEDG_GPIO_Port, LEDG_Pin, GPIO_PIN_RESET);
-        HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
-        break;
-      default:
-        HAL_GPIO_WritePin(LEDR_GPIO_Port, LEDR_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(LEDB_GPIO_Port, LEDB_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(LEDY_GPIO_Port, LEDY_Pin, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(LEDG_GPIO_Port, LEDG_Pin, GPIO_PIN_RESET);
-        break;
-    }
-    HAL_Delay(500); // Short delay between colors
+    // Light up the corresponding LED and play its tone, the timer wheel
+    // turns both off once the note is over
+    Screen_Set(SIMON_ICON_FIELD, colorGlyphs[game->info.sequence[game->turnIndex]]);
+    playTone(game, game->info.sequence[game->turnIndex], game->info.sequenceSpeed);
+    PT_YIELD_UNTIL(pt, event->type == EV_SOUND_DONE && event->param == SOUND_TONE);
+    Screen_Set(SIMON_ICON_FIELD, GLYPH_NONE);
+    PT_DELAY(pt, event, NOTE_GAP_MS);
   }
+
+  PT_END(pt);
 }
 
-void debounceButtons(GPIO_TypeDef *port, uint16_t pin, Button *button, int pre)
+/**
+ * @brief  Debounce one button, called on every button sample of Game_Tick.
+ * @param  port: GPIO port of the button input.
+ * @param  pin: GPIO pin of the button input.
+ * @param  button: Pointer to the Button state, its LED lights while pressed.
+ * @param  pre: TIM16 prescaler of the button tone.
+ * @return 1 when a new press is registered, 0 otherwise.
+ */
+uint8_t debounceButtons(GPIO_TypeDef *port, uint16_t pin, Button *button, int pre)
 {
   switch(button->state)
   {
@@ -413,11 +1214,14 @@ void debounceButtons(GPIO_TypeDef *port, uint16_t pin, Button *button, int pre)
     case 1: // check stable low
       if(HAL_GPIO_ReadPin(port, pin) == GPIO_PIN_RESET)
       {
-        button->stable = 1;   // REGISTER PRESS
         button->state = 2;
-        HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_SET);
-        __HAL_TIM_SET_PRESCALER(&htim16,pre); 
-        HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
+        if (button->port)
+        {
+          HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_SET);
+          __HAL_TIM_SET_PRESCALER(&htim16,pre);
+          HAL_TIM_PWM_Start(&htim16, TIM_CHANNEL_1);
+        }
+        return 1;   // REGISTER PRESS
       }
       else
         button->state = 0;
@@ -427,136 +1231,99 @@ void debounceButtons(GPIO_TypeDef *port, uint16_t pin, Button *button, int pre)
         if(HAL_GPIO_ReadPin(port, pin) == GPIO_PIN_SET)
         {
           button->state = 0;
-          HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_RESET);
-          HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
+          if (button->port)
+          {
+            HAL_GPIO_WritePin(button->port, button->pin, GPIO_PIN_RESET);
+            HAL_TIM_PWM_Stop(&htim16, TIM_CHANNEL_1);
+          }
         }
         break;
   }
+  return 0;
 }
 
 /**
- * @brief Helper function created for checking if which color button was pressed.
- * 
- * @return int button index: 0-Red, 1-Blue, 2-Yellow, 3-Green, -1 no button pressed
- */
-int getButtonPressed()
-{
-  static char msg[500] = {0}; 
-  if(redButton.stable)
-  { 
-    redButton.stable = 0;
-    snprintf(msg, sizeof(msg), "Red pressed\r\n");
-    HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
-    return 0; 
-  }
-  else if(blueButton.stable) 
-  { 
-    blueButton.stable = 0;
-    snprintf(msg, sizeof(msg), "Blue pressed\r\n");
-    HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
-    return 1; 
-  }
-  else if(yellowButton.stable) 
-  {
-    yellowButton.stable = 0;
-    snprintf(msg, sizeof(msg), "Yellow pressed\r\n");
-    HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
-    return 2; 
-  }
-  else if(greenButton.stable)
-  {  
-    greenButton.stable = 0;
-    snprintf(msg, sizeof(msg), "Green pressed\r\n");
-    HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
-    return 3; 
-  }
-  else
-  { return -1; }// no button pressed
-}
-
-/**
- * @brief  Handle the player's turn in the game.
+ * @brief  Handle the player's turn in the game. Runs as a thread resumed
+ *         with every event received by the game mode state.
+ * @param  pt: Pointer to the thread state.
  * @param  game: Pointer to the Game structure.
+ * @param  event: Pointer to the event being dispatched.
+ * @return PT_ENDED if the player repeated the sequence, PT_EXITED on a
+ *         wrong input, PT_YIELDED while waiting.
  */
-void playerTurn(Game* game)
+PT_THREAD(playerTurn(PT* pt, Game* game, const GameEvent* event))
 {
   int buttonIndex;
 
-  for(int i = 0; i < game->info.sequenceLength; i++)
+  PT_BEGIN(pt);
+
+  for(game->turnIndex = 0; game->turnIndex < game->info.sequenceLength; game->turnIndex++)
   {
-    buttonIndex = -1;
+    showPlayerTurn(game, game->turnIndex);
+    game->awaitingButton = 1;
+    PT_YIELD_UNTIL(pt, event->type == EV_BUTTON);
+    game->awaitingButton = 0;
+    buttonIndex = event->param;
+#ifdef LINK_UART
+    if (game->linked)
+    { Link_SendInput(game->info.round, game->turnIndex, buttonIndex); }
+#endif
 
-    while(buttonIndex < 0)
+    if(game->info.numPlayers > 1 && game->turnIndex == game->info.sequenceLength - 1)
     {
-      buttonIndex = getButtonPressed();
-      if(buttonIndex >= 0)
-      {
-        game->info.playerInputs[game->info.currentPlayer - 1][i] = buttonIndex;
-
-        // Check immediately if wrong button pressed
-        if(game->info.numPlayers == 1)
-        {
-          // 1-player mode: check against Simon's sequence
-          if(buttonIndex != game->info.sequence[i])
-          {
-            LCD_Cls();
-            LCD_GotoXY(0, 0);
-            LCD_Print("Wrong! Game Over");
-            HAL_GPIO_WritePin(GPIOB, BUZZA_Pin, GPIO_PIN_SET);
-            HAL_Delay(1000);
-            HAL_GPIO_WritePin(GPIOB, BUZZA_Pin, GPIO_PIN_RESET);
-            game->state = GAME_RESULT;
-            return;
-          }
-          game->info.playerScores[0]++;
-        }
-        else if(game->info.numPlayers == 2)
-        {
-          // 2-player mode: check against other player's sequence (except for new color)
-          int otherPlayer = (game->info.currentPlayer == 1) ? 1 : 0;
-
-          // Only check if not adding new color (i < sequenceLength - 1)
-          if(i < game->info.sequenceLength - 1)
-          {
-            if(buttonIndex != game->info.playerInputs[otherPlayer][i])
-            {
-              LCD_Cls();
-              LCD_GotoXY(0, 0);
-              LCD_Print("Wrong! Game Over");
-              HAL_GPIO_WritePin(GPIOB, BUZZA_Pin, GPIO_PIN_SET);
-              HAL_Delay(1000);
-              HAL_GPIO_WritePin(GPIOB, BUZZA_Pin, GPIO_PIN_RESET);
-              game->state = GAME_RESULT;
-              return;
-            }
-            // Correct - add score
-            game->info.playerScores[game->info.currentPlayer - 1]++;
-          }
-        }
-
-        break;
-      }
+      // Several players: the last input adds the new color to the chain
+      game->info.sequence[game->turnIndex] = buttonIndex;
     }
+    else
+    {
+      // Check immediately if wrong button pressed, against Simon's sequence
+      // or the chain of the players
+      if(buttonIndex != game->info.sequence[game->turnIndex])
+      { break; }
+      game->info.playerScores[game->info.currentPlayer]++;
+    }
+  }
 
-    HAL_Delay(120);
+  if (game->turnIndex < game->info.sequenceLength)
+  {
+    // Wrong input, keep the message up until the buzzer stops
+    wrongInput(game);
+    PT_YIELD_UNTIL(pt, event->type == EV_SOUND_DONE && event->param == SOUND_BUZZER);
+    PT_EXIT(pt);
   }
+
+  showPlayerTurn(game, game->turnIndex);
+  PT_END(pt);
 }
 
 /**
- * @brief  Timer period elapsed callback.
- * @param  htim: Pointer to a TIM_HandleTypeDef structure that contains
- *                the configuration information for TIM module.
+ * @brief  Debounce the buttons wired to the board and queue their presses.
+ *         Called from the TIM2 period elapsed interrupt every 10 ms, the
+ *         buttons are sampled every DEBOUNCE_TICKS of them so a press must
+ *         stay low for two samples 100 ms apart, as with the 100 ms TIM2.
+ * @param  game: Pointer to the Game attached to the buttons.
  */
-void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+void Game_Tick(Game* game)
 {
-  //static char msg[500];
-    if (htim->Instance == TIM2)
-    { 
-      buttonTimer++;  
+  // TIM2 starts before the game for Delay_us and the timer wheel
+  if (!game->ready)
+  { return; }
+  if (++game->debounceTicks < DEBOUNCE_TICKS)
+  { return; }
+  game->debounceTicks = 0;
 
-      debounceButtons(RedButton_GPIO_Port, RedButton_Pin, &redButton, 283);
-      debounceButtons(BlueButton_GPIO_Port, BlueButton_Pin, &blueButton,189);
-      debounceButtons(YellowButtonm_GPIO_Port, YellowButtonm_Pin, &yellowButton,225);
-      debounceButtons(GreenButton_GPIO_Port, GreenButton_Pin, &greenButton,378);
+  for (uint8_t color = 0; color < 4; color++)
+  {
+    if (debounceButtons(colorInputs[color].port, colorInputs[color].pin,
+                        &game->buttons[color], colorTones[color]))
+    {
+      game->pressCycles = Cycles_Now();
+      EventQueue_Push(&game->events, EV_BUTTON, color);
     }
-}
\ No newline at end of file
+  }
+
+  // The joystick handle arrives with the first Game_Run
+  if (game->joystick &&
+      debounceButtons(game->joystick->buttonPort, game->joystick->buttonPin, &game->joystickButton, 0))
+  { EventQueue_Push(&game->events, EV_JOY_PRESS, 0); }
+}
@@ -0,0 +1,222 @@
+/*
+ * Micro-benchmarks of the driver and game primitives, built with
+ * make -f STM32Make.make VARIANT=BENCH.
+ *
+ * Each kernel runs a fixed number of times between two readings of the DWT
+ * cycle counter. The TIM2 and SysTick interrupts keep running, as they do
+ * in the game, so the minimum is the figure to compare and the maximum shows
+ * how much an interrupt can add. The report goes to USART1 as one line per
+ * kernel:
+ *
+ *   bench name=lcd_data runs=1000 min=1234 avg=1250 max=2100 ns=38562
+ *
+ * with cycles for min, avg and max and the average in nanoseconds. Capture
+ * it and compare it with tools/bench_diff.py.
+ *
+ * Built with LCD_BUS=I2C the LCD kernels only queue bytes for the backpack,
+ * and screen_frame_sync adds the time until the bytes are on the display.
+ * Diff the reports of both buses to compare the transports.
+ */
+
+#include "bench.h"
+
+#ifdef SIMON_BENCH
+
+#include "cycles.h"
+#include "lcd1602.h"
+#include "lcdfmt.h"
+#include "screen.h"
+#include "SimonGame.h"
+#include "usart.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+  const char* name;
+  void (*kernel)(void);
+  uint16_t runs;
+} BenchKernel;
+
+static Joystick_HandleTypeDef* benchJoystick;
+static Game benchGame;        // scores for the screen kernels
+static Button benchButton;    // no LED, debounceButtons only reads the pin
+static char benchLine[LCDFMT_COLS + 1];
+
+static const ScreenField benchScoreField[] = {{1, 7, 5, FIELD_NUMBER, NULL}};
+static const ScreenTemplate benchScoreScreen = {{"Player's Turn!", "Score:"}, 1, benchScoreField};
+static const ScreenTemplate benchFrames[2] =
+{
+  {{"0123456789ABCDEF", "FEDCBA9876543210"}, 0, NULL},
+  {{"abcdefghijklmnop", "ponmlkjihgfedcba"}, 0, NULL},
+};
+
+static void lcdData(void)
+{
+  LCD_data_4bit('A');
+}
+
+static void lcdPrint16(void)
+{
+  LCD_GotoXY(0, 0);
+  LCD_Print("0123456789ABCDEF");
+}
+
+// One marquee step, against the 16 characters of lcd_print16
+static void lcdShift(void)
+{
+  LCD_cmd_4bit(0x18);
+}
+
+static void lcdCls(void)
+{
+  LCD_Cls();
+}
+
+// Joystick_UseCenter is a single Read_ADC_Channel and a compare
+static void adcChannel(void)
+{
+  Joystick_UseCenter(benchJoystick, benchJoystick->centerX);
+}
+
+static void joystickReadXY(void)
+{
+  uint16_t xy[2];
+  Joystick_ReadXY(benchJoystick, xy);
+}
+
+static void debounce(void)
+{
+  debounceButtons(RedButton_GPIO_Port, RedButton_Pin, &benchButton, 0);
+}
+
+// Both ways of building the score screen line
+static void screenSnprintf(void)
+{
+  snprintf(benchLine, sizeof(benchLine), "P1 Score: %d", benchGame.info.playerScores[0]);
+}
+
+static void screenLcdFmt(void)
+{
+  LcdFmt_Dec(benchLine, LcdFmt_Str(benchLine, 0, "P1 Score: "), benchGame.info.playerScores[0]);
+}
+
+// A score going up by one, the template is on the display after the first run.
+// lcd_cls runs last of the LCD kernels, so the display matches the blank shadow
+// Screen_Init left
+static void screenPatch(void)
+{
+  static uint32_t score;
+  Screen_Show(&benchScoreScreen, (uint32_t[]){score++});
+}
+
+// A screen change rewriting all 32 characters, queued only and on the display
+static void screenFrame(void)
+{
+  static uint8_t frame;
+  Screen_Show(&benchFrames[frame ^= 1], NULL);
+}
+
+static void screenFrameSync(void)
+{
+  screenFrame();
+  LCD_Sync();
+}
+
+// Glyph already resident, the cost of every glyph on a screen after the first upload
+static void glyphHit(void)
+{
+  Glyph_Code(GLYPH_RED);
+}
+
+// Same formatting and transmit as the color button log of the game
+static void uartLog(void)
+{
+  char msg[32];
+  snprintf(msg, sizeof(msg), "%s pressed\r\n", "Yellow");
+  HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
+}
+
+static const BenchKernel kernels[] =
+{
+  {"lcd_data",          lcdData,         BENCH_RUNS},
+  {"lcd_print16",       lcdPrint16,      BENCH_SLOW_RUNS},
+  {"lcd_shift",         lcdShift,        BENCH_SLOW_RUNS},
+  {"lcd_cls",           lcdCls,          BENCH_SLOW_RUNS},
+  {"adc_channel",       adcChannel,      BENCH_SLOW_RUNS},
+  {"joystick_read_xy",  joystickReadXY,  BENCH_SLOW_RUNS},
+  {"debounce_buttons",  debounce,        BENCH_RUNS},
+  {"screen_snprintf",   screenSnprintf,  BENCH_RUNS},
+  {"screen_lcdfmt",     screenLcdFmt,    BENCH_RUNS},
+  {"screen_patch",      screenPatch,     BENCH_RUNS},
+  {"screen_frame",      screenFrame,     BENCH_SLOW_RUNS},
+  {"screen_frame_sync", screenFrameSync, BENCH_SLOW_RUNS},
+  {"glyph_hit",         glyphHit,        BENCH_RUNS},
+  {"uart_log",          uartLog,         BENCH_SLOW_RUNS},
+};
+
+/**
+ * @brief  Send a line over USART1.
+ * @param  msg: Null terminated text.
+ */
+static void report(const char* msg)
+{
+  HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
+}
+
+/**
+ * @brief  Time one kernel and print its report line.
+ * @param  bench: Kernel to run.
+ */
+static void runKernel(const BenchKernel* bench)
+{
+  uint32_t min = UINT32_MAX, max = 0;
+  uint64_t sum = 0;
+  char msg[96];
+
+  for (uint16_t i = 0; i < bench->runs; i++)
+  {
+    uint32_t start = Cycles_Now();
+    bench->kernel();
+    uint32_t cycles = Cycles_Now() - start;
+
+    sum += cycles;
+    if (cycles < min)
+    { min = cycles; }
+    if (cycles > max)
+    { max = cycles; }
+  }
+
+  uint32_t avg = sum / bench->runs;
+  snprintf(msg, sizeof(msg), "bench name=%s runs=%u min=%lu avg=%lu max=%lu ns=%lu\r\n",
+           bench->name, bench->runs, (unsigned long)min, (unsigned long)avg,
+           (unsigned long)max, (unsigned long)Cycles_ToNs(avg));
+  report(msg);
+}
+
+/**
+ * @brief  Run every kernel and print the report, then clear the display
+ *         the LCD kernels wrote on.
+ * @param  joystick: Calibrated joystick handle.
+ */
+void Bench_Run(Joystick_HandleTypeDef* joystick)
+{
+  char msg[48];
+
+  benchJoystick = joystick;
+
+  benchGame.info.numPlayers = 1;
+  benchGame.info.playerScores[0] = 1234;
+
+  Screen_Init();
+  Cycles_Init();
+  snprintf(msg, sizeof(msg), "bench begin clock=%lu\r\n", (unsigned long)SystemCoreClock);
+  report(msg);
+  for (uint8_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); i++)
+  { runKernel(&kernels[i]); }
+  report("bench end\r\n");
+
+  Screen_Clear();
+}
+
+#endif
@@ -0,0 +1,397 @@
+/*
+ * Command console for scripted play. USART1 receives into a circular DMA
+ * buffer and the idle line interrupt after each burst only moves the write
+ * position. Console_Poll, from the main loop, finds the lines completed
+ * since and parses them where they lie in the buffer, wrapping round its
+ * end, so no byte is copied. Replies go to the transmit queue of USART1
+ * that the DMA drains, so a command never waits for the 9600 baud line
+ * either.
+ */
+
+#include "console.h"
+
+#ifdef CONSOLE_UART
+
+#include "usart.h"
+#include "cpuload.h"
+#include "cycles.h"
+#include <stdio.h>
+#include <string.h>
+
+#define RX_MASK       (CONSOLE_RX_SIZE - 1)
+#define CMD_ERROR     0   // command results: reply "err"
+#define CMD_OK        1   // reply "ok"
+#define CMD_REPLIED   2   // the command sent its own reply
+
+// Characters of the reception buffer from at to end, positions counting on
+// past the end of the buffer and wrapping round it
+typedef struct
+{
+  uint16_t at;
+  uint16_t end;
+} Span;
+
+typedef struct
+{
+  const char* name;
+  uint8_t (*run)(Span* args);
+} Command;
+
+static Game* console;
+
+static uint8_t rxBuffer[CONSOLE_RX_SIZE];
+static volatile uint16_t rxHead;      // DMA write position at the last idle line
+static volatile uint8_t rxRestart;    // a UART error stopped the reception
+static uint16_t rxTail;               // start of the line being received
+static uint16_t rxScan;               // next character to look at
+
+static const char colorLetters[] = "rbyg";
+static const char* const isrNames[CPULOAD_ISRS] = {"tim2", "systick", "uart", "i2c"};
+
+static char charAt(uint16_t pos)
+{
+  return rxBuffer[pos & RX_MASK];
+}
+
+/**
+ * @brief  Queue a reply line, dropped whole if the transmit queue is full.
+ * @param  text: Reply without the line end.
+ */
+static void reply(const char* text)
+{
+  uint16_t length = strlen(text);
+
+  if (USART1_TxFree() >= length + 2)
+  {
+    USART1_Send(text, length);
+    USART1_Send("\r\n", 2);
+  }
+}
+
+/**
+ * @brief  Take the next word of a line.
+ * @param  line: Rest of the line, moved past the word.
+ * @param  word: Filled with the word.
+ * @return 1 if there was a word, 0 at the end of the line.
+ */
+static uint8_t nextWord(Span* line, Span* word)
+{
+  while (line->at != line->end && (charAt(line->at) == ' ' || charAt(line->at) == '\t'))
+  { line->at++; }
+  word->at = line->at;
+  while (line->at != line->end && charAt(line->at) != ' ' && charAt(line->at) != '\t')
+  { line->at++; }
+  word->end = line->at;
+  return word->end != word->at;
+}
+
+/**
+ * @brief  Compare a word with a text.
+ * @return 1 if they are the same, 0 otherwise.
+ */
+static uint8_t wordIs(const Span* word, const char* text)
+{
+  uint16_t pos = word->at;
+
+  while (*text && pos != word->end && charAt(pos) == *text)
+  {
+    pos++;
+    text++;
+  }
+  return !*text && pos == word->end;
+}
+
+/**
+ * @brief  Read the only argument left on a line as a decimal number.
+ * @param  args: Rest of the line.
+ * @param  value: Filled with the number.
+ * @return 1 if the line held one number of up to 5 digits, 0 otherwise.
+ */
+static uint8_t lastNumber(Span* args, uint32_t* value)
+{
+  Span word, extra;
+
+  if (!nextWord(args, &word) || nextWord(args, &extra) || word.end - word.at > 5)
+  { return 0; }
+  *value = 0;
+  for (uint16_t pos = word.at; pos != word.end; pos++)
+  {
+    char c = charAt(pos);
+    if (c < '0' || c > '9')
+    { return 0; }
+    *value = *value * 10 + (c - '0');
+  }
+  return 1;
+}
+
+// press r|b|y|g|0-3
+static uint8_t pressCommand(Span* args)
+{
+  Span word, extra;
+
+  if (!nextWord(args, &word) || nextWord(args, &extra) || word.end - word.at != 1)
+  { return CMD_ERROR; }
+  for (uint8_t color = 0; color < 4; color++)
+  {
+    if (charAt(word.at) == colorLetters[color] || charAt(word.at) == '0' + color)
+    { return Game_PostEvent(console, EV_BUTTON, color) ? CMD_OK : CMD_ERROR; }
+  }
+  return CMD_ERROR;
+}
+
+// joy up|down|press
+static uint8_t joyCommand(Span* args)
+{
+  Span word, extra;
+  uint8_t type;
+
+  if (!nextWord(args, &word) || nextWord(args, &extra))
+  { return CMD_ERROR; }
+  if (wordIs(&word, "up"))
+  { type = EV_JOY_UP; }
+  else if (wordIs(&word, "down"))
+  { type = EV_JOY_DOWN; }
+  else if (wordIs(&word, "press"))
+  { type = EV_JOY_PRESS; }
+  else
+  { return CMD_ERROR; }
+  return Game_PostEvent(console, type, 0) ? CMD_OK : CMD_ERROR;
+}
+
+// seed N, 0 to 4095
+static uint8_t seedCommand(Span* args)
+{
+  uint32_t seed;
+
+  if (!lastNumber(args, &seed) || seed > 0x0FFF)
+  { return CMD_ERROR; }
+  Game_SetSeed(console, seed);
+  return CMD_OK;
+}
+
+// speed MS
+static uint8_t speedCommand(Span* args)
+{
+  uint32_t noteMs;
+
+  if (!lastNumber(args, &noteMs) || noteMs < CONSOLE_SPEED_MIN || noteMs > CONSOLE_SPEED_MAX)
+  { return CMD_ERROR; }
+  Game_SetSpeed(console, noteMs);
+  return CMD_OK;
+}
+
+// info: state, the GameInfo fields, the scores of the players and Simon's sequence
+static uint8_t infoCommand(Span* args)
+{
+  const GameInfo* info = &console->info;
+  char text[USART1_TX_SIZE - 2];
+  Span extra;
+  int length;
+
+  if (nextWord(args, &extra))
+  { return CMD_ERROR; }
+
+  length = snprintf(text, sizeof(text), "ok state=%u players=%u player=%u left=%u round=%u length=%u speed=%lu awaiting=%d scores=",
+                    (unsigned)console->state, info->numPlayers, info->currentPlayer + 1, info->playersLeft,
+                    info->round, info->sequenceLength, (unsigned long)info->sequenceSpeed,
+                    Game_AwaitedInput(console));
+  for (uint8_t player = 0; player < info->numPlayers && length < (int)sizeof(text); player++)
+  {
+    length += snprintf(text + length, sizeof(text) - length, player ? ",%u" : "%u",
+                       info->playerScores[player]);
+  }
+  if (length < (int)sizeof(text))
+  { length += snprintf(text + length, sizeof(text) - length, " seq="); }
+  for (uint8_t i = 0; i < info->sequenceLength && length < (int)sizeof(text) - 1; i++)
+  { text[length++] = colorLetters[info->sequence[i] & 0x03]; }
+  text[(length < (int)sizeof(text)) ? length : (int)sizeof(text) - 1] = '\0';
+
+  reply(text);
+  return CMD_REPLIED;
+}
+
+// load: CPU busy over the last second and 10 s, and the share of each
+// interrupt handler, in percent
+static uint8_t loadCommand(Span* args)
+{
+  const CpuLoadStats* load = CpuLoad_Stats();
+  char text[96];
+  Span extra;
+
+  if (nextWord(args, &extra))
+  { return CMD_ERROR; }
+
+  snprintf(text, sizeof(text), "ok load=%u.%u load10=%u.%u tim2=%u.%u systick=%u.%u uart=%u.%u i2c=%u.%u",
+           load->load / 10, load->load % 10, load->load10s / 10, load->load10s % 10,
+           load->isr[CPULOAD_TIM2] / 10, load->isr[CPULOAD_TIM2] % 10,
+           load->isr[CPULOAD_SYSTICK] / 10, load->isr[CPULOAD_SYSTICK] % 10,
+           load->isr[CPULOAD_UART] / 10, load->isr[CPULOAD_UART] % 10,
+           load->isr[CPULOAD_I2C] / 10, load->isr[CPULOAD_I2C] % 10);
+  reply(text);
+  return CMD_REPLIED;
+}
+
+// isr: longest run, jitter, budget and runs over budget of each handler,
+// us/us/us/runs. isr reset clears them, isr NAME US sets the budget of one
+static uint8_t isrCommand(Span* args)
+{
+  Span word, extra;
+  uint32_t us;
+  char text[160];
+  int length;
+
+  if (nextWord(args, &word))
+  {
+    if (wordIs(&word, "reset"))
+    {
+      if (nextWord(args, &extra))
+      { return CMD_ERROR; }
+      CpuLoad_ResetIsrStats();
+      return CMD_OK;
+    }
+    for (uint8_t isr = 0; isr < CPULOAD_ISRS; isr++)
+    {
+      if (wordIs(&word, isrNames[isr]))
+      {
+        if (!lastNumber(args, &us) || us < 1 || us > CONSOLE_BUDGET_MAX)
+        { return CMD_ERROR; }
+        CpuLoad_SetBudget(isr, us);
+        return CMD_OK;
+      }
+    }
+    return CMD_ERROR;
+  }
+
+  length = snprintf(text, sizeof(text), "ok");
+  for (uint8_t isr = 0; isr < CPULOAD_ISRS && length < (int)sizeof(text); isr++)
+  {
+    const CpuLoadIsrStats* timing = CpuLoad_IsrStats(isr);
+    length += snprintf(text + length, sizeof(text) - length, " %s=%lu/%lu/%lu/%lu", isrNames[isr],
+                       (unsigned long)(Cycles_ToNs(timing->maxCycles) / 1000),
+                       (unsigned long)(Cycles_ToNs(timing->jitterCycles) / 1000),
+                       (unsigned long)(Cycles_ToNs(timing->budgetCycles) / 1000),
+                       (unsigned long)timing->violations);
+  }
+  reply(text);
+  return CMD_REPLIED;
+}
+
+static const Command commands[] =
+{
+  {"press", pressCommand},
+  {"joy", joyCommand},
+  {"seed", seedCommand},
+  {"speed", speedCommand},
+  {"info", infoCommand},
+  {"load", loadCommand},
+  {"isr", isrCommand},
+};
+
+/**
+ * @brief  Run one command line and reply.
+ * @param  line: Characters of the line without its end.
+ */
+static void runLine(Span* line)
+{
+  Span name;
+  uint8_t result = CMD_ERROR;
+
+  if (!nextWord(line, &name))
+  { return; }   // empty line
+  for (uint8_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+  {
+    if (wordIs(&name, commands[i].name))
+    {
+      result = commands[i].run(line);
+      break;
+    }
+  }
+  if (result != CMD_REPLIED)
+  { reply(result == CMD_OK ? "ok" : "err"); }
+}
+
+/**
+ * @brief  Start the circular DMA reception from the start of the buffer.
+ */
+static void startReception(void)
+{
+  rxHead = 0;
+  rxTail = 0;
+  rxScan = 0;
+  HAL_UARTEx_ReceiveToIdle_DMA(&huart1, rxBuffer, CONSOLE_RX_SIZE);
+}
+
+/**
+ * @brief  Start receiving commands.
+ * @param  game: Game the commands drive.
+ */
+void Console_Init(Game* game)
+{
+  console = game;
+  startReception();
+}
+
+/**
+ * @brief  Run the command lines completed since the last call.
+ */
+void Console_Poll(void)
+{
+  uint16_t end;
+
+  if (rxRestart)
+  {
+    rxRestart = 0;
+    startReception();
+  }
+
+  end = rxTail + ((rxHead - rxTail) & RX_MASK);
+  for (; rxScan != end; rxScan++)
+  {
+    char c = charAt(rxScan);
+    if (c == '\r' || c == '\n')
+    {
+      Span line = {rxTail, rxScan};
+      runLine(&line);
+      rxTail = rxScan + 1;
+    }
+  }
+
+  // A line filling half the buffer would be overwritten before it ends
+  if (end - rxTail >= CONSOLE_RX_SIZE / 2)
+  {
+    rxTail = end;
+    reply("err");
+  }
+
+  USART1_Kick();
+}
+
+/**
+ * @brief  Check for bytes not looked at yet.
+ * @return 1 if Console_Poll has work, 0 otherwise.
+ */
+uint8_t Console_Pending(void)
+{
+  return ((rxHead - rxScan) & RX_MASK) != 0 || rxRestart;
+}
+
+/**
+ * @brief  Idle line, half or full buffer during the reception. Called from
+ *         HAL_UARTEx_RxEventCallback.
+ * @param  size: Position the DMA writes at next.
+ */
+void Console_RxEvent(uint16_t size)
+{
+  rxHead = size & RX_MASK;
+}
+
+/**
+ * @brief  Noise, framing or overrun error, the HAL stopped the reception.
+ *         Called from HAL_UART_ErrorCallback.
+ */
+void Console_RxError(void)
+{
+  rxRestart = 1;
+}
+
+#endif
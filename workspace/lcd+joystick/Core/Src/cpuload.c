@@ -0,0 +1,189 @@
+/*
+ * Idle time accounting. The main loop sleeps in WFI with interrupts
+ * masked, so the cycles between going to sleep and waking up are idle
+ * time proper; the interrupt that woke the core runs after they are
+ * counted. The handlers time themselves from entry to exit. They all run
+ * at priority 0 and none preempts another, so the counts never overlap
+ * and idle, handlers and the main loop add up to the whole window.
+ *
+ * Runs are also checked against the budget of their handler, and the
+ * entries of TIM2 and SysTick against their period: a handler of the
+ * same priority running, or the main loop masking interrupts, delays
+ * them by that much.
+ */
+
+#include "cpuload.h"
+#include "cycles.h"
+#include "board.h"
+
+static BOARD_STATE uint32_t windowStart;                   // DWT count at the start of the window
+static BOARD_STATE uint32_t idleCycles;                    // cycles asleep in the window
+static BOARD_STATE volatile uint32_t isrCycles[CPULOAD_ISRS];
+static BOARD_STATE uint16_t history[CPULOAD_AVERAGE];      // load of the last windows
+static BOARD_STATE uint8_t historyNext;
+static BOARD_STATE uint8_t historyCount;
+static BOARD_STATE CpuLoadStats stats;
+static BOARD_STATE volatile CpuLoadIsrStats isrStats[CPULOAD_ISRS];
+static BOARD_STATE uint32_t lastEntry[CPULOAD_ISRS];       // start of the previous run
+
+static const uint32_t budgetsUs[CPULOAD_ISRS] =
+{
+  CPULOAD_BUDGET_TIM2_US, CPULOAD_BUDGET_SYSTICK_US, CPULOAD_BUDGET_UART_US, CPULOAD_BUDGET_I2C_US
+};
+static const uint32_t periodsUs[CPULOAD_ISRS] = {CPULOAD_PERIOD_TIM2_US, CPULOAD_PERIOD_SYSTICK_US, 0, 0};
+static BOARD_STATE uint32_t periodCycles[CPULOAD_ISRS];
+
+/**
+ * @brief  Share of a window in per mille.
+ * @param  cycles: Part of the window.
+ * @param  elapsed: Cycles of the window.
+ */
+static uint16_t perMille(uint32_t cycles, uint32_t elapsed)
+{
+  uint32_t share = (uint32_t)((uint64_t)cycles * 1000 / elapsed);
+  return (share < 1000) ? share : 1000;
+}
+
+/**
+ * @brief  Start the first window. The cycle counter must run already.
+ */
+void CpuLoad_Init(void)
+{
+  windowStart = Cycles_Now();
+  idleCycles = 0;
+  for (uint8_t isr = 0; isr < CPULOAD_ISRS; isr++)
+  {
+    isrCycles[isr] = 0;
+    periodCycles[isr] = Cycles_FromNs(periodsUs[isr] * 1000);
+    CpuLoad_SetBudget(isr, budgetsUs[isr]);
+  }
+  CpuLoad_ResetIsrStats();
+  historyNext = 0;
+  historyCount = 0;
+  stats = (CpuLoadStats){0};
+}
+
+/**
+ * @brief  Add cycles spent asleep to the window.
+ * @param  cycles: Cycles between WFI and the wake-up.
+ */
+void CpuLoad_Idle(uint32_t cycles)
+{
+  idleCycles += cycles;
+}
+
+/**
+ * @brief  Add the run of an interrupt handler to the window and to its
+ *         timing, at its end.
+ * @param  isr: Handler.
+ * @param  start: Cycles_Now() when the handler began.
+ */
+void CpuLoad_Isr(CpuLoadIsr isr, uint32_t start)
+{
+  volatile CpuLoadIsrStats* timing = &isrStats[isr];
+  uint32_t cycles = Cycles_Now() - start;
+
+  isrCycles[isr] += cycles;
+  if (cycles > timing->maxCycles)
+  { timing->maxCycles = cycles; }
+  if (cycles > timing->budgetCycles)
+  { timing->violations++; }
+
+  if (periodCycles[isr] && timing->runs)
+  {
+    uint32_t interval = start - lastEntry[isr];
+    uint32_t jitter = (interval > periodCycles[isr]) ? interval - periodCycles[isr]
+                                                     : periodCycles[isr] - interval;
+    if (jitter > timing->jitterCycles)
+    { timing->jitterCycles = jitter; }
+  }
+  lastEntry[isr] = start;
+  timing->runs++;
+}
+
+/**
+ * @brief  Close the window once CPULOAD_WINDOW_MS passed and start the next.
+ */
+void CpuLoad_Update(void)
+{
+  uint32_t now = Cycles_Now();
+  uint32_t elapsed = now - windowStart;
+  uint32_t isr[CPULOAD_ISRS];
+  uint32_t sum = 0;
+  uint32_t primask;
+
+  if (elapsed < SystemCoreClock / 1000 * CPULOAD_WINDOW_MS)
+  { return; }
+
+  primask = __get_PRIMASK();
+  __disable_irq();
+  for (uint8_t i = 0; i < CPULOAD_ISRS; i++)
+  {
+    isr[i] = isrCycles[i];
+    isrCycles[i] = 0;
+  }
+  __set_PRIMASK(primask);
+
+  stats.load = 1000 - perMille(idleCycles, elapsed);
+  for (uint8_t i = 0; i < CPULOAD_ISRS; i++)
+  { stats.isr[i] = perMille(isr[i], elapsed); }
+
+  history[historyNext] = stats.load;
+  historyNext = (historyNext + 1) % CPULOAD_AVERAGE;
+  if (historyCount < CPULOAD_AVERAGE)
+  { historyCount++; }
+  for (uint8_t i = 0; i < historyCount; i++)
+  { sum += history[i]; }
+  stats.load10s = sum / historyCount;
+
+  windowStart = now;
+  idleCycles = 0;
+}
+
+/**
+ * @brief  Shares of the core time in the last complete windows.
+ * @return Pointer to the statistics, updated once per window.
+ */
+const CpuLoadStats* CpuLoad_Stats(void)
+{
+  return &stats;
+}
+
+/**
+ * @brief  Timing of an interrupt handler.
+ * @param  isr: Handler.
+ * @return Pointer to its statistics, updated by each run.
+ */
+const CpuLoadIsrStats* CpuLoad_IsrStats(CpuLoadIsr isr)
+{
+  return (const CpuLoadIsrStats*)&isrStats[isr];
+}
+
+/**
+ * @brief  Change the budget of an interrupt handler.
+ * @param  isr: Handler.
+ * @param  us: Longest run within the budget, in microseconds.
+ */
+void CpuLoad_SetBudget(CpuLoadIsr isr, uint32_t us)
+{
+  isrStats[isr].budgetCycles = Cycles_FromNs(us * 1000);
+}
+
+/**
+ * @brief  Clear the longest runs, jitters and violations of the handlers,
+ *         keeping their budgets. The next entry of each starts the jitter
+ *         measurement again.
+ */
+void CpuLoad_ResetIsrStats(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  for (uint8_t isr = 0; isr < CPULOAD_ISRS; isr++)
+  {
+    isrStats[isr].runs = 0;
+    isrStats[isr].maxCycles = 0;
+    isrStats[isr].jitterCycles = 0;
+    isrStats[isr].violations = 0;
+  }
+  __set_PRIMASK(primask);
+}
@@ -0,0 +1,78 @@
+/*
+ * Fixed-size event queue shared between the interrupt handlers that produce
+ * events (buttons, timers, sound) and the main loop that dispatches them.
+ */
+
+#include "eventq.h"
+#include "main.h"
+
+#define EVENTQ_MASK (EVENTQ_SIZE - 1)
+
+/**
+ * @brief  Empty the queue and reset its statistics.
+ * @param  queue: Pointer to the EventQueue.
+ */
+void EventQueue_Init(EventQueue* queue)
+{
+  queue->head = 0;
+  queue->tail = 0;
+  queue->peak = 0;
+  queue->dropped = 0;
+}
+
+/**
+ * @brief  Append an event to the queue. Can be called from any context.
+ * @param  queue: Pointer to the EventQueue.
+ * @param  type: GameEventType of the event.
+ * @param  param: Event specific parameter.
+ * @return 1 if the event was queued, 0 if the queue was full.
+ */
+uint8_t EventQueue_Push(EventQueue* queue, uint8_t type, uint8_t param)
+{
+  uint8_t queued = 0;
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  uint8_t count = (uint8_t)(queue->head - queue->tail);
+  if (count < EVENTQ_SIZE)
+  {
+    GameEvent* event = &queue->buffer[queue->head & EVENTQ_MASK];
+    event->type = type;
+    event->param = param;
+    queue->head++;
+    queued = 1;
+
+    if (count + 1 > queue->peak)
+    { queue->peak = count + 1; }
+  }
+  else
+  { queue->dropped++; }
+
+  __set_PRIMASK(primask);
+  return queued;
+}
+
+/**
+ * @brief  Remove the oldest event from the queue. Main loop only.
+ * @param  queue: Pointer to the EventQueue.
+ * @param  event: Filled with the removed event.
+ * @return 1 if an event was removed, 0 if the queue was empty.
+ */
+uint8_t EventQueue_Pop(EventQueue* queue, GameEvent* event)
+{
+  if (queue->head == queue->tail)
+  { return 0; }
+
+  *event = queue->buffer[queue->tail & EVENTQ_MASK];
+  queue->tail++;
+  return 1;
+}
+
+/**
+ * @brief  Number of events waiting in the queue.
+ * @param  queue: Pointer to the EventQueue.
+ */
+uint8_t EventQueue_Count(const EventQueue* queue)
+{
+  return (uint8_t)(queue->head - queue->tail);
+}
@@ -0,0 +1,325 @@
+/*
+ * Append-only key/value log kept in the two flash pages reserved at the end
+ * of the STORE region by the linker script.
+ *
+ * Every record is one double-word so a value update costs a single program
+ * operation instead of a page erase. The first double-word of a page is its
+ * header, written last when the page is formatted, so a page whose compaction
+ * was interrupted is never taken as the active one. Boot scans the active page
+ * once to rebuild the RAM index, after which reads never touch flash. When the
+ * active page is full the latest value of every key is copied to the other
+ * page, which spreads the erases evenly over both pages.
+ *
+ * A reset while a double-word is programmed can leave it with a wrong ECC
+ * code, and reading it then raises an ECC double error, which is an NMI.
+ * The NMI handler hands errors in the store to Store_EccError, which flags
+ * them and lets the read finish. Store_Init then takes the slot as torn:
+ * it overwrites it with zeros, the one value flash accepts on a programmed
+ * double-word and which reads back with a good ECC code, and skips it like
+ * any record failing its CRC. Later boots read the zeros as a cleared slot
+ * and skip it without programming it again. A torn header leaves its page invalid, the
+ * next compaction erases it.
+ *
+ * CPU2 is never started in this firmware, so the flash can be programmed
+ * without the semaphores the wireless stack would require.
+ */
+
+#include "flashstore.h"
+#include "crc8.h"
+#include <stddef.h>
+#include <string.h>
+
+#define STORE_MAGIC        0x53494D4Eu   // "SIMN"
+#define STORE_KEY_HEADER   0xA5
+#define STORE_SLOTS        (FLASH_PAGE_SIZE / sizeof(StoreRecord))
+
+// Contents of a slot, from readSlot
+#define SLOT_RECORD        0    // programmed, the record still has to pass its CRC
+#define SLOT_ERASED        1
+#define SLOT_TORN          2    // ECC double error, to be zeroed
+#define SLOT_CLEARED       3    // zeroed at an earlier boot
+
+typedef struct
+{
+  uint8_t key;       // StoreKey, or STORE_KEY_HEADER for the page header
+  uint8_t crc;       // CRC-8 of the other seven bytes
+  uint16_t seq;      // page generation in the header, unused in records
+  uint32_t value;    // stored value, STORE_MAGIC in the header
+} StoreRecord;
+
+extern uint32_t _sstore[];
+extern uint32_t _estore[];
+
+static uint32_t values[STORE_KEY_COUNT];
+static uint8_t present = 0;        // bit per key that has a value
+static uint8_t activePage = 0;     // 0 or 1, page holding the live log
+static uint16_t generation = 0;    // header sequence of the active page
+static uint16_t writeSlot = 0;     // next erased slot of the active page
+static volatile uint8_t eccError = 0;   // set by Store_EccError during a read
+
+/**
+ * @brief  CRC-8 of a record without its crc field.
+ * @param  record: Pointer to the record.
+ * @return CRC of the key, seq and value fields.
+ */
+static uint8_t recordCrc(const StoreRecord* record)
+{
+  const uint8_t* bytes = (const uint8_t*)record;
+  const uint8_t after = offsetof(StoreRecord, crc) + 1;
+
+  return Crc8_Update(Crc8(bytes, offsetof(StoreRecord, crc)), bytes + after,
+                     sizeof(StoreRecord) - after);
+}
+
+/**
+ * @brief  Flash address of a slot.
+ * @param  page: Store page, 0 or 1.
+ * @param  slot: Double-word index within the page.
+ */
+static uint32_t slotAddress(uint8_t page, uint32_t slot)
+{
+  return (uint32_t)_sstore + page * FLASH_PAGE_SIZE + slot * sizeof(StoreRecord);
+}
+
+/**
+ * @brief  Copy a slot out of flash.
+ * @param  page: Store page, 0 or 1.
+ * @param  slot: Double-word index within the page.
+ * @param  record: Filled with the slot contents.
+ * @return SLOT_ERASED if the slot has never been programmed, SLOT_TORN if
+ *         its programming was cut short, SLOT_CLEARED if it was zeroed
+ *         after that, SLOT_RECORD otherwise.
+ */
+static uint8_t readSlot(uint8_t page, uint32_t slot, StoreRecord* record)
+{
+  uint32_t words[2];
+
+  eccError = 0;
+  memcpy(words, (const void*)slotAddress(page, slot), sizeof(words));
+  memcpy(record, words, sizeof(StoreRecord));
+  if (eccError)
+  { return SLOT_TORN; }
+  // Zeros are also a good record of 0 for key 0, a high score of 0 that
+  // reading back as no high score loses nothing
+  if (words[0] == 0 && words[1] == 0)
+  { return SLOT_CLEARED; }
+  return (words[0] == 0xFFFFFFFFu && words[1] == 0xFFFFFFFFu) ? SLOT_ERASED : SLOT_RECORD;
+}
+
+/**
+ * @brief  Overwrite a torn slot with zeros so it reads without an ECC error.
+ * @param  page: Store page, 0 or 1.
+ * @param  slot: Double-word index within the page.
+ */
+static void clearSlot(uint8_t page, uint32_t slot)
+{
+  HAL_FLASH_Unlock();
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, slotAddress(page, slot), 0);
+  HAL_FLASH_Lock();
+}
+
+/**
+ * @brief  Check the header of a page.
+ * @param  page: Store page, 0 or 1.
+ * @param  seq: Filled with the page generation when valid.
+ * @return 1 if the page holds a complete log, 0 otherwise.
+ */
+static uint8_t pageValid(uint8_t page, uint16_t* seq)
+{
+  StoreRecord header;
+  if (readSlot(page, 0, &header) != SLOT_RECORD)
+  { return 0; }
+
+  if (header.key != STORE_KEY_HEADER || header.value != STORE_MAGIC ||
+      header.crc != recordCrc(&header))
+  { return 0; }
+
+  *seq = header.seq;
+  return 1;
+}
+
+/**
+ * @brief  Program one record. The flash must be unlocked.
+ * @param  page: Store page, 0 or 1.
+ * @param  slot: Double-word index within the page.
+ * @param  key: Record key.
+ * @param  seq: Record sequence field.
+ * @param  value: Record value.
+ */
+static HAL_StatusTypeDef programRecord(uint8_t page, uint32_t slot, uint8_t key,
+                                       uint16_t seq, uint32_t value)
+{
+  StoreRecord record = { key, 0, seq, value };
+  uint64_t data;
+
+  record.crc = recordCrc(&record);
+  memcpy(&data, &record, sizeof(data));
+
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  return HAL_FLASH_Program(FLASH_TYPEPROGRAM_DOUBLEWORD, slotAddress(page, slot), data);
+}
+
+/**
+ * @brief  Erase the inactive page, copy the latest value of every key into it
+ *         and make it the active page. The flash must be unlocked.
+ */
+static HAL_StatusTypeDef compact(void)
+{
+  uint8_t page = activePage ^ 1;
+  uint32_t pageError = 0;
+  FLASH_EraseInitTypeDef erase = {0};
+  HAL_StatusTypeDef status;
+
+  erase.TypeErase = FLASH_TYPEERASE_PAGES;
+  erase.Page = ((uint32_t)_sstore - FLASH_BASE) / FLASH_PAGE_SIZE + page;
+  erase.NbPages = 1;
+
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ALL_ERRORS);
+  status = HAL_FLASHEx_Erase(&erase, &pageError);
+
+  uint16_t slot = 1;
+  for (uint8_t key = 0; key < STORE_KEY_COUNT && status == HAL_OK; key++)
+  {
+    if (present & (1u << key))
+    { status = programRecord(page, slot++, key, 0, values[key]); }
+  }
+
+  // Header goes last, until then the old page stays the valid one
+  if (status == HAL_OK)
+  { status = programRecord(page, 0, STORE_KEY_HEADER, generation + 1, STORE_MAGIC); }
+
+  if (status == HAL_OK)
+  {
+    activePage = page;
+    generation++;
+    writeSlot = slot;
+  }
+  return status;
+}
+
+/**
+ * @brief  Pick the newest valid page and replay its log into the RAM index.
+ *         Formats the store when neither page is valid.
+ */
+void Store_Init(void)
+{
+  uint16_t seq0 = 0, seq1 = 0;
+  uint8_t valid0 = pageValid(0, &seq0);
+  uint8_t valid1 = pageValid(1, &seq1);
+
+  present = 0;
+  memset(values, 0, sizeof(values));
+
+  if (!valid0 && !valid1)
+  {
+    // Blank or corrupted store: compact() formats page 0 from an empty index
+    activePage = 1;
+    generation = 0;
+    HAL_FLASH_Unlock();
+    compact();
+    HAL_FLASH_Lock();
+    return;
+  }
+
+  // Generations wrap, so compare them by signed distance
+  if (valid0 && valid1)
+  { activePage = ((int16_t)(seq1 - seq0) > 0) ? 1 : 0; }
+  else
+  { activePage = valid1 ? 1 : 0; }
+  generation = activePage ? seq1 : seq0;
+
+  writeSlot = 1;
+  for (uint16_t slot = 1; slot < STORE_SLOTS; slot++)
+  {
+    StoreRecord record;
+    uint8_t contents = readSlot(activePage, slot, &record);
+    if (contents == SLOT_ERASED)
+    { continue; }
+
+    // Anything programmed, even a torn record, uses up its slot. Only a
+    // new tear is programmed, one cleared before reads back as zeros
+    writeSlot = slot + 1;
+    if (contents == SLOT_TORN)
+    { clearSlot(activePage, slot); }
+    if (contents != SLOT_RECORD)
+    { continue; }
+    if (record.key < STORE_KEY_COUNT && record.crc == recordCrc(&record))
+    {
+      values[record.key] = record.value;
+      present |= 1u << record.key;
+    }
+  }
+}
+
+/**
+ * @brief  Take an ECC double error, from the NMI handler. An error in the
+ *         store is cleared and flagged to readSlot, the read that caused it
+ *         completes with the data as read.
+ * @return 1 if the failing double-word is in the store, 0 otherwise.
+ */
+uint8_t Store_EccError(void)
+{
+  uint32_t address = FLASH_BASE + ((FLASH->ECCR & FLASH_ECCR_ADDR_ECC) << 3);
+
+  if ((FLASH->ECCR & FLASH_ECCR_SYSF_ECC) ||
+      address < (uint32_t)_sstore || address >= (uint32_t)_estore)
+  { return 0; }
+
+  eccError = 1;
+  __HAL_FLASH_CLEAR_FLAG(FLASH_FLAG_ECCD);
+  return 1;
+}
+
+/**
+ * @brief  Latest value stored for a key, served from the RAM index.
+ * @param  key: StoreKey to read.
+ * @param  value: Filled with the value when present.
+ * @return 1 if the key has a value, 0 otherwise.
+ */
+uint8_t Store_Get(StoreKey key, uint32_t* value)
+{
+  if (key >= STORE_KEY_COUNT || !(present & (1u << key)))
+  { return 0; }
+
+  *value = values[key];
+  return 1;
+}
+
+/**
+ * @brief  Append a new value for a key. Writing the value already stored
+ *         costs nothing.
+ * @param  key: StoreKey to write.
+ * @param  value: New value.
+ * @return HAL_OK on success, the flash driver status otherwise.
+ */
+HAL_StatusTypeDef Store_Put(StoreKey key, uint32_t value)
+{
+  HAL_StatusTypeDef status = HAL_OK;
+
+  if (key >= STORE_KEY_COUNT)
+  { return HAL_ERROR; }
+
+  if ((present & (1u << key)) && values[key] == value)
+  { return HAL_OK; }
+
+  HAL_FLASH_Unlock();
+
+  if (writeSlot >= STORE_SLOTS)
+  { status = compact(); }
+
+  if (status == HAL_OK)
+  {
+    // A failed program still consumes the slot
+    status = programRecord(activePage, writeSlot++, key, 0, value);
+  }
+
+  if (status == HAL_OK)
+  {
+    values[key] = value;
+    present |= 1u << key;
+  }
+
+  HAL_FLASH_Lock();
+  return status;
+}
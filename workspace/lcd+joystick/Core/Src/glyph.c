@@ -0,0 +1,100 @@
+/*
+ * Custom glyph manager for the eight CGRAM slots of the HD44780. The
+ * registry holds more glyphs than the controller has slots, so each slot
+ * remembers which glyph it holds and when it was last used. A glyph that
+ * is resident costs nothing; a missing one replaces the least recently
+ * used glyph with one address instruction and eight data writes.
+ *
+ * Changing a slot changes every character on the display showing it. A
+ * screen renders all its characters before sending any, so the glyphs it
+ * uses are the most recently used ones and are never the victim as long
+ * as a screen needs no more than GLYPH_SLOTS of them.
+ */
+
+#include "glyph.h"
+#include "lcd1602.h"
+#include "board.h"
+
+typedef struct
+{
+  uint8_t glyph;        // GlyphId held, GLYPH_NONE when empty
+  uint32_t used;        // useClock of the last use, 0 when empty
+} GlyphSlot;
+
+static const uint8_t glyphRows[GLYPH_COUNT][GLYPH_ROWS] =
+{
+  {0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x00},   // GLYPH_BAR_1
+  {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},   // GLYPH_BAR_2
+  {0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x1C, 0x00},   // GLYPH_BAR_3
+  {0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x1E, 0x00},   // GLYPH_BAR_4
+  {0x00, 0x0A, 0x1F, 0x1F, 0x0E, 0x04, 0x00, 0x00},   // GLYPH_RED, heart
+  {0x04, 0x04, 0x0E, 0x0E, 0x1F, 0x1F, 0x0E, 0x00},   // GLYPH_BLUE, drop
+  {0x04, 0x15, 0x0E, 0x1F, 0x0E, 0x15, 0x04, 0x00},   // GLYPH_YELLOW, sun
+  {0x04, 0x0E, 0x1F, 0x04, 0x0E, 0x1F, 0x04, 0x00},   // GLYPH_GREEN, tree
+  {0x1F, 0x11, 0x0A, 0x04, 0x0A, 0x1F, 0x1F, 0x00},   // GLYPH_HOURGLASS
+};
+
+static BOARD_STATE GlyphSlot slots[GLYPH_SLOTS];
+static BOARD_STATE uint32_t useClock;
+
+/**
+ * @brief  Mark every slot empty.
+ */
+void Glyph_Init(void)
+{
+  for (uint8_t i = 0; i < GLYPH_SLOTS; i++)
+  {
+    slots[i].glyph = GLYPH_NONE;
+    slots[i].used = 0;
+  }
+  useClock = 0;
+}
+
+/**
+ * @brief  Character code of a glyph, uploaded on a miss.
+ * @param  id: Glyph of the registry.
+ * @return Code between GLYPH_CODE_BASE and GLYPH_CODE_BASE + 7.
+ */
+uint8_t Glyph_Code(GlyphId id)
+{
+  uint8_t victim = 0;
+
+  for (uint8_t i = 0; i < GLYPH_SLOTS; i++)
+  {
+    if (slots[i].glyph == id)
+    {
+      slots[i].used = ++useClock;
+      return GLYPH_CODE_BASE + i;
+    }
+    if (slots[i].used < slots[victim].used)
+    { victim = i; }
+  }
+
+  LCD_cmd_4bit(0x40 | (victim << 3));   // Set CGRAM address of the slot
+  for (uint8_t row = 0; row < GLYPH_ROWS; row++)
+  { LCD_data_4bit(glyphRows[id][row]); }
+
+  slots[victim].glyph = id;
+  slots[victim].used = ++useClock;
+  return GLYPH_CODE_BASE + victim;
+}
+
+/**
+ * @brief  Glyph held by a CGRAM slot.
+ * @param  slot: Slot number, 0 to GLYPH_SLOTS - 1.
+ * @return GlyphId, GLYPH_NONE if the slot was not written since Glyph_Init.
+ */
+GlyphId Glyph_Resident(uint8_t slot)
+{
+  return (GlyphId)slots[slot].glyph;
+}
+
+/**
+ * @brief  Pixels of a glyph.
+ * @param  id: Glyph of the registry.
+ * @return GLYPH_ROWS bytes, bit 4 is the leftmost pixel.
+ */
+const uint8_t* Glyph_Rows(GlyphId id)
+{
+  return glyphRows[id];
+}
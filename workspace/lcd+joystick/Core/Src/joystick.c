@@ -2,8 +2,7 @@
 
 #define ADC_SAMPLES 16
 #define DEADZONE    80        // adjust depending on how sensitive your joystick is
-
-static uint16_t centerX = 0;
+#define CENTER_DRIFT (DEADZONE / 2)  // largest accepted distance to a stored center
 
 /**
  * Initialize joystick handle
@@ -26,6 +25,7 @@ void Joystick_Init(Joystick_HandleTypeDef* joystick,
     joystick->yChannel = yChannel;
     joystick->buttonPort = buttonPort;
     joystick->buttonPin = buttonPin;
+    joystick->centerX = 0;
 }
 
 /**
@@ -57,15 +57,36 @@ static uint16_t Read_ADC_Channel(ADC_HandleTypeDef* hadc, uint32_t channel)
 /**
  * Calibration: find true center of joystick X at boot
  * @param joystick Pointer to joystick handle
+ * @return Calibrated center, to be stored for the next boot
  */
-void Joystick_Calibrate(Joystick_HandleTypeDef *joystick)
+uint16_t Joystick_Calibrate(Joystick_HandleTypeDef *joystick)
 {
     uint32_t sum = 0;
 
     for (int i = 0; i < 32; i++)
         sum += Read_ADC_Channel(joystick->hadc, joystick->xChannel);
         
-    centerX = sum / 32;
+    joystick->centerX = sum / 32;
+    return joystick->centerX;
+}
+
+/**
+ * Reuse a center from a previous calibration. One averaged reading checks
+ * that the stick still rests close to it, which is 32 times quicker than
+ * Joystick_Calibrate.
+ * @param joystick Pointer to joystick handle
+ * @param center Previously calibrated center
+ * @return 1 if the center was accepted, 0 if it drifted and needs calibration
+ */
+uint8_t Joystick_UseCenter(Joystick_HandleTypeDef *joystick, uint16_t center)
+{
+    int diff = (int)Read_ADC_Channel(joystick->hadc, joystick->xChannel) - (int)center;
+
+    if (diff > CENTER_DRIFT || diff < -CENTER_DRIFT)
+        return 0;
+
+    joystick->centerX = center;
+    return 1;
 }
 
 /**
@@ -76,7 +97,7 @@ JoyStickDirection Joystick_GetDirection(Joystick_HandleTypeDef *joystick)
 {
     uint16_t joystickX = Read_ADC_Channel(joystick->hadc, joystick->xChannel);
 
-    int diff = (int)joystickX - (int)centerX;
+    int diff = (int)joystickX - (int)joystick->centerX;
 
     if (diff > DEADZONE)
         return JOY_UP;
@@ -97,21 +118,3 @@ void Joystick_ReadXY(Joystick_HandleTypeDef* joystick, uint16_t* xy)
     xy[0] = Read_ADC_Channel(joystick->hadc, joystick->xChannel); // X-axis
     xy[1] = Read_ADC_Channel(joystick->hadc, joystick->yChannel); // Y-axis
 }
-
-/**
- * Check if joystick button is pressed
- * @param joystick Pointer to joystick handle
- * @return 1 if pressed, 0 otherwise
- */
-uint8_t Joystick_Pressed(Joystick_HandleTypeDef* joystick)
-{
-    // Check for Active Low and Debounce the button
-    if (HAL_GPIO_ReadPin(joystick->buttonPort, joystick->buttonPin) == GPIO_PIN_RESET)
-    {
-        HAL_Delay(20);
-        if(HAL_GPIO_ReadPin(joystick->buttonPort, joystick->buttonPin) == GPIO_PIN_RESET) 
-        { return 1; }
-    }
-  
-    return 0;
-}
\ No newline at end of file
@@ -15,30 +15,115 @@
  * specific code has not been subjected.
  */
 
-// TO DO:  Check the timing for the commands
+// Timing, from the HD44780U datasheet at VCC 2.7 to 4.5 V, the slower range,
+// with the 270 kHz oscillator of the LCM1602A. Delay_us(n) waits at least
+// n - 1 us. The LCD_TIMING build checks every edge against it in lcdmodel.c
+//   tAS    RS before E             60 ns   RS and data are written before E
+//   PWEH   E high                 450 ns   Delay_us(2) with E high
+//   tcycE  E period              1000 ns   Delay_us(2) more with E low
+//   instruction execution          37 us   Delay_us(40) after a command
+//   data write, 37 us and tADD     41 us   Delay_us(44)
+//   clear display, return home   1.52 ms   Delay_ms(2)
+//   init function sets 1, 2, 3    4.1 ms, 100 us, 37 us
+//                                          Delay_ms(5), Delay_us(150), Delay_us(40)
+// Over the I2C backpack at 100 kHz every PCF8574 port write is 9 bit times,
+// 90 us, and a nibble is two of them, E high then E low (see lcdi2c.c)
+//   PWEH   E high                 450 ns   the E high write, 90 us
+//   tcycE, instruction, data       41 us   180 us between two E falls
+//   clear display, return home   1.52 ms   LCD_Sync, then Delay_ms(2)
+//   init function set 1           4.1 ms   LCD_Sync, then Delay_ms(5)
+//   init function set 2           100 us   LCD_Sync, then 270 us of address and
+//                                          two writes before the next E fall
+// so the Delay_us calls of LCD_Init add nothing to the bus timing there
 
 #include "lcd1602.h"
+#include "lcdmodel.h"
+#include "lcdi2c.h"
+
+#define LCD_POWERUP_MS 30
 
 // Delay functions
 void Delay_us(uint8_t delay)
 {
-	// TO DO:  Check microsecond timer
-	__HAL_TIM_SET_COUNTER(&htim2, 0);
-	while (__HAL_TIM_GET_COUNTER(&htim2) < delay);
+#ifdef SIMON_SOAK
+	// Soak builds run on virtual time and do not time the display
+	(void)delay;
+#else
+	// TIM2 counts at 1 MHz and also drives the timer wheel, so measure the
+	// elapsed count instead of resetting the counter
+	uint32_t period = __HAL_TIM_GET_AUTORELOAD(&htim2) + 1;
+	uint32_t start = __HAL_TIM_GET_COUNTER(&htim2);
+	uint32_t now, elapsed;
+	do
+	{
+		now = __HAL_TIM_GET_COUNTER(&htim2);
+		elapsed = (now >= start) ? now - start : now + period - start;
+	} while (elapsed < delay);
+#endif
 }
 
 void Delay_ms(uint8_t delay)
 {
+#ifndef SIMON_SOAK
 	HAL_Delay(delay);
+#endif
 }
 
+#ifdef LCD_I2C
+// The backpack paces the display: at 100 kHz the two port writes of one
+// nibble take 180 us, longer than an instruction executes, so nothing
+// waits until the bus has to drain
+
+// Send low nibble of cmd to LCD via the backpack, used with RS low at init
+void LCD_send_4bit(uint8_t cmd)
+{
+	LcdI2c_Nibble(0, cmd);
+}
+
+// Send command to LCD via the backpack
+void LCD_cmd_4bit(uint8_t cmd)
+{
+	LcdI2c_Nibble(0, cmd >> 4);
+	LcdI2c_Nibble(0, cmd);
+}
+
+// Send data to LCD via the backpack
+void LCD_data_4bit(uint8_t data)
+{
+	LcdI2c_Nibble(1, data >> 4);
+	LcdI2c_Nibble(1, data);
+}
+
+// Start sending what the calls since the last flush queued
+void LCD_Flush(void)
+{
+	LcdI2c_Flush();
+}
+
+// Wait until everything queued is on the display
+void LCD_Sync(void)
+{
+	LcdI2c_Flush();
+	LcdI2c_Sync();
+}
+#else
 // Send strobe to LCD via E line
 void LCD_strobe(void)
 {
 	HAL_GPIO_WritePin(GPIOA, pin_E, Bit_SET);
-	Delay_us(20); // Due to datasheet E cycle time is about ~500ns, set to 20 us to let enough time for set up
+	LCD_EDGE(LCD_LINE_E, 1);
+	Delay_us(2); // PWEH is 450ns min, a count of 2 on the 1 MHz timer waits at least 1 us
 	HAL_GPIO_WritePin(GPIOA, pin_E, Bit_RESET);
-	Delay_us(20); // Due to datasheet E cycle time is about ~500ns, set to 20 us to let enough time for set up
+	LCD_EDGE(LCD_LINE_E, 0);
+#ifdef LCD_MODEL
+	// The controller latches RS and DB7..DB4 on the falling edge of E
+	LcdModel_Strobe(HAL_GPIO_ReadPin(GPIOA, pin_RS) == Bit_SET,
+	                (HAL_GPIO_ReadPin(GPIOC, pin_DB4) == Bit_SET) |
+	                (HAL_GPIO_ReadPin(GPIOC, pin_DB5) == Bit_SET) << 1 |
+	                (HAL_GPIO_ReadPin(GPIOC, pin_DB6) == Bit_SET) << 2 |
+	                (HAL_GPIO_ReadPin(GPIOC, pin_DB7) == Bit_SET) << 3);
+#endif
+	Delay_us(2); // E cycle time is 1000ns min, the low half adds at least another 1 us
 }
 
 // Send low nibble of cmd to LCD via 4bit bus
@@ -48,6 +133,7 @@ void LCD_send_4bit(uint8_t cmd)
 	HAL_GPIO_WritePin(GPIOC, pin_DB5, cmd & (1<<1) ? Bit_SET : Bit_RESET);
 	HAL_GPIO_WritePin(GPIOC, pin_DB6, cmd & (1<<2) ? Bit_SET : Bit_RESET);
 	HAL_GPIO_WritePin(GPIOC, pin_DB7, cmd & (1<<3) ? Bit_SET : Bit_RESET);
+	LCD_EDGE(LCD_LINE_DATA, cmd & 0x0F);
 	LCD_strobe();
 }
 
@@ -55,6 +141,7 @@ void LCD_send_4bit(uint8_t cmd)
 void LCD_cmd_4bit(uint8_t cmd)
 {
     HAL_GPIO_WritePin(GPIOA, pin_RS, Bit_RESET);
+    LCD_EDGE(LCD_LINE_RS, 0);
     LCD_send_4bit(cmd>>4); // send high nibble
     LCD_send_4bit(cmd); // send low nibble
     Delay_us(40); 	// typical command takes about 39us
@@ -64,46 +151,72 @@ void LCD_cmd_4bit(uint8_t cmd)
 void LCD_data_4bit(uint8_t data)
 {
     HAL_GPIO_WritePin(GPIOA, pin_RS, Bit_SET);
+    LCD_EDGE(LCD_LINE_RS, 1);
     LCD_send_4bit(data>>4);                 // send high nibble
     LCD_send_4bit(data);                    // send low nibble
     HAL_GPIO_WritePin(GPIOA, pin_RS, Bit_RESET);
+    LCD_EDGE(LCD_LINE_RS, 0);
     Delay_us(44);                           // write data to RAM takes about 43us
 }
 
+// The GPIO bus writes right away
+void LCD_Flush(void)
+{
+}
+
+void LCD_Sync(void)
+{
+}
+#endif
+
 // Set cursor position on LCD
 // column : Column position
 // line   : Line position
 void LCD_GotoXY(int column, int line)
 {
-	if ((column < 0) && (column > 15))
+	if ((column < 0) || (column > LCD_COLS - 1))
 		column = 0;
-	if ((line < 0) && (line > 1))
+	if ((line < 0) || (line > LCD_ROWS - 1))
 		line = 0;
-    LCD_cmd_4bit((column+(line<<6)) | 0x80);  // Set DDRAM address with coordinates
+    LCD_cmd_4bit((LCD_ROW_ADDR(line) + column) | 0x80);  // Set DDRAM address with coordinates
 }
 
 // Init LCD to 4bit bus mode
 void LCD_Init(void)
 {
-	Delay_ms(30);              // must wait >=30us after LCD Vdd rises to 4.5V
+#ifdef LCD_MODEL
+	LcdModel_Reset();
+#endif
+#ifdef LCD_I2C
+	LcdI2c_Init();
+#endif
+	// must wait >=30ms after LCD Vdd rises to 4.5V, the time spent since reset counts
+	while (HAL_GetTick() < LCD_POWERUP_MS);
 	LCD_send_4bit(0b00000011); // select 4-bit bus (still 8bit)
+	LCD_Sync();
 	Delay_ms(5);               // must wait more than 4.1ms
 	LCD_send_4bit(0b00000011); // select 4-bit bus (still 8bit)
+	LCD_Sync();
 	Delay_us(150);             // must wait more than 100us
 	LCD_send_4bit(0b00000011); // select 4-bit bus (still 8bit)
+	Delay_us(40);              // each function set executes in 37us
 	LCD_send_4bit(0b00000010); // Function set: 4-bit bus (gotcha!)
+	Delay_us(40);
 
 	LCD_cmd_4bit(0x28); // LCD Function: 2 Lines, 5x8 matrix
 	LCD_cmd_4bit(0x0C); // Display control: Display: on, cursor: off
 	LCD_cmd_4bit(0x06); // Entry mode: increment, shift disabled
+	LCD_Sync();
 }
 
 // Clear LCD display and set cursor at first position
 void LCD_Cls(void)
 {
 	LCD_cmd_4bit(0x01); // Clear display command
+	LCD_Sync();
 	Delay_ms(2); // Numb display does it at least 1.53ms
 	LCD_cmd_4bit(0x02); // Return Home command
+	LCD_Sync();
 	Delay_ms(2); // Numb display does it at least 1.53ms
 }
 
@@ -0,0 +1,86 @@
+/*
+ * Small formatter for the display lines. The screens only
+ * need fixed text and unsigned numbers, which snprintf handles through its
+ * whole format parser and varargs on every call.
+ *
+ * This only takes snprintf off the screen path. The USART1 logs still call
+ * it, so vfprintf stays linked and the firmware is no smaller until they
+ * move off it too.
+ */
+
+#include "lcdfmt.h"
+
+/**
+ * @brief  Append a string, truncated at the end of the line.
+ * @param  line: Line buffer of LCDFMT_COLS + 1 bytes.
+ * @param  pos: Position to write at.
+ * @param  text: Null terminated text.
+ * @return Position after the text.
+ */
+uint8_t LcdFmt_Str(char* line, uint8_t pos, const char* text)
+{
+  while (*text && pos < LCDFMT_COLS)
+  { line[pos++] = *text++; }
+  line[pos] = '\0';
+  return pos;
+}
+
+/**
+ * @brief  Append an unsigned number in decimal, truncated at the end of the
+ *         line.
+ * @param  line: Line buffer of LCDFMT_COLS + 1 bytes.
+ * @param  pos: Position to write at.
+ * @param  value: Number to write.
+ * @return Position after the number.
+ */
+uint8_t LcdFmt_Dec(char* line, uint8_t pos, uint32_t value)
+{
+  return LcdFmt_DecRight(line, pos, value, 0);
+}
+
+/**
+ * @brief  Append a number right justified in a field, padded with spaces.
+ *         A number wider than the field takes the room it needs.
+ * @param  line: Line buffer of LCDFMT_COLS + 1 bytes.
+ * @param  pos: Position to write at.
+ * @param  value: Number to write.
+ * @param  width: Field width in columns, 0 for no padding.
+ * @return Position after the field.
+ */
+uint8_t LcdFmt_DecRight(char* line, uint8_t pos, uint32_t value, uint8_t width)
+{
+  char digits[10];   // UINT32_MAX has 10 digits
+  uint8_t count = 0;
+
+  do
+  {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+
+  while (width > count && pos < LCDFMT_COLS)
+  {
+    line[pos++] = ' ';
+    width--;
+  }
+  while (count > 0 && pos < LCDFMT_COLS)
+  { line[pos++] = digits[--count]; }
+  line[pos] = '\0';
+  return pos;
+}
+
+/**
+ * @brief  Fill with spaces up to a column, so the line overwrites whatever
+ *         the display showed there before.
+ * @param  line: Line buffer of LCDFMT_COLS + 1 bytes.
+ * @param  pos: Position to write at.
+ * @param  width: Column to pad to, at most LCDFMT_COLS.
+ * @return Position after the padding.
+ */
+uint8_t LcdFmt_Pad(char* line, uint8_t pos, uint8_t width)
+{
+  while (pos < width && pos < LCDFMT_COLS)
+  { line[pos++] = ' '; }
+  line[pos] = '\0';
+  return pos;
+}
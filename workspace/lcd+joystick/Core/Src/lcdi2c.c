@@ -0,0 +1,212 @@
+/*
+ * HD44780 transport through a PCF8574 I2C backpack. Every nibble becomes
+ * two port writes, E high with the data and E low, plus a set up byte
+ * when RS changes, so RS is stable before E rises. The bytes collect in
+ * one of two buffers. A flush hands the buffer to the bus and returns:
+ * the DMA transfer starts right away if the bus is free, or from the
+ * completion interrupt of the transfer ahead of it, and the next screen
+ * fills the other buffer meanwhile. Only filling a buffer the bus still
+ * holds, or LcdI2c_Sync, waits.
+ *
+ * The PCF8574 runs at 100 kHz at most, where a port write is 9 bit times,
+ * 90 us, so the two writes of a nibble outlast any instruction but clear
+ * and home. Those two wait for the bus to drain before their delay (see
+ * lcd1602.c).
+ *
+ * A transfer the backpack does not acknowledge, or one that is still on
+ * the bus after LCDI2C_TIMEOUT_MS, is dropped and counted, so a missing
+ * backpack does not stop the game but shows in LcdI2c_Dropped.
+ */
+
+#include "lcdi2c.h"
+
+#ifdef LCD_I2C
+
+#include "i2c.h"
+#include "lcdmodel.h"
+#include "board.h"
+
+#define LCDI2C_NONE  0xFF       // no buffer
+
+static BOARD_STATE uint8_t buffers[2][LCDI2C_BUFFER];
+static BOARD_STATE uint16_t fill;          // bytes in the buffer being filled
+static BOARD_STATE uint8_t filling;        // index of the buffer being filled
+static BOARD_STATE uint8_t port = LCDI2C_BACKLIGHT;   // last byte written to the PCF8574
+static BOARD_STATE volatile uint8_t sending = LCDI2C_NONE;   // buffer on the bus
+static BOARD_STATE volatile uint8_t queued = LCDI2C_NONE;    // buffer waiting for the bus
+static BOARD_STATE volatile uint16_t queuedFill;             // bytes of the queued buffer
+static BOARD_STATE volatile uint32_t dropped;                // transfers lost
+
+/**
+ * @brief  Put a buffer on the bus. Interrupts must be disabled by the
+ *         caller or it runs in the I2C interrupt.
+ * @param  buffer: Index of the buffer.
+ * @param  size: Bytes to send.
+ */
+static void startTransfer(uint8_t buffer, uint16_t size)
+{
+  sending = buffer;
+  if (HAL_I2C_Master_Transmit_DMA(&hi2c1, LCDI2C_ADDRESS, buffers[buffer], size) != HAL_OK)
+  {
+    sending = LCDI2C_NONE;
+    dropped++;
+  }
+}
+
+/**
+ * @brief  Free the buffer on the bus and start the queued one. Runs in the
+ *         I2C interrupt.
+ */
+static void transferDone(void)
+{
+  sending = LCDI2C_NONE;
+  if (queued != LCDI2C_NONE)
+  {
+    uint8_t buffer = queued;
+    queued = LCDI2C_NONE;
+    startTransfer(buffer, queuedFill);
+  }
+}
+
+/**
+ * @brief  Wait until the bus lets go of a buffer, or of both, dropping
+ *         what is left after LCDI2C_TIMEOUT_MS for each transfer.
+ * @param  buffer: Index of the buffer, LCDI2C_NONE for both.
+ */
+static void waitBus(uint8_t buffer)
+{
+  uint32_t start = HAL_GetTick();
+  uint8_t last = sending;
+
+  while ((buffer == LCDI2C_NONE) ? sending != LCDI2C_NONE : (sending == buffer || queued == buffer))
+  {
+    // Each transfer that ends starts the timeout of the next one over
+    if (sending != last)
+    {
+      last = sending;
+      start = HAL_GetTick();
+    }
+    if (HAL_GetTick() - start > LCDI2C_TIMEOUT_MS)
+    {
+      uint32_t primask = __get_PRIMASK();
+      __disable_irq();
+      HAL_I2C_Master_Abort_IT(&hi2c1, LCDI2C_ADDRESS);
+      dropped += (sending != LCDI2C_NONE) + (queued != LCDI2C_NONE);
+      sending = LCDI2C_NONE;
+      queued = LCDI2C_NONE;
+      __set_PRIMASK(primask);
+      return;
+    }
+  }
+}
+
+/**
+ * @brief  Append one byte, handing the buffer to the bus first if it is
+ *         full.
+ * @param  value: PCF8574 port value.
+ */
+static void put(uint8_t value)
+{
+  if (fill == LCDI2C_BUFFER)
+  { LcdI2c_Flush(); }
+  if (fill == 0)
+  { waitBus(filling); }
+  buffers[filling][fill++] = value;
+#ifdef LCD_MODEL
+  // The controller latches RS and DB7..DB4 on the falling edge of E
+  if ((port & LCDI2C_E) && !(value & LCDI2C_E))
+  { LcdModel_Strobe((value & LCDI2C_RS) ? 1 : 0, value >> 4); }
+#endif
+  port = value;
+}
+
+/**
+ * @brief  Empty both buffers and take the port as the backpack powers up,
+ *         backlight on. Called by LCD_Init.
+ */
+void LcdI2c_Init(void)
+{
+  fill = 0;
+  filling = 0;
+  port = LCDI2C_BACKLIGHT;
+  sending = LCDI2C_NONE;
+  queued = LCDI2C_NONE;
+  dropped = 0;
+}
+
+/**
+ * @brief  Queue one nibble transfer.
+ * @param  rs: 1 for data, 0 for an instruction.
+ * @param  nibble: DB7..DB4 in bits 3..0.
+ */
+void LcdI2c_Nibble(uint8_t rs, uint8_t nibble)
+{
+  uint8_t value = (uint8_t)((nibble & 0x0F) << 4) | LCDI2C_BACKLIGHT | (rs ? LCDI2C_RS : 0);
+
+  if ((port ^ value) & LCDI2C_RS)
+  { put(value); }               // RS set up before E rises
+  put(value | LCDI2C_E);
+  put(value);                   // the controller latches on the falling edge of E
+}
+
+/**
+ * @brief  Hand the filled buffer to the bus without waiting: it is sent
+ *         now, or right after the transfer under way.
+ */
+void LcdI2c_Flush(void)
+{
+  if (fill == 0)
+  { return; }
+
+  // put waited for this buffer, so at most the other one is on the bus
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  if (sending == LCDI2C_NONE)
+  { startTransfer(filling, fill); }
+  else
+  {
+    queued = filling;
+    queuedFill = fill;
+  }
+  __set_PRIMASK(primask);
+
+  filling ^= 1;
+  fill = 0;
+}
+
+/**
+ * @brief  Wait until every transfer handed to the bus is done or dropped.
+ */
+void LcdI2c_Sync(void)
+{
+  waitBus(LCDI2C_NONE);
+}
+
+/**
+ * @brief  Transfers lost since power-on.
+ * @return Number of buffers the backpack did not acknowledge, that the
+ *         bus refused or that timed out.
+ */
+uint32_t LcdI2c_Dropped(void)
+{
+  return dropped;
+}
+
+// The backpack is the only device on I2C1, so its HAL callbacks live here
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+  if (hi2c->Instance == I2C1)
+  { transferDone(); }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+  if (hi2c->Instance == I2C1 && sending != LCDI2C_NONE)
+  {
+    dropped++;
+    transferDone();
+  }
+}
+
+#endif
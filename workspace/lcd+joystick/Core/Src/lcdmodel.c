@@ -0,0 +1,396 @@
+/*
+ * Model of the HD44780 controller of the LCM1602A, or of the LCD_SIZE
+ * display, fed from the pins that lcd1602.c drives. On every falling edge
+ * of E the RS line and DB7..DB4 are sampled and decoded the way the
+ * controller does: the 8-bit power-on interface, the switch to 4-bit
+ * nibble pairs, the address counter with its line wrap, entry mode,
+ * display shift, clear/home and CGRAM writes.
+ *
+ * Rendering the visible window of DDRAM gives the text actually on the
+ * glass, which lets soak builds compare every screen against golden frames
+ * and count the bus transactions each screen costs.
+ *
+ * With LCD_TIMING the driver also reports every level change of RS, E and
+ * the data nibble with its DWT cycle count. Each interval is checked
+ * against the HD44780U minimums, and the time between a complete transfer
+ * and the next E pulse against the execution time of that instruction.
+ * Every check keeps its violation count and its smallest margin.
+ */
+
+#include "lcdmodel.h"
+
+#ifdef LCD_MODEL
+
+#include <string.h>
+#include "board.h"
+
+// Execution times at the nominal 270 kHz oscillator
+#define EXEC_NS          37000u     // most instructions
+#define EXEC_WRITE_NS    41000u     // data write, 37 us plus tADD
+#define EXEC_CLEAR_NS    1520000u   // clear display and return home
+#define EXEC_POWERUP_NS  4100000u   // first function set of the 8-bit init sequence
+#define EXEC_INIT2_NS    100000u    // second function set of the init sequence
+#define MARGIN_CAP_NS    1000000000 // longer intervals are reported as 1 s
+
+typedef struct
+{
+  uint8_t ddram[LCD_MODEL_LINES][LCD_MODEL_LINE_LEN];
+  uint8_t cgram[64];
+  uint8_t ac;             // address counter, DDRAM or CGRAM address
+  uint8_t cgMode;         // the address counter points into CGRAM
+  uint8_t increment;      // entry mode I/D
+  uint8_t shiftOnWrite;   // entry mode S
+  uint8_t shift;          // display shift, first visible DDRAM column
+  uint8_t displayOn;
+  uint8_t fourBit;        // 4-bit interface selected by function set
+  uint8_t highNibble;     // first half of a 4-bit transfer
+  uint8_t haveHigh;       // highNibble is waiting for its second half
+  uint8_t dirty;          // visible content changed since the last frame
+  uint8_t initSets;       // 8-bit function sets seen since reset
+  uint32_t execNs;        // execution time of the last decoded transfer
+  LcdModelStats stats;
+} LcdModel;
+
+static BOARD_STATE LcdModel lcd;
+
+#ifdef LCD_TIMING
+typedef struct
+{
+  uint8_t level[3];       // current level of each LcdModelLine
+  uint32_t changed[3];    // cycle count of the last change of each line
+  uint32_t eRise;         // cycle count of the last rising edge of E
+  uint8_t eRiseSeen;      // eRise holds a real edge
+  uint8_t execPending;    // a transfer completed at the last falling edge
+} LcdEdges;
+
+// HD44780U bus timing for VCC 2.7 to 4.5 V, the slower of the two ranges
+static BOARD_STATE LcdTimingCheck checks[LCD_CHECK_COUNT] =
+{
+  [LCD_CHECK_TAS]   = {"tAS", 60},
+  [LCD_CHECK_PWEH]  = {"PWEH", 450},
+  [LCD_CHECK_TCYCE] = {"tcycE", 1000},
+  [LCD_CHECK_TDSW]  = {"tDSW", 195},
+  [LCD_CHECK_TH]    = {"tH", 10},
+  [LCD_CHECK_TAH]   = {"tAH", 20},
+  [LCD_CHECK_EXEC]  = {"exec", 0},
+};
+
+static BOARD_STATE LcdEdges edges;
+#endif
+
+/**
+ * @brief  Move the DDRAM address counter by one position, crossing from the
+ *         end of one line to the start of the other like the controller.
+ * @param  forward: 1 to increment, 0 to decrement.
+ */
+static void stepDdram(uint8_t forward)
+{
+  uint8_t row = (lcd.ac >= LCD_DDRAM_LINE2) ? 1 : 0;
+  uint8_t col = (lcd.ac & 0x3F) % LCD_MODEL_LINE_LEN;
+
+  if (forward)
+  {
+    if (++col == LCD_MODEL_LINE_LEN)
+    {
+      col = 0;
+      row ^= 1;
+    }
+  }
+  else if (col-- == 0)
+  {
+    col = LCD_MODEL_LINE_LEN - 1;
+    row ^= 1;
+  }
+  lcd.ac = row ? LCD_DDRAM_LINE2 + col : col;
+}
+
+/**
+ * @brief  Shift the whole display by one column.
+ * @param  left: 1 to move the content left, 0 to move it right.
+ */
+static void shiftDisplay(uint8_t left)
+{
+  lcd.shift = (lcd.shift + (left ? 1 : LCD_MODEL_LINE_LEN - 1)) % LCD_MODEL_LINE_LEN;
+  lcd.dirty = 1;
+}
+
+/**
+ * @brief  Execute one instruction (RS low).
+ * @param  cmd: Instruction byte.
+ */
+static void command(uint8_t cmd)
+{
+  lcd.stats.commands++;
+  lcd.execNs = (cmd & 0xFC) ? EXEC_NS : EXEC_CLEAR_NS;
+
+  if (cmd & 0x80)          // set DDRAM address
+  {
+    lcd.ac = cmd & 0x7F;
+    lcd.cgMode = 0;
+  }
+  else if (cmd & 0x40)     // set CGRAM address
+  {
+    lcd.ac = cmd & 0x3F;
+    lcd.cgMode = 1;
+  }
+  else if (cmd & 0x20)     // function set
+  {
+    if (!lcd.fourBit && lcd.initSets < 2)
+    { lcd.execNs = (lcd.initSets++ == 0) ? EXEC_POWERUP_NS : EXEC_INIT2_NS; }
+    lcd.fourBit = (cmd & 0x10) ? 0 : 1;
+    lcd.haveHigh = 0;
+  }
+  else if (cmd & 0x10)     // cursor or display shift
+  {
+    if (cmd & 0x08)
+    { shiftDisplay((cmd & 0x04) ? 0 : 1); }
+    else
+    { stepDdram((cmd & 0x04) ? 1 : 0); }
+  }
+  else if (cmd & 0x08)     // display control
+  {
+    lcd.displayOn = (cmd & 0x04) ? 1 : 0;
+    lcd.dirty = 1;
+  }
+  else if (cmd & 0x04)     // entry mode
+  {
+    lcd.increment = (cmd & 0x02) ? 1 : 0;
+    lcd.shiftOnWrite = cmd & 0x01;
+  }
+  else if (cmd & 0x02)     // return home
+  {
+    lcd.ac = 0;
+    lcd.cgMode = 0;
+    lcd.shift = 0;
+    lcd.dirty = 1;
+  }
+  else if (cmd & 0x01)     // clear display
+  {
+    memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+    lcd.ac = 0;
+    lcd.cgMode = 0;
+    lcd.increment = 1;
+    lcd.shift = 0;
+    lcd.stats.clears++;
+    lcd.dirty = 1;
+  }
+}
+
+/**
+ * @brief  Write one byte of data (RS high) at the address counter.
+ * @param  data: Character code or glyph row.
+ */
+static void writeData(uint8_t data)
+{
+  lcd.stats.writes++;
+  lcd.execNs = EXEC_WRITE_NS;
+
+  if (lcd.cgMode)
+  {
+    lcd.cgram[lcd.ac & 0x3F] = data;
+    lcd.ac = (lcd.ac + (lcd.increment ? 1 : 0x3F)) & 0x3F;
+    lcd.dirty = 1;
+    return;
+  }
+
+  lcd.ddram[(lcd.ac >= LCD_DDRAM_LINE2) ? 1 : 0][(lcd.ac & 0x3F) % LCD_MODEL_LINE_LEN] = data;
+  stepDdram(lcd.increment);
+  if (lcd.shiftOnWrite)
+  { shiftDisplay(lcd.increment); }
+  lcd.dirty = 1;
+}
+
+/**
+ * @brief  Put the model in the controller's power-on state.
+ */
+void LcdModel_Reset(void)
+{
+  memset(&lcd, 0, sizeof(lcd));
+  memset(lcd.ddram, ' ', sizeof(lcd.ddram));
+  lcd.increment = 1;
+
+#ifdef LCD_TIMING
+  memset(&edges, 0, sizeof(edges));
+  for (uint8_t i = 0; i < LCD_CHECK_COUNT; i++)
+  {
+    checks[i].samples = 0;
+    checks[i].violations = 0;
+    checks[i].worstMarginNs = MARGIN_CAP_NS;
+  }
+#endif
+}
+
+/**
+ * @brief  Decode the bus on a falling edge of E.
+ * @param  rs: State of the RS line.
+ * @param  nibble: DB7..DB4 in bits 3..0.
+ */
+void LcdModel_Strobe(uint8_t rs, uint8_t nibble)
+{
+  uint8_t value;
+
+  lcd.stats.strobes++;
+  nibble &= 0x0F;
+
+  if (!lcd.fourBit)
+  {
+    // DB3..DB0 are not wired, the controller reads them as 0
+    value = nibble << 4;
+  }
+  else if (!lcd.haveHigh)
+  {
+    lcd.highNibble = nibble;
+    lcd.haveHigh = 1;
+    return;
+  }
+  else
+  {
+    value = (lcd.highNibble << 4) | nibble;
+    lcd.haveHigh = 0;
+  }
+
+  if (rs)
+  { writeData(value); }
+  else
+  { command(value); }
+
+#ifdef LCD_TIMING
+  // The controller is busy from this falling edge of E
+  edges.execPending = 1;
+#endif
+}
+
+/**
+ * @brief  Text currently visible on the display.
+ * @param  frame: Filled with one null terminated string per line.
+ */
+void LcdModel_Render(char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1])
+{
+  for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+  {
+    for (uint8_t col = 0; col < LCD_MODEL_COLS; col++)
+    {
+      // Rows 2 and 3 of a four row display show the second half of the lines
+      uint8_t offset = (row >> 1) * LCD_MODEL_COLS;
+      frame[row][col] = lcd.displayOn ?
+          (char)lcd.ddram[row & 1][(lcd.shift + offset + col) % LCD_MODEL_LINE_LEN] : ' ';
+    }
+    frame[row][LCD_MODEL_COLS] = '\0';
+  }
+}
+
+/**
+ * @brief  Close the current frame.
+ * @param  stats: Filled with the bus activity since the previous frame.
+ * @return 1 if the visible content changed, 0 otherwise (stats untouched).
+ */
+uint8_t LcdModel_TakeFrame(LcdModelStats* stats)
+{
+  if (!lcd.dirty)
+  { return 0; }
+
+  *stats = lcd.stats;
+  memset(&lcd.stats, 0, sizeof(lcd.stats));
+  lcd.dirty = 0;
+  return 1;
+}
+
+/**
+ * @brief  Character generator RAM contents.
+ */
+const uint8_t* LcdModel_Cgram(void)
+{
+  return lcd.cgram;
+}
+
+/**
+ * @brief  Display shift set by the shift instructions.
+ */
+uint8_t LcdModel_Shift(void)
+{
+  return lcd.shift;
+}
+
+#ifdef LCD_TIMING
+/**
+ * @brief  Check one measured interval against its minimum.
+ * @param  check: Timing check to update.
+ * @param  elapsed: Measured interval in cycles.
+ * @param  requiredNs: Minimum interval in nanoseconds.
+ */
+static void record(LcdModelCheck check, uint32_t elapsed, uint32_t requiredNs)
+{
+  LcdTimingCheck* c = &checks[check];
+  int64_t margin = (int64_t)((uint64_t)elapsed * 1000000000u / SystemCoreClock) - requiredNs;
+
+  if (margin > MARGIN_CAP_NS)
+  { margin = MARGIN_CAP_NS; }
+
+  c->samples++;
+  if (margin < 0)
+  { c->violations++; }
+  if (margin < c->worstMarginNs)
+  { c->worstMarginNs = (int32_t)margin; }
+}
+
+/**
+ * @brief  Record a level change of one bus line and check the intervals
+ *         that end with it.
+ * @param  line: Line that changed.
+ * @param  level: New level, the nibble value for LCD_LINE_DATA.
+ * @param  cycles: DWT cycle count of the change.
+ */
+void LcdModel_Edge(LcdModelLine line, uint8_t level, uint32_t cycles)
+{
+  if (edges.level[line] == level)
+  { return; }
+
+  uint8_t eHigh = edges.level[LCD_LINE_E];
+
+  switch (line)
+  {
+    case LCD_LINE_RS:
+      if (!eHigh)
+      { record(LCD_CHECK_TAH, cycles - edges.changed[LCD_LINE_E], checks[LCD_CHECK_TAH].minNs); }
+      break;
+
+    case LCD_LINE_DATA:
+      if (!eHigh)
+      { record(LCD_CHECK_TH, cycles - edges.changed[LCD_LINE_E], checks[LCD_CHECK_TH].minNs); }
+      break;
+
+    case LCD_LINE_E:
+      if (level)
+      {
+        record(LCD_CHECK_TAS, cycles - edges.changed[LCD_LINE_RS], checks[LCD_CHECK_TAS].minNs);
+        if (edges.eRiseSeen)
+        { record(LCD_CHECK_TCYCE, cycles - edges.eRise, checks[LCD_CHECK_TCYCE].minNs); }
+        if (edges.execPending)
+        { record(LCD_CHECK_EXEC, cycles - edges.changed[LCD_LINE_E], lcd.execNs); }
+        edges.execPending = 0;
+        edges.eRise = cycles;
+        edges.eRiseSeen = 1;
+      }
+      else
+      {
+        record(LCD_CHECK_PWEH, cycles - edges.eRise, checks[LCD_CHECK_PWEH].minNs);
+        record(LCD_CHECK_TDSW, cycles - edges.changed[LCD_LINE_DATA], checks[LCD_CHECK_TDSW].minNs);
+      }
+      break;
+  }
+
+  edges.level[line] = level;
+  edges.changed[line] = cycles;
+}
+
+/**
+ * @brief  Results of one timing check.
+ * @param  check: Check to read.
+ */
+const LcdTimingCheck* LcdModel_TimingCheck(LcdModelCheck check)
+{
+  return &checks[check];
+}
+#endif
+
+#endif
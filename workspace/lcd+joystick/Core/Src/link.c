@@ -0,0 +1,683 @@
+/*
+ * Link layer for linked play. Boards wired TX to RX, or through the host
+ * hub of tools/link_hub.py, exchange small frames over LPUART1 at 115200
+ * baud, where an 8 byte frame takes 0.7 ms.
+ *
+ * Reception runs on a circular DMA buffer; the idle line interrupt after
+ * each burst moves the write position, so a frame is ready for Link_Poll
+ * one character time after its last byte and no interrupt is taken per
+ * byte. Transmission queues the bytes in a ring that the DMA drains, so a
+ * send never waits for the wire.
+ *
+ * Every board sends a HELLO with its id and its boot count each
+ * LINK_HELLO_MS. A board that restarts sends a new boot count, which tells
+ * its peers to forget the sequence numbers of its previous run. The boards it
+ * hears from are its peers, and the one with the lowest id is Simon: it
+ * draws the sequence of a linked game and sends it in one START frame, so
+ * every board plays the same colors at its own pace. Presses and scores
+ * follow as INPUT and SCORE frames. These frames carry a sequence number
+ * and are resent every LINK_RETRY_MS until every peer acknowledged them;
+ * only the first one of the outbox is on the wire, which keeps them in
+ * order and lets a peer drop a copy it already has by its number.
+ */
+
+#include "link.h"
+
+#ifdef LINK_UART
+
+#include "usart.h"
+#include "crc8.h"
+#include "flashstore.h"
+#include <string.h>
+
+typedef struct
+{
+  uint32_t id;            // board id from its HELLO, 0 for a free slot
+  uint32_t boot;          // boot count from its HELLO
+  uint32_t lastSeen;      // HAL tick of its last frame
+  uint8_t node;           // node byte of its frames
+  uint8_t lastSeq;        // seq of its last frame delivered
+  uint8_t round;          // from its last SCORE frame
+  uint8_t done;
+  uint16_t score;
+} LinkPeer;
+
+typedef struct
+{
+  uint8_t bytes[LINK_FRAME_MAX];
+  uint8_t length;         // payload length
+} LinkFrame;
+
+static EventQueue* events;
+static LinkPeer peers[LINK_PEERS_MAX];
+static LinkStats stats;
+static uint32_t selfId;
+static uint32_t selfBoot;
+static uint8_t selfNode;
+static uint32_t helloAt;
+
+static uint8_t rxBuffer[LINK_RX_SIZE];
+static volatile uint16_t rxHead;          // DMA write position at the last idle line
+static volatile uint8_t rxRestart;        // a UART error stopped the reception
+static uint16_t rxTail;                   // next byte to decode
+static uint8_t rxFrame[LINK_FRAME_MAX];
+static uint8_t rxFill;
+
+static uint8_t txBuffer[LINK_TX_SIZE];
+static volatile uint16_t txIn;            // bytes queued since Link_Init
+static volatile uint16_t txOut;           // bytes the DMA finished
+static volatile uint16_t txSending;       // bytes of the transfer in progress
+
+static LinkFrame outbox[LINK_OUTBOX];
+static uint8_t outHead, outCount;
+static uint8_t awaiting;                  // peer slots yet to acknowledge the first frame
+static uint8_t tries;                     // transmissions of the first frame
+static uint32_t sentAt;
+static uint8_t txSeq;
+
+static uint8_t startSequence[LINK_PAYLOAD_MAX];   // payload of the last START frame
+
+/**
+ * @brief  Start the DMA on the bytes queued if it is idle. Runs in the
+ *         transfer complete interrupt and with interrupts masked.
+ */
+static void kick(void)
+{
+  uint16_t pending = txIn - txOut;
+  uint16_t start = txOut % LINK_TX_SIZE;
+
+  if (txSending || pending == 0)
+  { return; }
+
+  txSending = (pending < LINK_TX_SIZE - start) ? pending : LINK_TX_SIZE - start;
+  if (HAL_UART_Transmit_DMA(&hlpuart1, &txBuffer[start], txSending) != HAL_OK)
+  { txSending = 0; }   // the next Link_Poll tries again
+}
+
+/**
+ * @brief  Queue a frame for the DMA.
+ * @param  frame: Frame bytes.
+ * @param  length: Frame length.
+ */
+static void transmit(const uint8_t* frame, uint8_t length)
+{
+  if (LINK_TX_SIZE - (uint16_t)(txIn - txOut) < length)
+  {
+    stats.txDropped++;
+    return;
+  }
+  for (uint8_t i = 0; i < length; i++)
+  { txBuffer[(txIn + i) % LINK_TX_SIZE] = frame[i]; }
+  txIn += length;
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  kick();
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Fill in the header and the CRC of a frame.
+ * @param  frame: Frame buffer, the payload in place.
+ * @param  seq: Sequence number, 0 for HELLO and ACK.
+ * @param  type: LinkFrameType.
+ * @param  length: Payload length.
+ * @return Frame length.
+ */
+static uint8_t seal(uint8_t* frame, uint8_t seq, uint8_t type, uint8_t length)
+{
+  frame[0] = LINK_SOF;
+  frame[1] = selfNode;
+  frame[2] = seq;
+  frame[3] = type;
+  frame[4] = length;
+  frame[LINK_HEADER + length] = Crc8(&frame[1], LINK_HEADER - 1 + length);
+  return LINK_HEADER + length + 1;
+}
+
+/**
+ * @brief  Send a frame once, without waiting for an acknowledgement.
+ * @param  type: LINK_HELLO or LINK_ACK.
+ * @param  payload: Payload bytes.
+ * @param  length: Payload length.
+ */
+static void sendOnce(uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  uint8_t frame[LINK_FRAME_MAX];
+
+  memcpy(&frame[LINK_HEADER], payload, length);
+  transmit(frame, seal(frame, 0, type, length));
+}
+
+/**
+ * @brief  Mask of the peer slots in use.
+ */
+static uint8_t liveMask(void)
+{
+  uint8_t mask = 0;
+
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id)
+    { mask |= 1u << slot; }
+  }
+  return mask;
+}
+
+/**
+ * @brief  Drop the first frame of the outbox.
+ */
+static void popOutbox(void)
+{
+  outHead = (outHead + 1) % LINK_OUTBOX;
+  outCount--;
+  tries = 0;
+  awaiting = 0;
+}
+
+/**
+ * @brief  Send the first frame of the outbox, or resend it once
+ *         LINK_RETRY_MS passed without every acknowledgement.
+ * @param  now: HAL tick.
+ */
+static void serviceOutbox(uint32_t now)
+{
+  while (outCount > 0)
+  {
+    LinkFrame* frame = &outbox[outHead];
+
+    if (tries == 0)
+    {
+      // Every board linked now has to acknowledge it, nobody left is done
+      awaiting = liveMask();
+      if (!awaiting)
+      {
+        popOutbox();
+        continue;
+      }
+      if (++txSeq == 0)
+      { txSeq = 1; }   // 0 is never a sequence number, so a new peer takes any
+      seal(frame->bytes, txSeq, frame->bytes[3], frame->length);
+    }
+    else if (!awaiting)
+    {
+      popOutbox();
+      continue;
+    }
+    else if (now - sentAt < LINK_RETRY_MS)
+    { return; }
+    else if (tries > LINK_RETRIES)
+    {
+      stats.lost++;
+      popOutbox();
+      continue;
+    }
+    else
+    { stats.retries++; }
+
+    transmit(frame->bytes, LINK_HEADER + frame->length + 1);
+    sentAt = now;
+    tries++;
+    return;
+  }
+}
+
+/**
+ * @brief  Queue a frame that has to be acknowledged and send it right away
+ *         if the outbox was empty.
+ * @param  type: LinkFrameType.
+ * @param  payload: Payload bytes.
+ * @param  length: Payload length.
+ */
+static void sendReliable(uint8_t type, const uint8_t* payload, uint8_t length)
+{
+  LinkFrame* frame;
+
+  if (!liveMask())
+  { return; }
+  if (outCount == LINK_OUTBOX)
+  {
+    stats.txDropped++;
+    return;
+  }
+
+  frame = &outbox[(outHead + outCount) % LINK_OUTBOX];
+  frame->bytes[3] = type;
+  frame->length = length;
+  memcpy(&frame->bytes[LINK_HEADER], payload, length);
+  outCount++;
+  serviceOutbox(HAL_GetTick());
+}
+
+/**
+ * @brief  Post an EV_LINK event for the game.
+ * @param  kind: LinkEventKind.
+ * @param  arg: Detail, 0 to 15.
+ */
+static void notify(uint8_t kind, uint8_t arg)
+{
+  EventQueue_Push(events, EV_LINK, LINK_EVENT(kind, arg));
+}
+
+/**
+ * @brief  Forget the scores of the previous linked game.
+ */
+static void clearScores(void)
+{
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    peers[slot].score = 0;
+    peers[slot].round = 0;
+    peers[slot].done = 0;
+  }
+}
+
+/**
+ * @brief  Slot of the board sending with a node byte.
+ * @return Slot, LINK_PEERS_MAX if the board did not introduce itself.
+ */
+static uint8_t findPeer(uint8_t node)
+{
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id && peers[slot].node == node)
+    { return slot; }
+  }
+  return LINK_PEERS_MAX;
+}
+
+/**
+ * @brief  Read a 32-bit number sent least significant byte first.
+ */
+static uint32_t unpack32(const uint8_t* bytes)
+{
+  return bytes[0] | bytes[1] << 8 | bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+/**
+ * @brief  Add or refresh the board of a HELLO frame.
+ * @param  node: Node byte of the frame.
+ * @param  id: Board id.
+ * @param  boot: Boot count of the board.
+ * @param  now: HAL tick.
+ */
+static void hello(uint8_t node, uint32_t id, uint32_t boot, uint32_t now)
+{
+  uint8_t slot = findPeer(node);
+
+  if (slot < LINK_PEERS_MAX && peers[slot].id == id && peers[slot].boot == boot)
+  {
+    peers[slot].lastSeen = now;
+    return;
+  }
+  if (slot == LINK_PEERS_MAX)
+  {
+    for (slot = 0; slot < LINK_PEERS_MAX && peers[slot].id; slot++)
+    { }
+    if (slot == LINK_PEERS_MAX)
+    { return; }   // the link is full
+  }
+
+  // A new board, or one that restarted with the same id and a new boot
+  // count: its sequence numbers start over, so lastSeq goes back to 0
+  memset(&peers[slot], 0, sizeof(peers[slot]));
+  peers[slot].id = id;
+  peers[slot].boot = boot;
+  peers[slot].node = node;
+  peers[slot].lastSeen = now;
+  notify(LINK_EV_PEERS, Link_Peers());
+}
+
+/**
+ * @brief  Act on a frame that passed the CRC.
+ * @param  frame: Frame bytes.
+ */
+static void receive(const uint8_t* frame)
+{
+  uint32_t now = HAL_GetTick();
+  uint8_t node = frame[1], seq = frame[2], type = frame[3], length = frame[4];
+  const uint8_t* payload = &frame[LINK_HEADER];
+  uint8_t slot;
+
+  stats.rxFrames++;
+  if (node == selfNode)
+  { return; }   // our own frame, back from a hub
+
+  if (type == LINK_HELLO)
+  {
+    if (length >= 8)
+    { hello(node, unpack32(&payload[0]), unpack32(&payload[4]), now); }
+    return;
+  }
+
+  slot = findPeer(node);
+  if (slot == LINK_PEERS_MAX)
+  { return; }   // its HELLO comes first
+  peers[slot].lastSeen = now;
+
+  if (type == LINK_ACK)
+  {
+    if (length >= 2 && payload[0] == selfNode && payload[1] == txSeq && tries > 0)
+    { awaiting &= ~(1u << slot); }
+    return;
+  }
+
+  uint8_t ack[2] = {node, seq};
+  sendOnce(LINK_ACK, ack, sizeof(ack));
+  if (seq == peers[slot].lastSeq)
+  { return; }   // resent because the acknowledgement got lost
+  peers[slot].lastSeq = seq;
+
+  switch (type)
+  {
+    case LINK_START:
+      // Acknowledged all the same, a resend would not come out any better
+      if (length < 1 || payload[0] > LINK_SEQUENCE_MAX || length < 1 + (payload[0] + 3) / 4)
+      {
+        stats.rxErrors++;
+        break;
+      }
+      memcpy(startSequence, payload, length);
+      clearScores();
+      notify(LINK_EV_START, 0);
+      break;
+    case LINK_START_REQ:
+      notify(LINK_EV_START_REQ, 0);
+      break;
+    case LINK_INPUT:
+      if (length >= 3)
+      { notify(LINK_EV_INPUT, payload[2]); }
+      break;
+    case LINK_SCORE:
+      if (length >= 4)
+      {
+        peers[slot].round = payload[0];
+        peers[slot].score = payload[1] | payload[2] << 8;
+        peers[slot].done = payload[3];
+        notify(LINK_EV_SCORE, slot);
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * @brief  Feed one received byte to the frame decoder.
+ * @param  byte: Next byte of the stream.
+ */
+static void decode(uint8_t byte)
+{
+  if (rxFill == 0 && byte != LINK_SOF)
+  { return; }   // hunting for the start of a frame
+  rxFrame[rxFill++] = byte;
+
+  if (rxFill == LINK_HEADER && rxFrame[4] > LINK_PAYLOAD_MAX)
+  {
+    stats.rxErrors++;
+    rxFill = 0;
+    return;
+  }
+  if (rxFill > LINK_HEADER && rxFill == LINK_HEADER + rxFrame[4] + 1)
+  {
+    if (Crc8(&rxFrame[1], rxFill - 2) == rxFrame[rxFill - 1])
+    { receive(rxFrame); }
+    else
+    { stats.rxErrors++; }
+    rxFill = 0;
+  }
+}
+
+/**
+ * @brief  Start the circular DMA reception from the start of the buffer.
+ */
+static void startReception(void)
+{
+  rxHead = 0;
+  rxTail = 0;
+  rxFill = 0;
+  HAL_UARTEx_ReceiveToIdle_DMA(&hlpuart1, rxBuffer, LINK_RX_SIZE);
+}
+
+/**
+ * @brief  Start receiving and announce the board.
+ * @param  queue: Event queue of the game.
+ */
+void Link_Init(EventQueue* queue)
+{
+  events = queue;
+  selfId = HAL_GetUIDw0() ^ HAL_GetUIDw1() ^ HAL_GetUIDw2();
+  if (selfId == 0)
+  { selfId = 1; }   // 0 marks a free peer slot
+  selfNode = (uint8_t)(selfId ^ selfId >> 8 ^ selfId >> 16 ^ selfId >> 24);
+  // The UID stays the same across resets, the boot count tells them apart
+  if (!Store_Get(STORE_BOOTS, &selfBoot))
+  { selfBoot = 0; }
+  Store_Put(STORE_BOOTS, ++selfBoot);
+  helloAt = HAL_GetTick() - LINK_HELLO_MS;
+  startReception();
+}
+
+/**
+ * @brief  Decode the frames received, expire silent boards, send the
+ *         heartbeat and the outbox.
+ */
+void Link_Poll(void)
+{
+  uint32_t now = HAL_GetTick();
+  uint16_t head = rxHead;
+
+  if (rxRestart)
+  {
+    rxRestart = 0;
+    startReception();
+    head = 0;
+  }
+  while (rxTail != head)
+  {
+    decode(rxBuffer[rxTail]);
+    rxTail = (rxTail + 1) % LINK_RX_SIZE;
+  }
+
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id && now - peers[slot].lastSeen > LINK_PEER_TIMEOUT_MS)
+    {
+      peers[slot].id = 0;
+      awaiting &= ~(1u << slot);
+      notify(LINK_EV_PEERS, Link_Peers());
+    }
+  }
+
+  if (now - helloAt >= LINK_HELLO_MS)
+  {
+    uint8_t payload[8] = {(uint8_t)selfId, (uint8_t)(selfId >> 8), (uint8_t)(selfId >> 16), (uint8_t)(selfId >> 24),
+                          (uint8_t)selfBoot, (uint8_t)(selfBoot >> 8), (uint8_t)(selfBoot >> 16), (uint8_t)(selfBoot >> 24)};
+    helloAt = now;
+    sendOnce(LINK_HELLO, payload, sizeof(payload));
+  }
+
+  serviceOutbox(now);
+
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  kick();
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Check for bytes not decoded yet.
+ * @return 1 if Link_Poll has work, 0 otherwise.
+ */
+uint8_t Link_Pending(void)
+{
+  return rxHead != rxTail || rxRestart;
+}
+
+/**
+ * @brief  Boards linked besides this one.
+ */
+uint8_t Link_Peers(void)
+{
+  uint8_t count = 0;
+
+  for (uint8_t mask = liveMask(); mask; mask &= mask - 1)
+  { count++; }
+  return count;
+}
+
+/**
+ * @brief  Check whether this board leads the linked games.
+ * @return 1 if no linked board has a lower id, 0 otherwise.
+ */
+uint8_t Link_IsSimon(void)
+{
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id && peers[slot].id < selfId)
+    { return 0; }
+  }
+  return 1;
+}
+
+/**
+ * @brief  Send the sequence of a new linked game.
+ * @param  sequence: Colors 0 to 3.
+ * @param  length: Number of colors, at most LINK_SEQUENCE_MAX.
+ */
+void Link_SendStart(const uint8_t* sequence, uint8_t length)
+{
+  uint8_t payload[LINK_PAYLOAD_MAX] = {0};
+
+  if (length > LINK_SEQUENCE_MAX)
+  { length = LINK_SEQUENCE_MAX; }
+  payload[0] = length;
+  for (uint8_t i = 0; i < length; i++)
+  { payload[1 + i / 4] |= (sequence[i] & 0x03) << (2 * (i % 4)); }
+
+  clearScores();
+  sendReliable(LINK_START, payload, 1 + (length + 3) / 4);
+}
+
+/**
+ * @brief  Unpack the sequence of the last START frame received.
+ * @param  sequence: Filled with the colors.
+ * @param  size: Room in sequence.
+ * @return Number of colors, 0 if they do not fit.
+ */
+uint8_t Link_Sequence(uint8_t* sequence, uint8_t size)
+{
+  uint8_t length = startSequence[0];
+
+  if (length > size)
+  { return 0; }
+
+  for (uint8_t i = 0; i < length; i++)
+  { sequence[i] = (startSequence[1 + i / 4] >> (2 * (i % 4))) & 0x03; }
+  return length;
+}
+
+/**
+ * @brief  Ask Simon to start a linked game.
+ */
+void Link_SendStartRequest(void)
+{
+  sendReliable(LINK_START_REQ, NULL, 0);
+}
+
+/**
+ * @brief  Send a press to the other boards.
+ * @param  round: Round of the game.
+ * @param  index: Input of the round.
+ * @param  color: Color pressed.
+ */
+void Link_SendInput(uint8_t round, uint8_t index, uint8_t color)
+{
+  uint8_t payload[3] = {round, index, color};
+  sendReliable(LINK_INPUT, payload, sizeof(payload));
+}
+
+/**
+ * @brief  Send the score of this board.
+ * @param  round: Round reached.
+ * @param  score: Score so far.
+ * @param  done: 1 once the game of this board is over.
+ */
+void Link_SendScore(uint8_t round, uint16_t score, uint8_t done)
+{
+  uint8_t payload[4] = {round, (uint8_t)score, (uint8_t)(score >> 8), done};
+  sendReliable(LINK_SCORE, payload, sizeof(payload));
+}
+
+/**
+ * @brief  Place of a score among the linked boards.
+ * @param  score: Score of this board.
+ * @return 1 plus the number of boards with a higher score.
+ */
+uint8_t Link_Rank(uint16_t score)
+{
+  uint8_t rank = 1;
+
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id && peers[slot].score > score)
+    { rank++; }
+  }
+  return rank;
+}
+
+/**
+ * @brief  Best score of the other boards in the current linked game.
+ */
+uint16_t Link_BestScore(void)
+{
+  uint16_t best = 0;
+
+  for (uint8_t slot = 0; slot < LINK_PEERS_MAX; slot++)
+  {
+    if (peers[slot].id && peers[slot].score > best)
+    { best = peers[slot].score; }
+  }
+  return best;
+}
+
+/**
+ * @brief  Frame counters since Link_Init.
+ */
+const LinkStats* Link_Stats(void)
+{
+  return &stats;
+}
+
+/**
+ * @brief  Transfer complete, start on the bytes queued meanwhile. Called
+ *         from HAL_UART_TxCpltCallback.
+ */
+void Link_TxDone(void)
+{
+  txOut += txSending;
+  txSending = 0;
+  kick();
+}
+
+/**
+ * @brief  Idle line, half or full buffer during the reception. Called from
+ *         HAL_UARTEx_RxEventCallback.
+ * @param  size: Position the DMA writes at next.
+ */
+void Link_RxEvent(uint16_t size)
+{
+  rxHead = size % LINK_RX_SIZE;
+}
+
+/**
+ * @brief  Noise, framing or overrun error, the HAL stopped the reception.
+ *         Called from HAL_UART_ErrorCallback.
+ */
+void Link_RxError(void)
+{
+  stats.rxErrors++;
+  rxRestart = 1;
+}
+
+#endif
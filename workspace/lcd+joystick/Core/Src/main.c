@@ -22,11 +22,20 @@
 #include "tim.h"
 #include "usart.h"
 #include "gpio.h"
+#ifdef LCD_I2C
+#include "i2c.h"
+#endif
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
 #include "SimonGame.h"
 #include "lcd1602.h"
+#include "swtimer.h"
+#include "flashstore.h"
+#include "lcdmodel.h"
+#include "lcdi2c.h"
+#include "bench.h"
+#include "cycles.h"
 #include <stdio.h>
 #include <string.h>
 /* USER CODE END Includes */
@@ -38,6 +47,7 @@
 
 /* Private define ------------------------------------------------------------*/
 /* USER CODE BEGIN PD */
+#define LCD_TIMING_REPORT_MS 10000  // period of the LCD timing report on USART1
 
 /* USER CODE END PD */
 
@@ -50,6 +60,7 @@
 
 /* USER CODE BEGIN PV */
 Joystick_HandleTypeDef joystick;
+static Game play;   // game attached to the board's buttons
 // static int redButtonPressed = 0;
 // static int blueButtonPressed = 0;
 // static int yellowButtonPressed = 0;
@@ -117,6 +128,60 @@ void PeriphCommonClock_Config(void);
 //       }  
 //     }
 // }
+/**
+ * @brief  Print a line on USART1. With the console it queues behind the
+ *         replies on the transmit DMA, and telemetry builds leave it out,
+ *         since text would break into their binary frames.
+ * @param  msg: Null terminated line.
+ */
+static void report(const char* msg)
+{
+#if defined(TELEMETRY_UART)
+  (void)msg;
+#elif defined(USART1_DMA_TX)
+  USART1_Send(msg, strlen(msg));
+#else
+  HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
+#endif
+}
+
+#ifdef LCD_TIMING
+/**
+ * @brief  Print every LCD timing check on USART1: intervals measured,
+ *         violations and the smallest margin over the datasheet minimum.
+ */
+static void reportLcdTiming(void)
+{
+  char msg[64];
+
+  for (uint8_t i = 0; i < LCD_CHECK_COUNT; i++)
+  {
+    const LcdTimingCheck* check = LcdModel_TimingCheck(i);
+    snprintf(msg, sizeof(msg), "lcd %-5s n=%lu bad=%lu worst=%ld ns\r\n", check->name,
+             (unsigned long)check->samples, (unsigned long)check->violations,
+             (long)check->worstMarginNs);
+    report(msg);
+  }
+}
+#endif
+#ifdef LCD_I2C
+/**
+ * @brief  Print the count of dropped LCD backpack transfers on USART1 each
+ *         time it goes up, a frame that never reached the display.
+ */
+static void reportLcdDrops(void)
+{
+  static uint32_t reported;
+  uint32_t dropped = LcdI2c_Dropped();
+  char msg[40];
+
+  if (dropped == reported)
+  { return; }
+  reported = dropped;
+  snprintf(msg, sizeof(msg), "lcd i2c dropped=%lu\r\n", (unsigned long)dropped);
+  report(msg);
+}
+#endif
 /* USER CODE END 0 */
 
 /**
@@ -156,31 +221,71 @@ int main(void)
   MX_TIM2_Init();
   MX_TIM16_Init();
   /* USER CODE BEGIN 2 */
+  // The CPU load, the interrupt budgets, the press latency and the LCD_TIMING
+  // edges all read the cycle counter, which stays off until enabled
+  Cycles_Init();
+  SWTimer_Init();
+  // Delay_us needs TIM2 counting, Game_Tick ignores it until Game_Init is done
   HAL_TIM_Base_Start_IT(&htim2);
+  Store_Init();
+#ifdef LINK_UART
+  MX_LPUART1_UART_Init();
+#endif
   /*** Initialize LCD ***/
+#ifdef LCD_I2C
+  MX_I2C1_Init();
+#endif
   LCD_Init();
-  LCD_Cls();
   /*** End of LCD Initialization ***/
 
   /*** Initialize Joystick ***/
   Joystick_Init(&joystick, &hadc1, ADC_CHANNEL_7, ADC_CHANNEL_8, 
-                 GPIOC, GPIO_PIN_6);
-  Joystick_Calibrate(&joystick);
+                 JoyStick_SW_GPIO_Port, JoyStick_SW_Pin);
+  // Reuse the stored center unless it drifted or Red is held during reset
+  uint32_t center = 0;
+  uint8_t calibrated = 0;
+  if (HAL_GPIO_ReadPin(RedButton_GPIO_Port, RedButton_Pin) == GPIO_PIN_RESET ||
+      !Store_Get(STORE_JOY_CENTER, &center) || !Joystick_UseCenter(&joystick, center))
+  {
+    Store_Put(STORE_JOY_CENTER, Joystick_Calibrate(&joystick));
+    calibrated = 1;
+  }
   /*** End of Joystick Initialization ***/
 
+#ifdef SIMON_BENCH
+  Bench_Run(&joystick);
+#endif
+
   /* Initialize Game */
-  Game play;
   Game_Init(&play);
+
+  char msg[48];
+  snprintf(msg, sizeof(msg), "Boot to WELCOME: %lu ms (%s)\r\n", (unsigned long)HAL_GetTick(),
+           calibrated ? "calibrated" : "cached center");
+  report(msg);
   /* USER CODE END 2 */
 
   /* Infinite loop */
   /* USER CODE BEGIN WHILE */
+#ifdef LCD_TIMING
+  uint32_t lastReport = HAL_GetTick();
+#endif
   while (1)
   {
     /* USER CODE END WHILE */
 
     /* USER CODE BEGIN 3 */
     Game_Run(&play, &joystick);
+#ifdef LCD_TIMING
+    if (HAL_GetTick() - lastReport >= LCD_TIMING_REPORT_MS)
+    {
+      lastReport = HAL_GetTick();
+      reportLcdTiming();
+    }
+#endif
+#ifdef LCD_I2C
+    reportLcdDrops();
+#endif
   }
   /* USER CODE END 3 */
 }
@@ -263,7 +368,21 @@ void PeriphCommonClock_Config(void)
 }
 
 /* USER CODE BEGIN 4 */
-
+/**
+ * @brief  Timer period elapsed callback.
+ * @param  htim: Pointer to a TIM_HandleTypeDef structure that contains
+ *                the configuration information for TIM module.
+ */
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim)
+{
+  if (htim->Instance == TIM2)
+  {
+#ifndef SIMON_SOAK
+    SWTimer_Tick();
+#endif
+    Game_Tick(&play);
+  }
+}
 /* USER CODE END 4 */
 
 /**
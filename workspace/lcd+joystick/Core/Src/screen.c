@@ -0,0 +1,239 @@
+/*
+ * Screen templates on top of the LCD driver. The module keeps a copy of
+ * what the display shows; showing a screen renders the template and its
+ * fields into a new copy and sends only the characters that differ, with
+ * one cursor move per run of changed characters. The first screen writes
+ * its text, a score going from 41 to 42 writes one digit, and switching
+ * between two templates writes only the columns where they differ.
+ *
+ * Every row is rendered to the full width of the display, so nothing needs clearing
+ * in between and the clear instruction is left for blanking the display.
+ *
+ * A marquee is written once as whole DDRAM lines, 40 characters each, and
+ * scrolled with the display shift instruction: one command per step where
+ * rewriting the window would take a whole row of characters and two cursor moves. The
+ * next screen shifts the display back first, by the shorter way round.
+ *
+ * Each call ends with LCD_Flush, so on the I2C backpack a whole screen
+ * change leaves in one DMA transfer.
+ *
+ * Glyph and bar fields take their characters from the glyph manager while
+ * the screen is rendered, before the first character is sent, so glyph
+ * uploads never land between two characters of a run.
+ */
+
+#include "screen.h"
+#include "lcd1602.h"
+#include "board.h"
+#include <stddef.h>
+
+static BOARD_STATE char shown[SCREEN_ROWS][LCDFMT_COLS + 1];   // content of the display
+static BOARD_STATE const ScreenTemplate* current;              // screen shown last, NULL once cleared
+static BOARD_STATE uint32_t currentValues[SCREEN_FIELDS_MAX];
+static BOARD_STATE uint8_t shift;                              // columns the display is shifted left
+static BOARD_STATE uint8_t marqueeSteps;                       // shifts until the marquee is fully shown
+
+/**
+ * @brief  Render a progress bar, full cells from the character ROM and the
+ *         partly lit cell from CGRAM.
+ * @param  text: Filled with width characters.
+ * @param  width: Cells of the bar.
+ * @param  lit: Pixel columns lit, from the left.
+ * @return Characters written.
+ */
+static uint8_t renderBar(char* text, uint8_t width, uint32_t lit)
+{
+  for (uint8_t i = 0; i < width; i++)
+  {
+    uint32_t cell = (lit > i * SCREEN_BAR_STEPS) ? lit - i * SCREEN_BAR_STEPS : 0;
+
+    if (cell >= SCREEN_BAR_STEPS)
+    { text[i] = (char)GLYPH_FULL_BLOCK; }
+    else if (cell == 0)
+    { text[i] = ' '; }
+    else
+    { text[i] = (char)Glyph_Code(GLYPH_BAR_1 + cell - 1); }
+  }
+  text[width] = '\0';
+  return width;
+}
+
+/**
+ * @brief  Render one field into a row.
+ * @param  row: Row being rendered, LCDFMT_COLS + 1 bytes.
+ * @param  field: Field layout.
+ * @param  value: Number, or index into field->texts.
+ */
+static void renderField(char* row, const ScreenField* field, uint32_t value)
+{
+  char text[LCDFMT_COLS + 1];
+  uint8_t len = 0;
+
+  switch (field->kind)
+  {
+    case FIELD_NUMBER:
+      if (value != SCREEN_BLANK)
+      { len = LcdFmt_Dec(text, 0, value); }
+      break;
+    case FIELD_TEXT:
+      len = LcdFmt_Str(text, 0, field->texts[value]);
+      break;
+    case FIELD_GLYPH:
+      text[0] = (value < GLYPH_COUNT) ? (char)Glyph_Code((GlyphId)value) : ' ';
+      text[1] = '\0';
+      len = 1;
+      break;
+    case FIELD_BAR:
+      len = renderBar(text, field->width, value);
+      break;
+  }
+  LcdFmt_Pad(text, len, field->width);
+
+  for (uint8_t i = 0; text[i] && field->col + i < LCDFMT_COLS; i++)
+  { row[field->col + i] = text[i]; }
+}
+
+/**
+ * @brief  Undo the display shift left by a marquee.
+ */
+static void unshift(void)
+{
+  marqueeSteps = 0;
+  if (shift <= SCREEN_LINE_LEN / 2)
+  {
+    for (; shift > 0; shift--)
+    { LCD_cmd_4bit(0x1C); }   // Display shift right
+  }
+  else
+  {
+    for (; shift < SCREEN_LINE_LEN; shift++)
+    { LCD_cmd_4bit(0x18); }   // Display shift left, wrapping to the start
+    shift = 0;
+  }
+}
+
+/**
+ * @brief  Clear the display and start tracking its content and CGRAM.
+ */
+void Screen_Init(void)
+{
+  Glyph_Init();
+  Screen_Clear();
+}
+
+/**
+ * @brief  Show a template, sending only the characters that differ from
+ *         what the display shows.
+ * @param  screen: Template to show.
+ * @param  values: One value per field of the template, NULL if it has none.
+ */
+void Screen_Show(const ScreenTemplate* screen, const uint32_t* values)
+{
+  char next[SCREEN_ROWS][LCDFMT_COLS + 1];
+
+  unshift();
+  for (uint8_t row = 0; row < SCREEN_ROWS; row++)
+  {
+    const char* text = screen->rows[row] ? screen->rows[row] : "";
+    LcdFmt_Pad(next[row], LcdFmt_Str(next[row], 0, text), LCDFMT_COLS);
+  }
+  for (uint8_t i = 0; i < screen->fieldCount; i++)
+  {
+    renderField(next[screen->fields[i].row], &screen->fields[i], values[i]);
+    currentValues[i] = values[i];
+  }
+  current = screen;
+
+  for (uint8_t row = 0; row < SCREEN_ROWS; row++)
+  {
+    uint8_t cursor = LCDFMT_COLS;   // column the address counter points at on this row
+
+    for (uint8_t col = 0; col < LCDFMT_COLS; col++)
+    {
+      if (next[row][col] == shown[row][col])
+      { continue; }
+      if (cursor != col)
+      { LCD_GotoXY(col, row); }
+      LCD_data_4bit(next[row][col]);
+      shown[row][col] = next[row][col];
+      cursor = col + 1;
+    }
+  }
+  LCD_Flush();
+}
+
+/**
+ * @brief  Change one field of the screen shown last and send the difference.
+ * @param  field: Index of the field in the template.
+ * @param  value: New value of the field.
+ */
+void Screen_Set(uint8_t field, uint32_t value)
+{
+  uint32_t values[SCREEN_FIELDS_MAX];
+
+  if (!current || field >= current->fieldCount)
+  { return; }
+  for (uint8_t i = 0; i < current->fieldCount; i++)
+  { values[i] = currentValues[i]; }
+  values[field] = value;
+  Screen_Show(current, values);
+}
+
+/**
+ * @brief  Write a marquee into DDRAM and show its start.
+ * @param  rows: Text of each row, longer rows are cut at SCREEN_LINE_LEN.
+ */
+void Screen_Marquee(const char* const rows[SCREEN_ROWS])
+{
+  uint8_t longest = 0;
+
+  unshift();
+  current = NULL;
+  for (uint8_t row = 0; row < SCREEN_ROWS; row++)
+  {
+    const char* text = rows[row] ? rows[row] : "";
+    uint8_t len = 0;
+
+    LCD_GotoXY(0, row);
+    for (uint8_t col = 0; col < SCREEN_LINE_LEN; col++)
+    {
+      char c = text[len] ? text[len++] : ' ';
+      LCD_data_4bit(c);
+      if (col < LCDFMT_COLS)
+      { shown[row][col] = c; }
+    }
+    if (len > longest)
+    { longest = len; }
+  }
+  marqueeSteps = (longest > LCDFMT_COLS) ? longest - LCDFMT_COLS : 0;
+  LCD_Flush();
+}
+
+/**
+ * @brief  Scroll the marquee one column.
+ * @return 1 if the display was shifted, 0 once the marquee is fully shown.
+ */
+uint8_t Screen_Scroll(void)
+{
+  if (marqueeSteps == 0)
+  { return 0; }
+  LCD_cmd_4bit(0x18);   // Display shift left
+  LCD_Flush();
+  shift++;
+  marqueeSteps--;
+  return 1;
+}
+
+/**
+ * @brief  Blank the display with one clear instruction, which also undoes
+ *         a display shift.
+ */
+void Screen_Clear(void)
+{
+  current = NULL;
+  shift = 0;
+  marqueeSteps = 0;
+  LCD_Cls();
+  for (uint8_t row = 0; row < SCREEN_ROWS; row++)
+  { LcdFmt_Pad(shown[row], 0, LCDFMT_COLS); }
+}
@@ -0,0 +1,901 @@
+/*
+ * Soak test driver, built with make -f STM32Make.make VARIANT=SOAK, or
+ * VARIANT=FUZZ for the random input version and VARIANT=REPLAY to play
+ * back a recorded input trace. test/host builds the same variants for the
+ * host, on the simulated HAL of test/host/sim.c.
+ *
+ * The game runs on virtual time: instead of sleeping until the next TIM2
+ * interrupt, the idle loop advances the timer wheel by one tick right away,
+ * so every delay of the game costs a few microseconds and the timers still
+ * expire in the same order as on real time. On the host the idle loop
+ * sleeps in WFI and the simulated HAL runs its clock to the next TIM2
+ * update instead, whose handler ticks the wheel. The LCD delays are
+ * skipped and the per press UART log is off.
+ *
+ * A bot plays game after game through the same event queue as the buttons
+ * and the joystick, with a random reaction time and a planned mistake, and
+ * checks the game data and every state change along the way. Everything is
+ * derived from SOAK_SEED, so a run is reproducible from the seed printed
+ * with each violation. Finished games feed round and score histograms that
+ * are printed with the throughput every SOAK_HISTOGRAM_GAMES games.
+ *
+ * The display bus is decoded by the HD44780 model: each screen the game
+ * leaves on the glass must match one of the golden frames below, the
+ * display may only be shifted while the WELCOME marquee scrolls, every
+ * custom glyph on it must show the CGRAM pixels of the glyph the manager
+ * believes resident, and the bus transactions each screen costs are
+ * summed up with the histograms. make test of test/host also fails a run
+ * in which one of the golden frames never showed.
+ *
+ * The fuzz build replaces the bot's play with a random stream of joystick
+ * and button events at random intervals, from bursts within one tick to
+ * pauses long enough for the menus to time out. Every (state, event) pair
+ * the state machine dispatches is recorded, and half of the inputs go to
+ * event types the current state has not handled yet. The same checks run
+ * on every step; a violation is reproduced by flashing the same SOAK_SEED
+ * and waiting for the game number it reports.
+ *
+ * The replay build posts the inputs of Core/Inc/replaytrace.h at the wheel
+ * tick they were recorded in, relative to Game_Init, and seeds rand() with
+ * the recorded seeds. It prints every screen and tone with its tick, and
+ * at the end of the trace the time from an input to the next screen. Two
+ * builds that handle the inputs the same way print the same lines.
+ */
+
+#include "soak.h"
+
+#ifdef SIMON_SOAK
+
+#include "swtimer.h"
+#include "lcdmodel.h"
+#include "lcdi2c.h"
+#include "glyph.h"
+#include "usart.h"
+#include "trace.h"
+#include "board.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SOAK_REACTION_TICKS  30   // longest bot reaction time in wheel ticks
+#define STATE_BIT(state)     (1u << (state))
+#define SOAK_PERFECT_GAMES   256  // one game in this many is played without a mistake
+#define FUZZ_BURST_TICKS     4    // longest gap between two inputs of a burst
+#define FUZZ_PAUSE_TICKS     1500 // longest pause, past the 10 s menu timeout
+#define FUZZ_PAUSE_ODDS      16   // one gap in this many is a pause
+#define REPLAY_SETTLE_TICKS  1000 // ticks after the last record before the replay totals
+#define SOAK_GLYPH           '@'  // printed for a custom glyph
+#define SOAK_FULL_BLOCK      '#'  // printed for the full block of the character ROM
+
+#ifdef SIMON_HOST
+#define WALL_MS()            Sim_WallMs()   // HAL_GetTick runs on the virtual clock
+#else
+#define WALL_MS()            HAL_GetTick()
+#endif
+
+#ifdef SIMON_FUZZ
+#define FUZZ_INPUT           1    // random input instead of the bot's play
+#else
+#define FUZZ_INPUT           0
+#endif
+
+typedef struct
+{
+  uint32_t rng;           // xorshift32 state of the bot
+  uint32_t runSeed;       // rng at the start of the run
+  uint32_t seed;          // srand seed of the current game
+  uint32_t wallStart;     // wall clock ms when the soak started
+  uint16_t wait;          // ticks left before the bot acts again
+  uint8_t numPlayers;     // mode the bot picks for the current game
+  uint8_t failRound;      // round in which the bot answers wrong
+  uint8_t failIndex;      // input of that round which is wrong
+  uint8_t idleMenu;       // let the menu time out once instead of starting
+  uint8_t flagged;        // the current game already reported a violation
+  uint16_t lastScores[PLAYERS_MAX];   // scores seen on the previous check
+  uint32_t lcdDropped;    // LCD backpack transfers dropped so far
+} SoakBot;
+
+// Every screen the game can show, %d matches a number
+static const char* const goldenFrames[][LCD_MODEL_ROWS] =
+{
+  {"Welcome to the Simon Game", "Repeat what Simon plays"},   // start of the marquee
+  {"Push To Start!", "%g%d"},
+  {"Play Again?", "Push to Start%g%d"},
+  {"How many players", "Up/Down: %d%g%d"},
+  {"Round %d", "Simon's Turn!%g"},
+  {"Player's Turn!", "Score: %d%g"},
+  {"Round %d", ""},
+  {"Player %d's Turn", "Score: %d%g"},
+  {"Wrong! Game Over", ""},
+  {"Wrong!", "Player %d is out"},
+  {"Game Over!", "P1 Score: %d"},
+  {"New High Score!", "P1 Score: %d"},
+#if LCD_MODEL_ROWS >= 4
+  {"Game Over!", "Player %d Wins", "P%d Score: %d", "P%d Score: %d"},
+  {"Game Over!", "Players Tied", "P%d Score: %d", "P%d Score: %d"},
+  {"P%d Score: %d", "P%d Score: %d", "P%d Score: %d", "P%d Score: %d"},
+  {"P%d Score: %d", "P%d Score: %d", "P%d Score: %d"},
+#else
+  {"Game Over!", "Player %d Wins"},
+  {"Game Over!", "Players Tied"},
+#endif
+  {"P%d Score: %d", "P%d Score: %d"},   // scoreboard
+  {"P%d Score: %d"},
+  {"", ""},
+};
+
+#define GOLDEN_FRAMES  (sizeof(goldenFrames) / sizeof(goldenFrames[0]))
+
+static BOARD_STATE SoakBot bot = { .rng = SOAK_SEED, .runSeed = SOAK_SEED };
+static BOARD_STATE SoakStats stats;
+
+#ifdef SIMON_REPLAY
+#include "replaytrace.h"
+
+#define REPLAY_RECORDS  (sizeof(replayTrace) / sizeof(replayTrace[0]))
+
+typedef struct
+{
+  uint16_t next;          // index of the next record of replayTrace
+  uint32_t at;            // wheel tick the next record is due
+  uint8_t done;           // the whole trace was posted
+  uint8_t pending;        // an input is waiting for the next screen
+  uint32_t inputTick;     // wheel tick of that input
+  uint32_t inputs;        // inputs posted
+  uint32_t frames;        // screens printed
+  uint32_t tones;         // tones started
+  uint32_t latencies;     // inputs followed by a screen
+  uint32_t latencySum;    // ticks from input to screen, summed
+  uint32_t latencyMax;    // longest of them
+} Replay;
+
+static BOARD_STATE Replay replay;
+
+static void replayFrame(char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1]);
+#endif
+
+// Leaf states each leaf state may move to
+static const uint16_t allowedTransitions[GAME_STATE_COUNT] =
+{
+  [WELCOME]       = STATE_BIT(START),
+  [START]         = STATE_BIT(PLAYER_SELECT) | STATE_BIT(WAKE_UP),
+  [PLAY_AGAIN]    = STATE_BIT(PLAYER_SELECT) | STATE_BIT(WAKE_UP),
+  [PLAYER_SELECT] = STATE_BIT(ONE_PLAYER) | STATE_BIT(MULTI_PLAYER) | STATE_BIT(WAKE_UP),
+  [ONE_PLAYER]    = STATE_BIT(GAME_RESULT),
+  [MULTI_PLAYER]  = STATE_BIT(GAME_RESULT),
+  [GAME_RESULT]   = STATE_BIT(PLAY_AGAIN),
+  [WAKE_UP]       = STATE_BIT(WELCOME),
+};
+
+/**
+ * @brief  Next number of the bot's xorshift32 generator.
+ */
+static uint32_t botRandom(void)
+{
+  bot.rng ^= bot.rng << 13;
+  bot.rng ^= bot.rng >> 17;
+  bot.rng ^= bot.rng << 5;
+  return bot.rng;
+}
+
+/**
+ * @brief  Send a line over USART1.
+ * @param  msg: Null terminated text.
+ */
+static void report(const char* msg)
+{
+  HAL_UART_Transmit(&huart1, (uint8_t*)msg, strlen(msg), 1000);
+}
+
+/**
+ * @brief  Count and report a violation with what is needed to reproduce it.
+ * @param  game: Pointer to the Game structure.
+ * @param  what: Short description of the violation.
+ */
+static void violation(Game* game, const char* what)
+{
+  char msg[96];
+
+  stats.violations++;
+  if (bot.flagged)
+  { return; }
+
+  bot.flagged = 1;
+  snprintf(msg, sizeof(msg), "soak violation: %s game=%lu seed=%lu state=%u round=%u\r\n",
+           what, (unsigned long)stats.played, (unsigned long)bot.seed,
+           game->state, game->info.round);
+  report(msg);
+}
+
+/**
+ * @brief  Report progress: games, rounds, throughput and simulated versus
+ *         wall time.
+ */
+static void reportProgress(void)
+{
+  char msg[144];
+  uint64_t simMs = (uint64_t)SWTimer_Now() * SWTIMER_TICK_MS;
+  uint32_t wallMs = WALL_MS() - bot.wallStart;
+
+  snprintf(msg, sizeof(msg), "soak games=%lu rounds=%lu rate=%lu/s sim=%lus wall=%lus speedup=%lux violations=%lu\r\n",
+           (unsigned long)stats.played, (unsigned long)stats.roundsPlayed,
+           (unsigned long)(wallMs ? (uint64_t)stats.played * 1000 / wallMs : 0),
+           (unsigned long)(simMs / 1000), (unsigned long)(wallMs / 1000),
+           (unsigned long)(wallMs ? simMs / wallMs : 0), (unsigned long)stats.violations);
+  report(msg);
+}
+
+/**
+ * @brief  Print the non empty buckets of a histogram on one line.
+ * @param  name: Line prefix.
+ * @param  counts: Bucket counts.
+ * @param  buckets: Number of buckets.
+ * @param  width: Value range of one bucket, printed as the bucket start.
+ */
+static void reportHistogram(const char* name, const uint32_t* counts, uint8_t buckets, uint16_t width)
+{
+  char msg[24];
+
+  report(name);
+  for (uint8_t i = 0; i < buckets; i++)
+  {
+    if (counts[i])
+    {
+      snprintf(msg, sizeof(msg), " %u:%lu", i * width, (unsigned long)counts[i]);
+      report(msg);
+    }
+  }
+  report("\r\n");
+}
+
+/**
+ * @brief  Number of bits set over a coverage table.
+ * @param  bits: One bit set per covered pair.
+ */
+static uint16_t countCovered(const uint16_t bits[GAME_STATE_COUNT])
+{
+  uint16_t count = 0;
+
+  for (uint8_t i = 0; i < GAME_STATE_COUNT; i++)
+  {
+    for (uint16_t b = bits[i]; b; b &= b - 1)
+    { count++; }
+  }
+  return count;
+}
+
+/**
+ * @brief  Add a finished game to the histograms.
+ * @param  game: Pointer to the Game structure.
+ */
+static void recordGame(Game* game)
+{
+  uint8_t mode = (game->info.numPlayers > 1) ? 1 : 0;
+
+  stats.games[game->info.numPlayers - 1]++;
+  stats.rounds[(game->info.round < SOAK_MAX_ROUND) ? game->info.round : SOAK_MAX_ROUND]++;
+
+  for (uint8_t p = 0; p < game->info.numPlayers; p++)
+  {
+    uint16_t bucket = game->info.playerScores[p] / SOAK_SCORE_BUCKET;
+    stats.scores[mode][(bucket < SOAK_SCORE_BUCKETS) ? bucket : SOAK_SCORE_BUCKETS - 1]++;
+  }
+
+  if (stats.played % SOAK_HISTOGRAM_GAMES == 0)
+  { Soak_Report(&stats); }
+}
+
+/**
+ * @brief  Check the ring of the players still in and the elimination list:
+ *         together they hold every player once, the ring in player order
+ *         from the current player, whose predecessor is previousPlayer.
+ * @param  info: Pointer to the GameInfo structure.
+ * @return 1 if the lists are sound, 0 otherwise.
+ */
+static uint8_t checkRing(const GameInfo* info)
+{
+  uint8_t seen = 0;
+  uint8_t player = info->currentPlayer;
+  uint8_t wraps = 0;
+
+  if (info->playersLeft < 1 || info->playersLeft > info->numPlayers ||
+      player >= info->numPlayers || info->nextPlayer[info->previousPlayer] != player)
+  { return 0; }
+  for (uint8_t i = 0; i < info->playersLeft; i++)
+  {
+    uint8_t next = info->nextPlayer[player];
+    if (next >= info->numPlayers || (seen & (1u << player)))
+    { return 0; }
+    seen |= 1u << player;
+    wraps += next <= player;
+    player = next;
+  }
+  if (player != info->currentPlayer || wraps != 1)
+  { return 0; }
+
+  for (player = info->eliminated; player != PLAYER_NONE; player = info->nextPlayer[player])
+  {
+    if (player >= info->numPlayers || (seen & (1u << player)))
+    { return 0; }
+    seen |= 1u << player;
+  }
+  return seen == (uint8_t)((1u << info->numPlayers) - 1);
+}
+
+/**
+ * @brief  Check the game data against its bounds.
+ * @param  game: Pointer to the Game structure.
+ */
+static void checkInvariants(Game* game)
+{
+  GameInfo* info = &game->info;
+
+  if (info->sequenceLength > SEQUENCE_MAX)
+  { violation(game, "sequence overflow"); }
+
+  if (game->state == ONE_PLAYER || game->state == MULTI_PLAYER)
+  {
+    if (info->numPlayers < 1 || info->numPlayers > PLAYERS_MAX)
+    { violation(game, "bad player count"); }
+    else if (!checkRing(info))
+    { violation(game, "broken player ring"); }
+    if (Game_AwaitedInput(game) >= info->sequenceLength)
+    { violation(game, "awaited input past the sequence"); }
+    for (uint8_t p = 0; p < info->numPlayers && p < PLAYERS_MAX; p++)
+    {
+      if (info->playerScores[p] < bot.lastScores[p])
+      { violation(game, "score went down"); }
+    }
+  }
+
+  memcpy(bot.lastScores, info->playerScores, sizeof(bot.lastScores));
+
+#ifdef LCD_I2C
+  if (LcdI2c_Dropped() != bot.lcdDropped)
+  {
+    bot.lcdDropped = LcdI2c_Dropped();
+    violation(game, "lcd transfer dropped");
+  }
+#endif
+}
+
+/**
+ * @brief  Match one display line against a golden line, ignoring trailing
+ *         spaces. %d in the golden line matches one or more digits, and
+ *         the padding of their field when a glyph run follows, %g any run
+ *         of glyphs and spaces. Golden text past the last column is cut
+ *         off, as on the display, and a NULL golden is a blank line.
+ * @param  golden: Expected text.
+ * @param  line: Rendered line.
+ * @return 1 if the line matches, 0 otherwise.
+ */
+static uint8_t matchLine(const char* golden, const char* line)
+{
+  if (!golden)
+  { golden = ""; }
+  while (*golden)
+  {
+    if (golden[0] == '%' && golden[1] == 'd')
+    {
+      if (*line < '0' || *line > '9')
+      { return 0; }
+      while (*line >= '0' && *line <= '9')
+      { line++; }
+      golden += 2;
+      while (*line == ' ' && golden[0] == '%')
+      { line++; }
+    }
+    else if (golden[0] == '%' && golden[1] == 'g')
+    {
+      while (*line == SOAK_GLYPH || *line == SOAK_FULL_BLOCK || *line == ' ')
+      { line++; }
+      golden += 2;
+    }
+    else if (*line == '\0')
+    { return 1; }   // the rest of the golden is past the last column
+    else if (*golden++ != *line++)
+    { return 0; }
+  }
+
+  while (*line == ' ')
+  { line++; }
+  return *line == '\0';
+}
+
+/**
+ * @brief  Check the custom glyphs on the screen against CGRAM and replace
+ *         them, and the full block, by printable characters.
+ * @param  game: Pointer to the Game structure.
+ * @param  frame: Rendered display lines.
+ */
+static void checkGlyphs(Game* game, char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1])
+{
+  const uint8_t* cgram = LcdModel_Cgram();
+
+  for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+  {
+    for (uint8_t col = 0; col < LCD_MODEL_COLS; col++)
+    {
+      uint8_t code = (uint8_t)frame[row][col];
+      if (code == GLYPH_FULL_BLOCK)
+      { frame[row][col] = SOAK_FULL_BLOCK; }
+      if (code < GLYPH_CODE_BASE || code >= GLYPH_CODE_BASE + GLYPH_SLOTS)
+      { continue; }
+
+      uint8_t slot = code - GLYPH_CODE_BASE;
+      GlyphId id = Glyph_Resident(slot);
+      if (id == GLYPH_NONE || memcmp(&cgram[slot * GLYPH_ROWS], Glyph_Rows(id), GLYPH_ROWS) != 0)
+      { violation(game, "glyph not in CGRAM"); }
+      frame[row][col] = SOAK_GLYPH;
+    }
+  }
+}
+
+/**
+ * @brief  Check the screen left by the last event against the golden frames
+ *         and account for the bus transactions it took.
+ * @param  game: Pointer to the Game structure.
+ */
+static void checkFrame(Game* game)
+{
+  char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1];
+  LcdModelStats lcd;
+
+  if (!LcdModel_TakeFrame(&lcd))
+  { return; }
+
+  stats.frames++;
+  stats.strobes += lcd.strobes;
+  stats.clears += lcd.clears;
+  if (lcd.strobes > stats.maxStrobes)
+  { stats.maxStrobes = lcd.strobes; }
+
+  LcdModel_Render(frame);
+  checkGlyphs(game, frame);
+#ifdef SIMON_REPLAY
+  replayFrame(frame);
+#endif
+  if (LcdModel_Shift() != 0)
+  {
+    if (game->state != WELCOME)
+    { violation(game, "display shifted"); }
+    return;
+  }
+  for (uint8_t i = 0; i < GOLDEN_FRAMES; i++)
+  {
+    uint8_t row = 0;
+    while (row < LCD_MODEL_ROWS && matchLine(goldenFrames[i][row], frame[row]))
+    { row++; }
+    if (row == LCD_MODEL_ROWS)
+    {
+      stats.goldenSeen |= 1u << i;
+      return;
+    }
+  }
+
+  violation(game, "unknown frame");
+  for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+  {
+    report("  |");
+    report(frame[row]);
+    report("|\r\n");
+  }
+}
+
+#ifndef SIMON_REPLAY
+/**
+ * @brief  Color the bot presses for the awaited input.
+ * @param  game: Pointer to the Game structure.
+ * @param  index: Index of the awaited input within the turn.
+ */
+static uint8_t pickColor(Game* game, uint8_t index)
+{
+  GameInfo* info = &game->info;
+  uint8_t checked = (info->numPlayers > 1) ? info->sequenceLength - 1 : info->sequenceLength;
+  uint8_t color;
+
+  if (index >= checked)
+  { return botRandom() % 4; }   // the new color of a turn with several players
+  color = info->sequence[index];
+
+  if (info->round == bot.failRound && index == bot.failIndex % checked)
+  { color = (color + 1 + botRandom() % 3) % 4; }
+  return color;
+}
+
+/**
+ * @brief  Give the input the current state is waiting for, if any.
+ * @param  game: Pointer to the Game structure.
+ * @return 1 if an event was queued, 0 if the bot has nothing to do.
+ */
+static uint8_t act(Game* game)
+{
+  int index;
+
+  switch (game->state)
+  {
+    case START:
+    case PLAY_AGAIN:
+      if (bot.idleMenu)
+      { return 0; }
+      return Game_PostEvent(game, EV_JOY_PRESS, 0);
+
+    case PLAYER_SELECT:
+      if (game->info.numPlayers != bot.numPlayers)
+      { return Game_PostEvent(game, (bot.numPlayers > game->info.numPlayers) ? EV_JOY_DOWN : EV_JOY_UP, 0); }
+
+      // The one player game seeds rand() itself from the joystick on target
+      bot.seed = botRandom();
+      srand(bot.seed);
+      return Game_PostEvent(game, EV_JOY_PRESS, 0);
+
+    case ONE_PLAYER:
+    case MULTI_PLAYER:
+      index = Game_AwaitedInput(game);
+      if (index < 0)
+      { return 0; }
+      return Game_PostEvent(game, EV_BUTTON, pickColor(game, index));
+
+    case WAKE_UP:
+      return Game_PostEvent(game, EV_JOY_PRESS, 0);
+
+    default:
+      return 0;
+  }
+}
+
+/**
+ * @brief  Queue one random input, preferring event types the current state
+ *         has not handled yet.
+ * @param  game: Pointer to the Game structure.
+ * @return 1 if an event was queued, 0 if the queue was full.
+ */
+static uint8_t fuzzAct(Game* game)
+{
+  static const uint8_t inputs[] = {EV_JOY_PRESS, EV_JOY_UP, EV_JOY_DOWN, EV_BUTTON};
+  uint8_t pick = botRandom() % sizeof(inputs);
+  uint8_t type = inputs[pick];
+
+  if (botRandom() & 1)
+  {
+    for (uint8_t i = 0; i < sizeof(inputs); i++)
+    {
+      uint8_t candidate = inputs[(pick + i) % sizeof(inputs)];
+      if (!(stats.events[game->state] & (1u << candidate)))
+      {
+        type = candidate;
+        break;
+      }
+    }
+  }
+  return Game_PostEvent(game, type, (type == EV_BUTTON) ? botRandom() % 4 : 0);
+}
+
+/**
+ * @brief  Give the input of the bot or of the fuzzer once its wait is over.
+ * @param  game: Pointer to the Game structure.
+ * @return 1 if an event was queued, 0 if time moves on.
+ */
+static uint8_t nextInput(Game* game)
+{
+  if (bot.wait > 0)
+  { return 0; }
+
+  if (FUZZ_INPUT && fuzzAct(game))
+  {
+    bot.wait = (botRandom() % FUZZ_PAUSE_ODDS == 0) ? botRandom() % FUZZ_PAUSE_TICKS
+                                                    : botRandom() % FUZZ_BURST_TICKS;
+    return 1;
+  }
+  if (!FUZZ_INPUT && act(game))
+  {
+    bot.wait = 1 + botRandom() % SOAK_REACTION_TICKS;
+    return 1;
+  }
+  return 0;
+}
+#else
+/**
+ * @brief  Report the replay totals once the last record has settled.
+ */
+static void replayDone(void)
+{
+  char msg[128];
+
+  snprintf(msg, sizeof(msg), "replay done t=%lu inputs=%lu frames=%lu tones=%lu latency avg=%lums max=%lums\r\n",
+           (unsigned long)SWTimer_Now(), (unsigned long)replay.inputs,
+           (unsigned long)replay.frames, (unsigned long)replay.tones,
+           (unsigned long)(replay.latencies ? replay.latencySum * SWTIMER_TICK_MS / replay.latencies : 0),
+           (unsigned long)(replay.latencyMax * SWTIMER_TICK_MS));
+  report(msg);
+}
+
+/**
+ * @brief  Post the trace records due at the current wheel tick.
+ * @param  game: Pointer to the Game structure.
+ * @return 1 if an event was queued, 0 if time moves on.
+ */
+static uint8_t nextInput(Game* game)
+{
+  uint8_t posted = 0;
+  char msg[40];
+
+  while (replay.next < REPLAY_RECORDS && (int32_t)(SWTimer_Now() - replay.at) >= 0)
+  {
+    uint16_t value = replayTrace[replay.next].value;
+    uint8_t type = TRACE_TYPE(value);
+
+    if (type == TRACE_SEED)
+    { srand(TRACE_PARAM(value)); }
+    else if (type != TRACE_WAIT)
+    {
+      // A full queue takes the rest on the next idle call, in the same tick
+      if (!Game_PostEvent(game, type, TRACE_PARAM(value)))
+      { return 1; }
+      snprintf(msg, sizeof(msg), "replay %lu input %u %u\r\n",
+               (unsigned long)SWTimer_Now(), type, TRACE_PARAM(value));
+      report(msg);
+      replay.inputs++;
+      if (!replay.pending)
+      {
+        replay.pending = 1;
+        replay.inputTick = SWTimer_Now();
+      }
+      posted = 1;
+    }
+
+    if (++replay.next < REPLAY_RECORDS)
+    { replay.at += replayTrace[replay.next].delta; }
+  }
+
+  if (replay.next == REPLAY_RECORDS && !replay.done &&
+      SWTimer_Now() - replay.at >= REPLAY_SETTLE_TICKS)
+  {
+    replay.done = 1;
+    replayDone();
+  }
+  return posted;
+}
+
+/**
+ * @brief  Print a screen of the replay and account for the input latency.
+ * @param  frame: Rendered display lines.
+ */
+static void replayFrame(char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1])
+{
+  char msg[64];
+
+  replay.frames++;
+  if (replay.pending)
+  {
+    uint32_t latency = SWTimer_Now() - replay.inputTick;
+    replay.pending = 0;
+    replay.latencies++;
+    replay.latencySum += latency;
+    if (latency > replay.latencyMax)
+    { replay.latencyMax = latency; }
+  }
+
+  snprintf(msg, sizeof(msg), "replay %lu frame |", (unsigned long)SWTimer_Now());
+  report(msg);
+  for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+  {
+    snprintf(msg, sizeof(msg), "%s|", frame[row]);
+    report(msg);
+  }
+  report("\r\n");
+}
+
+/**
+ * @brief  Whether the replay is over.
+ * @return 1 once the whole trace was posted and the game settled.
+ */
+uint8_t Soak_ReplayDone(void)
+{
+  return replay.done;
+}
+
+/**
+ * @brief  Print a tone of the replay.
+ * @param  game: Pointer to the Game structure.
+ * @param  color: Color index of the tone.
+ * @param  ms: Tone duration.
+ */
+void Soak_OnTone(Game* game, uint8_t color, uint32_t ms)
+{
+  char msg[48];
+
+  replay.tones++;
+  snprintf(msg, sizeof(msg), "replay %lu tone %u %lums\r\n", (unsigned long)SWTimer_Now(), color, (unsigned long)ms);
+  report(msg);
+}
+#endif
+
+/**
+ * @brief  Print the games per mode, the round and score histograms, the
+ *         display and the coverage counts of a run.
+ * @param  run: Statistics of the run, Soak_Stats() or merged from several.
+ */
+void Soak_Report(const SoakStats* run)
+{
+  char msg[96];
+
+  report("soak modes");
+  for (uint8_t p = 0; p < PLAYERS_MAX; p++)
+  {
+    snprintf(msg, sizeof(msg), " %uP=%lu", p + 1, (unsigned long)run->games[p]);
+    report(msg);
+  }
+  report("\r\n");
+  reportHistogram("soak rounds", run->rounds, SOAK_MAX_ROUND + 1, 1);
+  reportHistogram("soak scores 1P", run->scores[0], SOAK_SCORE_BUCKETS, SOAK_SCORE_BUCKET);
+  reportHistogram("soak scores NP", run->scores[1], SOAK_SCORE_BUCKETS, SOAK_SCORE_BUCKET);
+
+  snprintf(msg, sizeof(msg), "soak lcd frames=%lu strobes/frame=%lu max=%lu clears=%lu golden=%u/%u\r\n",
+           (unsigned long)run->frames,
+           (unsigned long)(run->frames ? run->strobes / run->frames : 0),
+           (unsigned long)run->maxStrobes, (unsigned long)run->clears,
+           (unsigned)(GOLDEN_FRAMES - Soak_GoldenUnseen(run, 0)), (unsigned)GOLDEN_FRAMES);
+  report(msg);
+
+  snprintf(msg, sizeof(msg), "soak cover events=%u transitions=%u\r\n",
+           countCovered(run->events), countCovered(run->transitions));
+  report(msg);
+}
+
+/**
+ * @brief  Count the golden frames a run never showed, a screen the game no
+ *         longer reaches or no longer draws as it should.
+ * @param  run: Statistics of the run.
+ * @param  print: 1 to print each of them.
+ * @return Number of golden frames never shown.
+ */
+uint8_t Soak_GoldenUnseen(const SoakStats* run, uint8_t print)
+{
+  uint8_t unseen = 0;
+
+  for (uint8_t i = 0; i < GOLDEN_FRAMES; i++)
+  {
+    if (run->goldenSeen & (1u << i))
+    { continue; }
+    unseen++;
+    if (print)
+    {
+      report("soak golden unseen");
+      for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+      {
+        report(" |");
+        report(goldenFrames[i][row] ? goldenFrames[i][row] : "");
+        report("|");
+      }
+      report("\r\n");
+    }
+  }
+  return unseen;
+}
+
+/**
+ * @brief  Start the run over from another seed, before Game_Init. Runs
+ *         without it use SOAK_SEED.
+ * @param  seed: Seed of the bot, 0 for SOAK_SEED.
+ */
+void Soak_Init(uint32_t seed)
+{
+  memset(&bot, 0, sizeof(bot));
+  memset(&stats, 0, sizeof(stats));
+#ifdef SIMON_REPLAY
+  memset(&replay, 0, sizeof(replay));
+#endif
+  bot.rng = seed ? seed : SOAK_SEED;
+  bot.runSeed = bot.rng;
+}
+
+/**
+ * @brief  Statistics of the run so far.
+ */
+const SoakStats* Soak_Stats(void)
+{
+  return &stats;
+}
+
+/**
+ * @brief  Let the bot act once its reaction time is over, otherwise move
+ *         virtual time forward by one wheel tick.
+ * @param  game: Pointer to the Game structure.
+ */
+void Soak_Idle(Game* game)
+{
+  checkInvariants(game);
+  checkFrame(game);
+
+  if (nextInput(game))
+  { return; }
+
+  if (bot.wait > 0)
+  { bot.wait--; }
+#ifdef SIMON_HOST
+  __WFI();
+#else
+  SWTimer_Tick();
+#endif
+}
+
+/**
+ * @brief  Record the event type dispatched in the current state.
+ * @param  game: Pointer to the Game structure.
+ * @param  type: GameEventType being dispatched.
+ */
+void Soak_OnDispatch(Game* game, uint8_t type)
+{
+  stats.events[game->state] |= 1u << type;
+}
+
+/**
+ * @brief  Check a state change, plan the next game and keep the statistics.
+ * @param  game: Pointer to the Game structure.
+ * @param  from: Leaf state being left, GAME_STATE_COUNT on the first call.
+ * @param  to: Leaf state being entered.
+ */
+void Soak_OnTransition(Game* game, uint8_t from, uint8_t to)
+{
+  if (from == GAME_STATE_COUNT)
+  {
+    if (bot.wallStart == 0)
+    {
+      char msg[32];
+      bot.wallStart = WALL_MS();
+      snprintf(msg, sizeof(msg), "soak seed=%lu\r\n", (unsigned long)bot.runSeed);
+      report(msg);
+    }
+#ifdef SIMON_REPLAY
+    // Trace deltas count from Game_Init
+    replay.at = SWTimer_Now() + replayTrace[0].delta;
+#endif
+  }
+  else
+  {
+    if (!(allowedTransitions[from] & STATE_BIT(to)))
+    { violation(game, "illegal transition"); }
+    stats.transitions[from] |= STATE_BIT(to);
+  }
+
+  switch (to)
+  {
+    case START:
+    case PLAY_AGAIN:
+      bot.idleMenu = (botRandom() % 64) == 0;
+      break;
+
+    case PLAYER_SELECT:
+      bot.numPlayers = 1 + botRandom() % PLAYERS_MAX;
+      // Round 0 never comes, so a perfect game runs up to SEQUENCE_MAX
+      bot.failRound = (botRandom() % SOAK_PERFECT_GAMES == 0) ? 0 : 1 + botRandom() % SOAK_MAX_ROUND;
+      bot.failIndex = botRandom();
+      bot.flagged = 0;
+      break;
+
+    case ONE_PLAYER:
+    case MULTI_PLAYER:
+      memset(bot.lastScores, 0, sizeof(bot.lastScores));
+      if (FUZZ_INPUT)
+      {
+        // No bot seeds rand() from the menu, the games still replay from the seed
+        bot.seed = botRandom();
+        srand(bot.seed);
+      }
+      break;
+
+    case GAME_RESULT:
+      stats.played++;
+      stats.roundsPlayed += game->info.round;
+      if (stats.played % SOAK_REPORT_GAMES == 0)
+      { reportProgress(); }
+      recordGame(game);
+      break;
+
+    default:
+      break;
+  }
+}
+
+#endif
@@ -22,6 +22,15 @@
 #include "stm32wbxx_it.h"
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#ifdef LCD_I2C
+#include "i2c.h"
+#endif
+#if defined(LINK_UART) || defined(CONSOLE_UART) || defined(TELEMETRY_UART)
+#include "usart.h"
+#endif
+#include "cycles.h"
+#include "cpuload.h"
+#include "flashstore.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -69,7 +78,9 @@ extern TIM_HandleTypeDef htim2;
 void NMI_Handler(void)
 {
   /* USER CODE BEGIN NonMaskableInt_IRQn 0 */
-
+  // Reading a store record torn by a reset, Store_Init skips it
+  if (__HAL_FLASH_GET_FLAG(FLASH_FLAG_ECCD) && Store_EccError())
+  { return; }
   /* USER CODE END NonMaskableInt_IRQn 0 */
   /* USER CODE BEGIN NonMaskableInt_IRQn 1 */
    while (1)
@@ -183,11 +194,11 @@ void PendSV_Handler(void)
 void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
-
+  uint32_t start = Cycles_Now();
   /* USER CODE END SysTick_IRQn 0 */
   HAL_IncTick();
   /* USER CODE BEGIN SysTick_IRQn 1 */
-
+  CpuLoad_Isr(CPULOAD_SYSTICK, start);
   /* USER CODE END SysTick_IRQn 1 */
 }
 
@@ -204,14 +215,121 @@ void SysTick_Handler(void)
 void TIM2_IRQHandler(void)
 {
   /* USER CODE BEGIN TIM2_IRQn 0 */
-
+  uint32_t start = Cycles_Now();
   /* USER CODE END TIM2_IRQn 0 */
   HAL_TIM_IRQHandler(&htim2);
   /* USER CODE BEGIN TIM2_IRQn 1 */
-
+  CpuLoad_Isr(CPULOAD_TIM2, start);
   /* USER CODE END TIM2_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
+#ifdef LCD_I2C
+/**
+  * @brief This function handles DMA1 channel1 global interrupt, the LCD backpack transfers.
+  */
+void DMA1_Channel1_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_DMA_IRQHandler(&hdma_i2c1_tx);
+  CpuLoad_Isr(CPULOAD_I2C, start);
+}
+
+/**
+  * @brief This function handles I2C1 event interrupt.
+  */
+void I2C1_EV_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_I2C_EV_IRQHandler(&hi2c1);
+  CpuLoad_Isr(CPULOAD_I2C, start);
+}
+
+/**
+  * @brief This function handles I2C1 error interrupt.
+  */
+void I2C1_ER_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_I2C_ER_IRQHandler(&hi2c1);
+  CpuLoad_Isr(CPULOAD_I2C, start);
+}
+#endif
+
+#ifdef LINK_UART
+/**
+  * @brief This function handles DMA1 channel2 global interrupt, the link reception.
+  */
+void DMA1_Channel2_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_DMA_IRQHandler(&hdma_lpuart1_rx);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+
+/**
+  * @brief This function handles DMA1 channel3 global interrupt, the link transmission.
+  */
+void DMA1_Channel3_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_DMA_IRQHandler(&hdma_lpuart1_tx);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+
+/**
+  * @brief This function handles LPUART1 global interrupt, the idle line ending a burst.
+  */
+void LPUART1_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_UART_IRQHandler(&hlpuart1);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+#endif
+
+#ifdef CONSOLE_UART
+/**
+  * @brief This function handles DMA1 channel4 global interrupt, the console reception.
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
 
+  HAL_DMA_IRQHandler(&hdma_usart1_rx);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+#endif
+
+#ifdef USART1_DMA_TX
+
+/**
+  * @brief This function handles DMA1 channel5 global interrupt, the console and telemetry output.
+  */
+void DMA1_Channel5_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_DMA_IRQHandler(&hdma_usart1_tx);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+
+/**
+  * @brief This function handles USART1 global interrupt, the idle line ending a command
+  *        and the end of a transfer.
+  */
+void USART1_IRQHandler(void)
+{
+  uint32_t start = Cycles_Now();
+
+  HAL_UART_IRQHandler(&huart1);
+  CpuLoad_Isr(CPULOAD_UART, start);
+}
+#endif
 /* USER CODE END 1 */
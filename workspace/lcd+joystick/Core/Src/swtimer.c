@@ -0,0 +1,196 @@
+/*
+ * Hierarchical timer wheel driven by the TIM2 period elapsed interrupt.
+ *
+ * Each level holds 64 slots. Level 0 slots are one tick wide, level 1 slots
+ * are 64 ticks wide and so on. A timer is linked into the slot matching its
+ * expiry time, so starting or stopping a timer is O(1) regardless of how many
+ * timers are armed. When level 0 wraps, the next slot of level 1 is cascaded
+ * down, which keeps the per tick cost independent of the number of timers.
+ */
+
+#include "swtimer.h"
+#include "main.h"
+#include "board.h"
+
+#define SWTIMER_LEVEL_MASK  (SWTIMER_LEVEL_SLOTS - 1)
+#define SWTIMER_MAX_TICKS   ((1u << (SWTIMER_LEVEL_BITS * SWTIMER_LEVELS)) - 1)
+
+static BOARD_STATE SWTimer *wheel[SWTIMER_LEVELS][SWTIMER_LEVEL_SLOTS];
+static BOARD_STATE volatile uint32_t now = 0;
+
+/**
+ * @brief  Link a timer into the slot matching its expiry time.
+ *         Interrupts must be disabled by the caller.
+ * @param  timer: Pointer to the timer to link.
+ */
+static void wheelLink(SWTimer *timer)
+{
+  uint32_t delta = timer->expires - now;
+  int level = 0;
+
+  if (delta > SWTIMER_MAX_TICKS)
+  {
+    delta = SWTIMER_MAX_TICKS;
+    timer->expires = now + delta;
+  }
+
+  while (delta >= SWTIMER_LEVEL_SLOTS)
+  {
+    delta >>= SWTIMER_LEVEL_BITS;
+    level++;
+  }
+
+  SWTimer **head = &wheel[level][(timer->expires >> (SWTIMER_LEVEL_BITS * level)) & SWTIMER_LEVEL_MASK];
+  timer->next = *head;
+  if (timer->next)
+  { timer->next->pprev = &timer->next; }
+  timer->pprev = head;
+  *head = timer;
+}
+
+/**
+ * @brief  Remove a timer from whichever slot it is linked in.
+ *         Interrupts must be disabled by the caller.
+ * @param  timer: Pointer to the timer to unlink.
+ */
+static void wheelUnlink(SWTimer *timer)
+{
+  *timer->pprev = timer->next;
+  if (timer->next)
+  { timer->next->pprev = timer->pprev; }
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+/**
+ * @brief  Move every timer of a higher level slot down to the lower levels.
+ * @param  level: Wheel level to cascade.
+ * @param  slot: Slot index within the level.
+ */
+static void cascade(int level, uint32_t slot)
+{
+  SWTimer *timer = wheel[level][slot];
+  wheel[level][slot] = NULL;
+
+  while (timer)
+  {
+    SWTimer *next = timer->next;
+    wheelLink(timer);
+    timer = next;
+  }
+}
+
+/**
+ * @brief  Convert a duration in milliseconds to wheel ticks, rounding up.
+ * @param  ms: Duration in milliseconds.
+ * @return Number of ticks, at least 1.
+ */
+static uint32_t msToTicks(uint32_t ms)
+{
+  uint32_t ticks = (ms + SWTIMER_TICK_MS - 1) / SWTIMER_TICK_MS;
+  return ticks ? ticks : 1;
+}
+
+/**
+ * @brief  Reset the wheel and drop every armed timer.
+ */
+void SWTimer_Init(void)
+{
+  for (int level = 0; level < SWTIMER_LEVELS; level++)
+  {
+    for (uint32_t slot = 0; slot < SWTIMER_LEVEL_SLOTS; slot++)
+    { wheel[level][slot] = NULL; }
+  }
+  now = 0;
+}
+
+/**
+ * @brief  Advance the wheel by one tick and run the callbacks of every
+ *         timer that expires on this tick. Called from the TIM2 ISR.
+ */
+void SWTimer_Tick(void)
+{
+  uint32_t t = ++now;
+
+  // Cascade the higher levels each time the level below wraps around
+  for (int level = 1; level < SWTIMER_LEVELS && (t & SWTIMER_LEVEL_MASK) == 0; level++)
+  {
+    t >>= SWTIMER_LEVEL_BITS;
+    cascade(level, t & SWTIMER_LEVEL_MASK);
+  }
+
+  SWTimer **head = &wheel[0][now & SWTIMER_LEVEL_MASK];
+  while (*head)
+  {
+    SWTimer *timer = *head;
+    wheelUnlink(timer);
+
+    if (timer->period)
+    {
+      timer->expires += timer->period;
+      wheelLink(timer);
+    }
+
+    timer->callback(timer->arg);
+  }
+}
+
+/**
+ * @brief  Arm a timer. A running timer is restarted with the new settings.
+ * @param  timer: Pointer to a caller owned timer.
+ * @param  delayMs: Time until the first expiry in milliseconds.
+ * @param  periodMs: Reload interval in milliseconds, 0 for a one-shot timer.
+ * @param  callback: Function called on expiry, runs in interrupt context.
+ * @param  arg: Argument passed to the callback.
+ */
+void SWTimer_Start(SWTimer *timer, uint32_t delayMs, uint32_t periodMs,
+                   SWTimer_Callback callback, void *arg)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (timer->pprev)
+  { wheelUnlink(timer); }
+
+  timer->callback = callback;
+  timer->arg = arg;
+  timer->period = periodMs ? msToTicks(periodMs) : 0;
+  timer->expires = now + msToTicks(delayMs);
+  wheelLink(timer);
+
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Disarm a timer. Does nothing if the timer is not running.
+ * @param  timer: Pointer to the timer to stop.
+ */
+void SWTimer_Stop(SWTimer *timer)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+
+  if (timer->pprev)
+  { wheelUnlink(timer); }
+
+  __set_PRIMASK(primask);
+}
+
+/**
+ * @brief  Check if a timer is armed.
+ * @param  timer: Pointer to the timer.
+ * @return 1 if the timer will fire, 0 otherwise.
+ */
+uint8_t SWTimer_IsRunning(const SWTimer *timer)
+{
+  return timer->pprev != NULL;
+}
+
+/**
+ * @brief  Current wheel time.
+ * @return Number of ticks since SWTimer_Init.
+ */
+uint32_t SWTimer_Now(void)
+{
+  return now;
+}
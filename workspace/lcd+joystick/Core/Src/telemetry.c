@@ -0,0 +1,154 @@
+/*
+ * Telemetry stream. Every TELEMETRY_PERIOD_MS the main loop takes a
+ * snapshot of the game and sends the fields that differ from the last
+ * snapshot sent, through the transmit DMA of USART1. A quiet game costs
+ * the CPU load once a second, a few bytes of the 960 a second the 9600
+ * baud line carries.
+ */
+
+#include "telemetry.h"
+
+#ifdef TELEMETRY_UART
+
+#include "usart.h"
+#include "crc8.h"
+#include "cpuload.h"
+#include "cycles.h"
+#include <string.h>
+
+#define FIXED_FIELDS  TELEMETRY_SCORES     // fields before the scores
+#define FRAME_MAX     (TELEMETRY_HEADER + 8 + 17 * 2 + 1 + 2 * PLAYERS_MAX + 1)
+
+typedef struct
+{
+  uint16_t values[FIXED_FIELDS];
+  uint8_t players;
+  uint16_t scores[PLAYERS_MAX];
+} Snapshot;
+
+// Bytes of each field before the scores
+static const uint8_t fieldSizes[FIXED_FIELDS] = {1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+                                                 2, 2, 2, 2, 2, 2, 2};
+
+static Snapshot sent;             // last snapshot on the wire
+static uint32_t sentAt, keyAt;
+static uint8_t started;           // a keyframe went out
+static uint8_t seq;
+
+/**
+ * @brief  Microseconds of a number of cycles, saturated to a 2 byte field.
+ */
+static uint16_t fieldUs(uint32_t cycles)
+{
+  uint32_t us = Cycles_ToNs(cycles) / 1000;
+  return (us < 0xFFFF) ? us : 0xFFFF;
+}
+
+/**
+ * @brief  Read the fields of the game and of the firmware around it.
+ * @param  game: Pointer to the Game structure.
+ * @param  snapshot: Filled with the values.
+ */
+static void takeSnapshot(const Game* game, Snapshot* snapshot)
+{
+  const GameInfo* info = &game->info;
+  const CpuLoadStats* load = CpuLoad_Stats();
+  uint32_t overBudget = 0;
+
+  memset(snapshot, 0, sizeof(*snapshot));
+  snapshot->values[TELEMETRY_STATE] = game->state;
+  snapshot->values[TELEMETRY_ROUND] = info->round;
+  snapshot->values[TELEMETRY_LENGTH] = info->sequenceLength;
+  snapshot->values[TELEMETRY_PLAYERS] = info->numPlayers;
+  snapshot->values[TELEMETRY_PLAYER] = info->currentPlayer;
+  snapshot->values[TELEMETRY_LEFT] = info->playersLeft;
+  snapshot->values[TELEMETRY_QUEUE] = EventQueue_Count(&game->events);
+  snapshot->values[TELEMETRY_QUEUE_PEAK] = game->events.peak;
+  snapshot->values[TELEMETRY_DROPPED] = game->events.dropped;
+  snapshot->values[TELEMETRY_TX_QUEUED] = USART1_TX_SIZE - USART1_TxFree();
+  snapshot->values[TELEMETRY_LATENCY] = game->latencyUs;
+  snapshot->values[TELEMETRY_LATENCY_MAX] = game->latencyMaxUs;
+  snapshot->values[TELEMETRY_LOAD] = load->load;
+  snapshot->values[TELEMETRY_LOAD_10S] = load->load10s;
+  for (uint8_t isr = 0; isr < CPULOAD_ISRS; isr++)
+  {
+    const CpuLoadIsrStats* timing = CpuLoad_IsrStats(isr);
+    snapshot->values[TELEMETRY_ISR_TIM2 + isr] = load->isr[isr];
+    snapshot->values[TELEMETRY_MAX_TIM2 + isr] = fieldUs(timing->maxCycles);
+    overBudget += timing->violations;
+  }
+  snapshot->values[TELEMETRY_JITTER_TIM2] = fieldUs(CpuLoad_IsrStats(CPULOAD_TIM2)->jitterCycles);
+  snapshot->values[TELEMETRY_JITTER_SYSTICK] = fieldUs(CpuLoad_IsrStats(CPULOAD_SYSTICK)->jitterCycles);
+  snapshot->values[TELEMETRY_OVER_BUDGET] = (overBudget < 0xFFFF) ? overBudget : 0xFFFF;
+  snapshot->players = (info->numPlayers <= PLAYERS_MAX) ? info->numPlayers : PLAYERS_MAX;
+  memcpy(snapshot->scores, info->playerScores, snapshot->players * sizeof(uint16_t));
+}
+
+/**
+ * @brief  Send the fields that changed since the last frame, or all of them
+ *         when a keyframe is due, at most once per TELEMETRY_PERIOD_MS.
+ * @param  game: Pointer to the Game structure.
+ */
+void Telemetry_Poll(const Game* game)
+{
+  uint32_t now = HAL_GetTick();
+  uint8_t frame[FRAME_MAX];
+  uint8_t length = TELEMETRY_HEADER;
+  uint32_t mask = 0;
+  uint8_t keyframe;
+  Snapshot snapshot;
+
+  // Nothing else polls the transmit DMA of a build without the console
+  USART1_Kick();
+  if (started && now - sentAt < TELEMETRY_PERIOD_MS)
+  { return; }
+  sentAt = now;
+  keyframe = !started || now - keyAt >= TELEMETRY_KEYFRAME_MS;
+
+  takeSnapshot(game, &snapshot);
+  for (uint8_t field = 0; field < FIXED_FIELDS; field++)
+  {
+    if (keyframe || snapshot.values[field] != sent.values[field])
+    {
+      mask |= 1u << field;
+      frame[length++] = (uint8_t)snapshot.values[field];
+      if (fieldSizes[field] == 2)
+      { frame[length++] = (uint8_t)(snapshot.values[field] >> 8); }
+    }
+  }
+  if (keyframe || snapshot.players != sent.players ||
+      memcmp(snapshot.scores, sent.scores, sizeof(snapshot.scores)) != 0)
+  {
+    mask |= 1u << TELEMETRY_SCORES;
+    frame[length++] = snapshot.players;
+    for (uint8_t player = 0; player < snapshot.players; player++)
+    {
+      frame[length++] = (uint8_t)snapshot.scores[player];
+      frame[length++] = (uint8_t)(snapshot.scores[player] >> 8);
+    }
+  }
+  if (!mask)
+  { return; }   // nothing changed, the line stays free
+
+  frame[0] = TELEMETRY_SOF;
+  frame[1] = length - 2;
+  frame[2] = seq;
+  frame[3] = (uint8_t)mask;
+  frame[4] = (uint8_t)(mask >> 8);
+  frame[5] = (uint8_t)(mask >> 16);
+  frame[6] = (uint8_t)(mask >> 24);
+  frame[length] = Crc8(&frame[1], length - 1);
+
+  // A full queue skips the period, the next frame carries the changes
+  if (!USART1_Send(frame, length + 1))
+  { return; }
+  sent = snapshot;
+  seq++;
+  if (keyframe)
+  {
+    keyAt = now;
+    started = 1;
+  }
+}
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * Input trace recorder, built with make -f STM32Make.make VARIANT=TRACE.
+ *
+ * Every input event the state machine dispatches is appended to a RAM ring
+ * with the number of wheel ticks since the previous one, and so is the seed
+ * the one player game feeds to rand(). That is all the game depends on: the
+ * timers, tones and screens follow from the inputs and the tick they arrive
+ * in. The ring is sent on USART1 when a game ends, one "trace" line per
+ * TRACE_LINE_RECORDS records.
+ *
+ * tools/trace2h.py turns the captured lines into Core/Inc/replaytrace.h,
+ * which the VARIANT=REPLAY soak build plays back on virtual time.
+ */
+
+#include "trace.h"
+
+#ifdef SIMON_TRACE
+
+#include "swtimer.h"
+#include "usart.h"
+#include "board.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef struct
+{
+  TraceRecord records[TRACE_RECORDS];
+  uint16_t head;      // next record to write
+  uint16_t tail;      // oldest record not sent yet
+  uint16_t count;     // records not sent yet
+  uint32_t last;      // wheel tick of the previous record
+  uint32_t dropped;   // records lost to a full ring since the last flush
+} TraceRing;
+
+static BOARD_STATE TraceRing trace;
+
+/**
+ * @brief  Append one record, dropping it if the ring is full so that the
+ *         records already taken still replay from the start.
+ * @param  delta: Wheel ticks since the previous record.
+ * @param  value: TRACE_VALUE of the record.
+ */
+static void put(uint16_t delta, uint16_t value)
+{
+  if (trace.count == TRACE_RECORDS)
+  {
+    trace.dropped++;
+    return;
+  }
+
+  trace.records[trace.head].delta = delta;
+  trace.records[trace.head].value = value;
+  trace.head = (trace.head + 1) % TRACE_RECORDS;
+  trace.count++;
+}
+
+/**
+ * @brief  Empty the ring and take the current wheel tick as time base.
+ */
+void Trace_Start(void)
+{
+  memset(&trace, 0, sizeof(trace));
+  trace.last = SWTimer_Now();
+}
+
+/**
+ * @brief  Append an input event, stamped with the current wheel tick.
+ * @param  type: GameEventType of the input, or TRACE_SEED.
+ * @param  param: Event parameter or seed, 12 bits.
+ */
+void Trace_Input(uint8_t type, uint16_t param)
+{
+  uint32_t now = SWTimer_Now();
+  uint32_t delta = now - trace.last;
+
+  trace.last = now;
+  while (delta > UINT16_MAX)
+  {
+    put(UINT16_MAX, TRACE_VALUE(TRACE_WAIT, 0));
+    delta -= UINT16_MAX;
+  }
+  put(delta, TRACE_VALUE(type, param));
+}
+
+/**
+ * @brief  Send the records not sent yet on USART1. Blocks for about 10 ms
+ *         per record at 9600 baud.
+ */
+void Trace_Flush(void)
+{
+  char line[8 + TRACE_LINE_RECORDS * 9 + 3];
+
+  while (trace.count > 0)
+  {
+    int len = snprintf(line, sizeof(line), "trace");
+    for (uint8_t i = 0; i < TRACE_LINE_RECORDS && trace.count > 0; i++)
+    {
+      const TraceRecord* record = &trace.records[trace.tail];
+      len += snprintf(line + len, sizeof(line) - len, " %04x%04x", record->delta, record->value);
+      trace.tail = (trace.tail + 1) % TRACE_RECORDS;
+      trace.count--;
+    }
+    len += snprintf(line + len, sizeof(line) - len, "\r\n");
+    HAL_UART_Transmit(&huart1, (uint8_t*)line, len, 1000);
+  }
+
+  if (trace.dropped)
+  {
+    snprintf(line, sizeof(line), "trace dropped=%lu\r\n", (unsigned long)trace.dropped);
+    HAL_UART_Transmit(&huart1, (uint8_t*)line, strlen(line), 1000);
+    trace.dropped = 0;
+  }
+}
+
+#endif
@@ -21,10 +21,84 @@
 #include "usart.h"
 
 /* USER CODE BEGIN 0 */
+// LPUART1 is only built with make -f STM32Make.make LINK=UART, for the link
+// to the other boards on PB5 (TX) and PB10 (RX). CONSOLE=UART adds the
+// receive DMA of USART1 for the command console, CONSOLE=UART and
+// TELEMETRY=UART its transmit DMA.
+#include "link.h"
+#include "console.h"
 
+#ifdef USART1_DMA_TX
+static uint8_t usart1TxBuffer[USART1_TX_SIZE];
+static volatile uint16_t usart1TxIn;        // bytes queued since reset
+static volatile uint16_t usart1TxOut;       // bytes the DMA finished
+static volatile uint16_t usart1TxSending;   // bytes of the transfer in progress
+#endif
 /* USER CODE END 0 */
 
 UART_HandleTypeDef huart1;
+#ifdef CONSOLE_UART
+DMA_HandleTypeDef hdma_usart1_rx;
+#endif
+#ifdef USART1_DMA_TX
+DMA_HandleTypeDef hdma_usart1_tx;
+#endif
+#ifdef LINK_UART
+UART_HandleTypeDef hlpuart1;
+DMA_HandleTypeDef hdma_lpuart1_rx;
+DMA_HandleTypeDef hdma_lpuart1_tx;
+
+/* LPUART1 init function */
+
+void MX_LPUART1_UART_Init(void)
+{
+
+  /* USER CODE BEGIN LPUART1_Init 0 */
+  // DMA controller clock enable, the channels are linked in HAL_UART_MspInit
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+  /* USER CODE END LPUART1_Init 0 */
+
+  /* USER CODE BEGIN LPUART1_Init 1 */
+
+  /* USER CODE END LPUART1_Init 1 */
+  hlpuart1.Instance = LPUART1;
+  hlpuart1.Init.BaudRate = 115200;
+  hlpuart1.Init.WordLength = UART_WORDLENGTH_8B;
+  hlpuart1.Init.StopBits = UART_STOPBITS_1;
+  hlpuart1.Init.Parity = UART_PARITY_NONE;
+  hlpuart1.Init.Mode = UART_MODE_TX_RX;
+  hlpuart1.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+  hlpuart1.Init.OneBitSampling = UART_ONE_BIT_SAMPLE_DISABLE;
+  hlpuart1.Init.ClockPrescaler = UART_PRESCALER_DIV1;
+  hlpuart1.AdvancedInit.AdvFeatureInit = UART_ADVFEATURE_NO_INIT;
+  hlpuart1.FifoMode = UART_FIFOMODE_DISABLE;
+  if (HAL_UART_Init(&hlpuart1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_UARTEx_SetTxFifoThreshold(&hlpuart1, UART_TXFIFO_THRESHOLD_1_8) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_UARTEx_SetRxFifoThreshold(&hlpuart1, UART_RXFIFO_THRESHOLD_1_8) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  if (HAL_UARTEx_DisableFifoMode(&hlpuart1) != HAL_OK)
+  {
+    Error_Handler();
+  }
+  /* USER CODE BEGIN LPUART1_Init 2 */
+
+  /* USER CODE END LPUART1_Init 2 */
+
+}
+#endif
 
 /* USART1 init function */
 
@@ -32,7 +106,17 @@ void MX_USART1_UART_Init(void)
 {
 
   /* USER CODE BEGIN USART1_Init 0 */
-
+#ifdef USART1_DMA_TX
+  // DMA controller clock enable, the channels are linked in HAL_UART_MspInit
+  __HAL_RCC_DMAMUX1_CLK_ENABLE();
+  __HAL_RCC_DMA1_CLK_ENABLE();
+  HAL_NVIC_SetPriority(DMA1_Channel5_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel5_IRQn);
+#endif
+#ifdef CONSOLE_UART
+  HAL_NVIC_SetPriority(DMA1_Channel4_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Channel4_IRQn);
+#endif
   /* USER CODE END USART1_Init 0 */
 
   /* USER CODE BEGIN USART1_Init 1 */
@@ -106,10 +190,126 @@ void HAL_UART_MspInit(UART_HandleTypeDef* uartHandle)
     GPIO_InitStruct.Alternate = GPIO_AF7_USART1;
     HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
 
+#ifdef CONSOLE_UART
+    /* USART1 DMA Init */
+    /* USART1_RX Init */
+    hdma_usart1_rx.Instance = DMA1_Channel4;
+    hdma_usart1_rx.Init.Request = DMA_REQUEST_USART1_RX;
+    hdma_usart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart1_rx.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_usart1_rx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(uartHandle,hdmarx,hdma_usart1_rx);
+#endif
+
+#ifdef USART1_DMA_TX
+    /* USART1_TX Init */
+    hdma_usart1_tx.Instance = DMA1_Channel5;
+    hdma_usart1_tx.Init.Request = DMA_REQUEST_USART1_TX;
+    hdma_usart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart1_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(uartHandle,hdmatx,hdma_usart1_tx);
+
+    /* USART1 interrupt Init */
+    HAL_NVIC_SetPriority(USART1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+#endif
   /* USER CODE BEGIN USART1_MspInit 1 */
 
   /* USER CODE END USART1_MspInit 1 */
   }
+#ifdef LINK_UART
+  else if(uartHandle->Instance==LPUART1)
+  {
+  /* USER CODE BEGIN LPUART1_MspInit 0 */
+
+  /* USER CODE END LPUART1_MspInit 0 */
+
+  /** Initializes the peripherals clock
+  */
+    PeriphClkInitStruct.PeriphClockSelection = RCC_PERIPHCLK_LPUART1;
+    PeriphClkInitStruct.Lpuart1ClockSelection = RCC_LPUART1CLKSOURCE_PCLK1;
+    if (HAL_RCCEx_PeriphCLKConfig(&PeriphClkInitStruct) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    /* LPUART1 clock enable */
+    __HAL_RCC_LPUART1_CLK_ENABLE();
+
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    /**LPUART1 GPIO Configuration
+    PB5     ------> LPUART1_TX
+    PB10     ------> LPUART1_RX
+    */
+    GPIO_InitStruct.Pin = GPIO_PIN_5|GPIO_PIN_10;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
+    GPIO_InitStruct.Alternate = GPIO_AF8_LPUART1;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    /* LPUART1 DMA Init */
+    /* LPUART1_RX Init */
+    hdma_lpuart1_rx.Instance = DMA1_Channel2;
+    hdma_lpuart1_rx.Init.Request = DMA_REQUEST_LPUART1_RX;
+    hdma_lpuart1_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_lpuart1_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_lpuart1_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_lpuart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_lpuart1_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_lpuart1_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_lpuart1_rx.Init.Priority = DMA_PRIORITY_HIGH;
+    if (HAL_DMA_Init(&hdma_lpuart1_rx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(uartHandle,hdmarx,hdma_lpuart1_rx);
+
+    /* LPUART1_TX Init */
+    hdma_lpuart1_tx.Instance = DMA1_Channel3;
+    hdma_lpuart1_tx.Init.Request = DMA_REQUEST_LPUART1_TX;
+    hdma_lpuart1_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_lpuart1_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_lpuart1_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_lpuart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_lpuart1_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_lpuart1_tx.Init.Mode = DMA_NORMAL;
+    hdma_lpuart1_tx.Init.Priority = DMA_PRIORITY_LOW;
+    if (HAL_DMA_Init(&hdma_lpuart1_tx) != HAL_OK)
+    {
+      Error_Handler();
+    }
+
+    __HAL_LINKDMA(uartHandle,hdmatx,hdma_lpuart1_tx);
+
+    /* LPUART1 interrupt Init */
+    HAL_NVIC_SetPriority(LPUART1_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(LPUART1_IRQn);
+  /* USER CODE BEGIN LPUART1_MspInit 1 */
+
+  /* USER CODE END LPUART1_MspInit 1 */
+  }
+#endif
 }
 
 void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
@@ -129,12 +329,158 @@ void HAL_UART_MspDeInit(UART_HandleTypeDef* uartHandle)
     */
     HAL_GPIO_DeInit(GPIOB, STLINK_RX_Pin|STLINK_TX_Pin);
 
+#ifdef USART1_DMA_TX
+    /* USART1 DMA DeInit */
+#ifdef CONSOLE_UART
+    HAL_DMA_DeInit(uartHandle->hdmarx);
+#endif
+    HAL_DMA_DeInit(uartHandle->hdmatx);
+
+    /* USART1 interrupt Deinit */
+    HAL_NVIC_DisableIRQ(USART1_IRQn);
+#endif
   /* USER CODE BEGIN USART1_MspDeInit 1 */
 
   /* USER CODE END USART1_MspDeInit 1 */
   }
+#ifdef LINK_UART
+  else if(uartHandle->Instance==LPUART1)
+  {
+  /* USER CODE BEGIN LPUART1_MspDeInit 0 */
+
+  /* USER CODE END LPUART1_MspDeInit 0 */
+    /* Peripheral clock disable */
+    __HAL_RCC_LPUART1_CLK_DISABLE();
+
+    /**LPUART1 GPIO Configuration
+    PB5     ------> LPUART1_TX
+    PB10     ------> LPUART1_RX
+    */
+    HAL_GPIO_DeInit(GPIOB, GPIO_PIN_5|GPIO_PIN_10);
+
+    /* LPUART1 DMA DeInit */
+    HAL_DMA_DeInit(uartHandle->hdmarx);
+    HAL_DMA_DeInit(uartHandle->hdmatx);
+
+    /* LPUART1 interrupt Deinit */
+    HAL_NVIC_DisableIRQ(LPUART1_IRQn);
+  /* USER CODE BEGIN LPUART1_MspDeInit 1 */
+
+  /* USER CODE END LPUART1_MspDeInit 1 */
+  }
+#endif
 }
 
 /* USER CODE BEGIN 1 */
+#ifdef USART1_DMA_TX
+/**
+ * @brief  Start the DMA on the bytes queued if it is idle. Runs in the
+ *         transfer complete interrupt and with interrupts masked.
+ */
+static void usart1Kick(void)
+{
+  uint16_t pending = usart1TxIn - usart1TxOut;
+  uint16_t start = usart1TxOut % USART1_TX_SIZE;
+
+  if (usart1TxSending || pending == 0)
+  { return; }
 
+  usart1TxSending = (pending < USART1_TX_SIZE - start) ? pending : USART1_TX_SIZE - start;
+  if (HAL_UART_Transmit_DMA(&huart1, &usart1TxBuffer[start], usart1TxSending) != HAL_OK)
+  { usart1TxSending = 0; }   // the port is busy, the next USART1_Kick tries again
+}
+
+/**
+ * @brief  Queue bytes for the transmit DMA of USART1. Main loop only.
+ * @param  data: Bytes to send.
+ * @param  length: Number of bytes.
+ * @return 1 if they were queued, 0 if they do not fit.
+ */
+uint8_t USART1_Send(const void* data, uint16_t length)
+{
+  const uint8_t* bytes = data;
+
+  if (USART1_TxFree() < length)
+  { return 0; }
+  for (uint16_t i = 0; i < length; i++)
+  { usart1TxBuffer[(usart1TxIn + i) % USART1_TX_SIZE] = bytes[i]; }
+  usart1TxIn += length;
+  USART1_Kick();
+  return 1;
+}
+
+/**
+ * @brief  Room left in the transmit queue of USART1.
+ */
+uint16_t USART1_TxFree(void)
+{
+  return USART1_TX_SIZE - (uint16_t)(usart1TxIn - usart1TxOut);
+}
+
+/**
+ * @brief  Start the DMA on the bytes queued if it is idle.
+ */
+void USART1_Kick(void)
+{
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+  usart1Kick();
+  __set_PRIMASK(primask);
+}
+#endif
+
+#if defined(LINK_UART) || defined(USART1_DMA_TX)
+// The DMA transfers of the link, the console and the telemetry end up
+// here, sorted by port
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef* huart)
+{
+#ifdef LINK_UART
+  if (huart->Instance == LPUART1)
+  { Link_TxDone(); }
+#endif
+#ifdef USART1_DMA_TX
+  if (huart->Instance == USART1)
+  {
+    usart1TxOut += usart1TxSending;
+    usart1TxSending = 0;
+    usart1Kick();
+  }
+#endif
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef* huart, uint16_t Size)
+{
+#ifdef LINK_UART
+  if (huart->Instance == LPUART1)
+  { Link_RxEvent(Size); }
+#endif
+#ifdef CONSOLE_UART
+  if (huart->Instance == USART1)
+  { Console_RxEvent(Size); }
+#endif
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef* huart)
+{
+#ifdef LINK_UART
+  if (huart->Instance == LPUART1)
+  { Link_RxError(); }
+#endif
+#ifdef CONSOLE_UART
+  if (huart->Instance == USART1)
+  { Console_RxError(); }
+#endif
+#ifdef USART1_DMA_TX
+  // A transmit DMA error stops the transfer and leaves the port ready. Its
+  // bytes are given up, or the ring would wait on them for good
+  if (huart->Instance == USART1 && usart1TxSending && huart->gState == HAL_UART_STATE_READY)
+  {
+    usart1TxOut += usart1TxSending;
+    usart1TxSending = 0;
+    usart1Kick();
+  }
+#endif
+}
+#endif
 /* USER CODE END 1 */
@@ -0,0 +1,268 @@
+/*
+ * Host batch runner: plays the soak on many simulated boards at once, one
+ * per thread, and merges their statistics.
+ *
+ *   build/batch [games] [seed] [threads]
+ *
+ * The games are split into boards of BATCH_BOARD_GAMES games each, board b
+ * playing from the soak seed seed + b, so a board is reproduced alone with
+ *
+ *   build/soak BATCH_BOARD_GAMES <seed + b>
+ *
+ * Every module of the game keeps its state thread-local on the host (see
+ * board.h), as does the simulated board, so a thread plays one board after
+ * the other, each from Sim_Reset and the init sequence of main.c. The
+ * boards are dealt out in equal runs to the threads, which take them from
+ * the front of their own run and, once it is empty, steal from the back of
+ * the others'. The merged report is the same for any number of threads.
+ *
+ * USART1 of a board goes to memory and is printed only if the board had
+ * violations. Exits with 1 if any board had one.
+ */
+
+#include "sim.h"
+#include "soak.h"
+#include "swtimer.h"
+#include "lcd1602.h"
+#include "cycles.h"
+#include "adc.h"
+#include "board.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BATCH_GAMES        100000   // games of a run without arguments
+#define BATCH_BOARD_GAMES  100      // games per board, the unit of work
+#define BATCH_THREADS_MAX  256
+
+typedef struct
+{
+  _Atomic uint64_t boards;   // next board to play in the low half, end of the run in the high half
+  pthread_t thread;
+  uint32_t played;           // boards this thread played
+} Worker;
+
+typedef struct
+{
+  SoakStats stats;
+  char* uart;                // USART1 of a board with violations, NULL otherwise
+} BoardResult;
+
+static Worker workers[BATCH_THREADS_MAX];
+static uint32_t threads;
+static uint32_t totalGames;
+static uint32_t baseSeed;
+static BoardResult* results;
+
+static BOARD_STATE Game play;
+
+/**
+ * @brief  TIM2 update handler, HAL_TIM_PeriodElapsedCallback of main.c.
+ */
+static void tim2Update(void)
+{
+  SWTimer_Tick();
+  Game_Tick(&play);
+}
+
+/**
+ * @brief  Take the first board of a run, for its owner.
+ * @param  worker: Worker owning the run.
+ * @param  board: Set to the board taken.
+ * @return 1 if a board was taken, 0 if the run is empty.
+ */
+static uint8_t takeFront(Worker* worker, uint32_t* board)
+{
+  uint64_t boards = atomic_load(&worker->boards);
+  uint32_t next, end;
+
+  do
+  {
+    next = (uint32_t)boards;
+    end = (uint32_t)(boards >> 32);
+    if (next >= end)
+    { return 0; }
+  } while (!atomic_compare_exchange_weak(&worker->boards, &boards, ((uint64_t)end << 32) | (next + 1)));
+  *board = next;
+  return 1;
+}
+
+/**
+ * @brief  Take the last board of a run, for another worker.
+ * @param  worker: Worker owning the run.
+ * @param  board: Set to the board taken.
+ * @return 1 if a board was taken, 0 if the run is empty.
+ */
+static uint8_t stealBack(Worker* worker, uint32_t* board)
+{
+  uint64_t boards = atomic_load(&worker->boards);
+  uint32_t next, end;
+
+  do
+  {
+    next = (uint32_t)boards;
+    end = (uint32_t)(boards >> 32);
+    if (next >= end)
+    { return 0; }
+  } while (!atomic_compare_exchange_weak(&worker->boards, &boards, ((uint64_t)(end - 1) << 32) | next));
+  *board = end - 1;
+  return 1;
+}
+
+/**
+ * @brief  Play one board from power on, as main.c sets it up.
+ * @param  board: Board number.
+ */
+static void playBoard(uint32_t board)
+{
+  uint32_t first = board * BATCH_BOARD_GAMES;
+  uint32_t games = (totalGames - first < BATCH_BOARD_GAMES) ? totalGames - first : BATCH_BOARD_GAMES;
+  Joystick_HandleTypeDef joystick;
+  char* uart = NULL;
+  size_t length = 0;
+  FILE* out = open_memstream(&uart, &length);
+
+  Sim_Reset();
+  Sim_UartTo(out);
+  Sim_OnTim2(tim2Update);
+  Cycles_Init();
+  SWTimer_Init();
+  LCD_Init();
+  Joystick_Init(&joystick, &hadc1, ADC_CHANNEL_7, ADC_CHANNEL_8,
+                JoyStick_SW_GPIO_Port, JoyStick_SW_Pin);
+  Joystick_Calibrate(&joystick);
+  Soak_Init(baseSeed + board);
+  Game_Init(&play);
+
+  while (Soak_Stats()->played < games)
+  { Game_Run(&play, &joystick); }
+
+  fclose(out);
+  results[board].stats = *Soak_Stats();
+  if (results[board].stats.violations)
+  { results[board].uart = uart; }
+  else
+  { free(uart); }
+}
+
+/**
+ * @brief  Play the boards of a worker's run, then those left to steal.
+ * @param  arg: Worker.
+ */
+static void* work(void* arg)
+{
+  Worker* self = arg;
+  uint32_t index = (uint32_t)(self - workers);
+  uint32_t board;
+
+  for (;;)
+  {
+    uint8_t found = takeFront(self, &board);
+    for (uint32_t i = 1; !found && i < threads; i++)
+    { found = stealBack(&workers[(index + i) % threads], &board); }
+    if (!found)
+    { return NULL; }
+    playBoard(board);
+    self->played++;
+  }
+}
+
+/**
+ * @brief  Add the statistics of one board to the merged ones.
+ * @param  total: Merged statistics.
+ * @param  run: Statistics of the board.
+ */
+static void merge(SoakStats* total, const SoakStats* run)
+{
+  total->played += run->played;
+  total->roundsPlayed += run->roundsPlayed;
+  total->violations += run->violations;
+  for (uint8_t i = 0; i < PLAYERS_MAX; i++)
+  { total->games[i] += run->games[i]; }
+  for (uint8_t i = 0; i <= SOAK_MAX_ROUND; i++)
+  { total->rounds[i] += run->rounds[i]; }
+  for (uint8_t mode = 0; mode < 2; mode++)
+  {
+    for (uint8_t i = 0; i < SOAK_SCORE_BUCKETS; i++)
+    { total->scores[mode][i] += run->scores[mode][i]; }
+  }
+  total->frames += run->frames;
+  total->strobes += run->strobes;
+  if (run->maxStrobes > total->maxStrobes)
+  { total->maxStrobes = run->maxStrobes; }
+  total->clears += run->clears;
+  total->goldenSeen |= run->goldenSeen;
+  for (uint8_t i = 0; i < GAME_STATE_COUNT; i++)
+  {
+    total->events[i] |= run->events[i];
+    total->transitions[i] |= run->transitions[i];
+  }
+}
+
+int main(int argc, char** argv)
+{
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  SoakStats total = {0};
+  uint32_t boards, wallStart, wallMs;
+
+  totalGames = (argc > 1) ? strtoul(argv[1], NULL, 0) : BATCH_GAMES;
+  baseSeed = (argc > 2) ? strtoul(argv[2], NULL, 0) : SOAK_SEED;
+  threads = (argc > 3) ? strtoul(argv[3], NULL, 0) : (cores > 0 ? (uint32_t)cores : 1);
+  if (threads < 1)
+  { threads = 1; }
+  if (threads > BATCH_THREADS_MAX)
+  { threads = BATCH_THREADS_MAX; }
+
+  boards = (totalGames + BATCH_BOARD_GAMES - 1) / BATCH_BOARD_GAMES;
+  results = calloc(boards ? boards : 1, sizeof(BoardResult));
+  if (!results)
+  { return 2; }
+
+  // Equal runs of boards, the first ones one longer
+  for (uint32_t t = 0, next = 0; t < threads; t++)
+  {
+    uint32_t run = boards / threads + (t < boards % threads);
+    atomic_init(&workers[t].boards, ((uint64_t)(next + run) << 32) | next);
+    next += run;
+  }
+
+  wallStart = Sim_WallMs();
+  for (uint32_t t = 0; t < threads; t++)
+  {
+    if (pthread_create(&workers[t].thread, NULL, work, &workers[t]) != 0)
+    { return 2; }
+  }
+  for (uint32_t t = 0; t < threads; t++)
+  { pthread_join(workers[t].thread, NULL); }
+  wallMs = Sim_WallMs() - wallStart;
+
+  for (uint32_t b = 0; b < boards; b++)
+  {
+    merge(&total, &results[b].stats);
+    if (results[b].uart)
+    {
+      printf("batch board=%lu seed=%lu\n", (unsigned long)b, (unsigned long)(baseSeed + b));
+      fputs(results[b].uart, stdout);
+      free(results[b].uart);
+    }
+  }
+
+  printf("batch games=%lu rounds=%lu boards=%lu threads=%lu wall=%lu.%03lus rate=%lu games/s violations=%lu\n",
+         (unsigned long)total.played, (unsigned long)total.roundsPlayed, (unsigned long)boards,
+         (unsigned long)threads, (unsigned long)(wallMs / 1000), (unsigned long)(wallMs % 1000),
+         (unsigned long)(wallMs ? (uint64_t)total.played * 1000 / wallMs : 0),
+         (unsigned long)total.violations);
+  printf("batch boards per thread");
+  for (uint32_t t = 0; t < threads; t++)
+  { printf(" %lu", (unsigned long)workers[t].played); }
+  printf("\n");
+  fflush(stdout);
+
+  // The report goes through USART1 of a board on this thread
+  Sim_Reset();
+  Soak_Report(&total);
+  free(results);
+  return total.violations ? 1 : 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Host main of the bench build: runs the kernels of bench.c on the
+ * simulated board, as main.c does with VARIANT=BENCH before Game_Init.
+ *
+ *   build/bench
+ *
+ * The DWT counter of the simulated board counts virtual time, which only
+ * the modelled waits move: the display delays, the ADC, USART1 and the
+ * I2C1 bus. The figures are the time the kernels wait on the hardware,
+ * without the instructions around them, so only the kernels bound by a
+ * bus mean anything, screen_frame_sync above all. Built with LCD_BUS=I2C
+ * it gives the same kernels over the backpack at 100 kHz; diff the two
+ * reports with tools/bench_diff.py.
+ */
+
+#include "sim.h"
+#include "bench.h"
+#include "swtimer.h"
+#include "lcd1602.h"
+#include "adc.h"
+#include "cycles.h"
+
+int main(void)
+{
+  Joystick_HandleTypeDef joystick;
+
+  Sim_Reset();
+  Cycles_Init();
+  SWTimer_Init();
+  LCD_Init();
+  Joystick_Init(&joystick, &hadc1, ADC_CHANNEL_7, ADC_CHANNEL_8,
+                JoyStick_SW_GPIO_Port, JoyStick_SW_Pin);
+  Joystick_Calibrate(&joystick);
+  Bench_Run(&joystick);
+  return 0;
+}
@@ -0,0 +1,563 @@
+/*
+ * Fuzz target of the host: the game runs as on the board, with the real
+ * delays and the joystick sampled from the ADC, on the simulated HAL, and
+ * the fuzzer's bytes drive the buttons and the joystick axes.
+ *
+ * An input is a list of 2 byte records, the TIM2 ticks to wait and then an
+ * action on the inputs:
+ *
+ *   0x00-0x03  hold color button 0-3 low    0x0A       hold the awaited color low
+ *   0x04-0x07  release color button 0-3     0x0B       release every button
+ *   0x08       hold the joystick button     0x0C       play the turn right
+ *   0x09       release it                   0x10-0x1F  joystick X, low nibble * 273
+ *                                           0x20-0x2F  joystick Y, low nibble * 273
+ *
+ * and the other values only wait. The awaited color, the one Game_AwaitedInput
+ * asks for, is pressed once the game waits for one, up to FUZZ_AWAIT_TICKS
+ * later, and playing the turn presses every awaited color until the turn is
+ * over, so short inputs reach deep rounds. A press counts once two button
+ * samples 10 ticks apart see it, so it has to be held 20 ticks. After each
+ * step the game data is checked; a failed check, Error_Handler and every
+ * address or undefined behaviour sanitizer report end the run.
+ *
+ * LLVMFuzzerTestOneInput runs one input, for libFuzzer when built by clang
+ * with -fsanitize=fuzzer -DFUZZ_LIBFUZZER. Built with gcc, which has no
+ * libFuzzer, the standalone driver below takes its place:
+ *
+ *   build/fuzz [-q] file...        run each input, USART1 on stdout unless -q
+ *   build/fuzz -n runs corpus      mutate the inputs of corpus for runs runs
+ *
+ * The driver keeps a mutant that reaches new edges of the game code, which
+ * is built with -fsanitize-coverage=trace-pc. A run that fails writes its
+ * input to crash-<hash> and prints the line that reproduces it.
+ *
+ * Built with the -DSIMON_TRACE of VARIANT=TRACE, the same harness is the
+ * recording board of make trace: USART1 carries the trace lines the game
+ * sends at each game end, and each screen is printed as the replay build
+ * prints it, "<tick> frame |line|line|", to compare the two.
+ */
+
+#include "sim.h"
+#include "SimonGame.h"
+#include "swtimer.h"
+#include "lcd1602.h"
+#include "cycles.h"
+#include "adc.h"
+#include "lcdmodel.h"
+#include "glyph.h"
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <signal.h>
+#include <sanitizer/common_interface_defs.h>
+
+#define FUZZ_TAIL_TICKS      100      // ticks run after the last record
+#define FUZZ_STUCK_RUNS      100000   // Game_Run calls without time moving on
+#define FUZZ_AWAIT_TICKS     12000    // longest wait for an awaited color, Simon plays 100 s at round 100
+#define FUZZ_HOLD_TICKS      25       // press and release of a played turn, two button samples
+#define FUZZ_AXIS_STEP       273      // ADC counts per step of an axis action
+#define FUZZ_MAX_LEN         512      // longest input the driver makes
+#define FUZZ_CORPUS_MAX      1024     // inputs the driver keeps
+#define FUZZ_EDGES           65536    // size of the edge map
+
+static Game play;
+static Joystick_HandleTypeDef joystick;
+static uint16_t axes[2];              // joystick X and Y
+static const uint8_t* input;          // input under way, saved by crash()
+static size_t inputSize;
+static FILE* uart;                    // where USART1 goes
+static const char* self;              // argv[0], for the repro line
+
+static const struct
+{
+  GPIO_TypeDef* port;
+  uint16_t pin;
+} colorPins[4] = {{RedButton_GPIO_Port, RedButton_Pin}, {BlueButton_GPIO_Port, BlueButton_Pin},
+                  {YellowButtonm_GPIO_Port, YellowButtonm_Pin}, {GreenButton_GPIO_Port, GreenButton_Pin}};
+
+static void crash(const char* why);
+
+/**
+ * @brief  TIM2 update handler, HAL_TIM_PeriodElapsedCallback of main.c.
+ */
+static void tim2Update(void)
+{
+  SWTimer_Tick();
+  Game_Tick(&play);
+}
+
+/**
+ * @brief  Check the game data after a step of the main loop.
+ */
+static void checkGame(void)
+{
+  const GameInfo* info = &play.info;
+
+  if (play.state >= GAME_STATE_COUNT)
+  { crash("state out of range"); }
+  if (info->sequenceLength > SEQUENCE_MAX)
+  { crash("sequence longer than SEQUENCE_MAX"); }
+  if (info->numPlayers > PLAYERS_MAX)
+  { crash("more than PLAYERS_MAX players"); }
+  // The player menu changes numPlayers, the players are set up at the start
+  if ((play.state == ONE_PLAYER || play.state == MULTI_PLAYER) &&
+      (info->currentPlayer >= info->numPlayers || info->playersLeft > info->numPlayers))
+  { crash("player out of range"); }
+  for (uint8_t i = 0; i < info->sequenceLength; i++)
+  {
+    if (info->sequence[i] > 3)
+    { crash("color out of range"); }
+  }
+}
+
+#ifdef SIMON_TRACE
+/**
+ * @brief  Print the screen left by the last step on USART1, as the replay
+ *         build prints its screens: '@' for a CGRAM glyph and '#' for the
+ *         full block.
+ */
+static void printFrame(void)
+{
+  char frame[LCD_MODEL_ROWS][LCD_MODEL_COLS + 1];
+  LcdModelStats lcd;
+
+  if (!LcdModel_TakeFrame(&lcd) || !uart)
+  { return; }
+  LcdModel_Render(frame);
+  fprintf(uart, "%lu frame |", (unsigned long)SWTimer_Now());
+  for (uint8_t row = 0; row < LCD_MODEL_ROWS; row++)
+  {
+    for (uint8_t col = 0; col < LCD_MODEL_COLS; col++)
+    {
+      uint8_t code = (uint8_t)frame[row][col];
+      if (code == GLYPH_FULL_BLOCK)
+      { code = '#'; }
+      else if (code < GLYPH_CODE_BASE + GLYPH_SLOTS)
+      { code = '@'; }
+      fputc(code, uart);
+    }
+    fputc('|', uart);
+  }
+  fprintf(uart, "\r\n");
+}
+#endif
+
+/**
+ * @brief  Run the main loop until the virtual clock reaches a time.
+ * @param  until: Virtual time in microseconds.
+ */
+static void runUntil(uint64_t until)
+{
+  uint64_t last = Sim_Now();
+  uint32_t stuck = 0;
+
+  while (Sim_Now() < until)
+  {
+    Game_Run(&play, &joystick);
+    checkGame();
+#ifdef SIMON_TRACE
+    printFrame();
+#endif
+    if (Sim_Now() != last)
+    {
+      last = Sim_Now();
+      stuck = 0;
+    }
+    else if (++stuck == FUZZ_STUCK_RUNS)
+    { crash("main loop never sleeps"); }
+  }
+}
+
+/**
+ * @brief  Hold the color the game waits for low, once it waits for one.
+ * @return 1 if a color was pressed, 0 if the game did not wait for one
+ *         within FUZZ_AWAIT_TICKS.
+ */
+static uint8_t pressAwaited(void)
+{
+  int awaited;
+  uint8_t color;
+
+  for (uint32_t tick = 0; (awaited = Game_AwaitedInput(&play)) < 0; tick++)
+  {
+    if (tick == FUZZ_AWAIT_TICKS)
+    { return 0; }
+    runUntil(Sim_Now() + SIM_TIM2_PERIOD_US);
+  }
+  // Past the known part of a several player chain any color is right
+  color = (awaited < play.info.sequenceLength) ? play.info.sequence[awaited] : 0;
+  Sim_Press(colorPins[color].port, colorPins[color].pin, 1);
+  return 1;
+}
+
+/**
+ * @brief  Apply the action of a record to the inputs.
+ * @param  action: Action byte.
+ */
+static void act(uint8_t action)
+{
+  if (action <= 0x07)
+  { Sim_Press(colorPins[action & 3].port, colorPins[action & 3].pin, action < 0x04); }
+  else if (action == 0x08 || action == 0x09)
+  { Sim_Press(JoyStick_SW_GPIO_Port, JoyStick_SW_Pin, action == 0x08); }
+  else if (action == 0x0A)
+  { pressAwaited(); }
+  else if (action == 0x0C)
+  {
+    // The turn is over once the game stops waiting or starts over at 0
+    while (pressAwaited())
+    {
+      int pressed = Game_AwaitedInput(&play);
+      runUntil(Sim_Now() + FUZZ_HOLD_TICKS * SIM_TIM2_PERIOD_US);
+      act(0x0B);
+      runUntil(Sim_Now() + FUZZ_HOLD_TICKS * SIM_TIM2_PERIOD_US);
+      if (Game_AwaitedInput(&play) <= pressed)
+      { break; }
+    }
+  }
+  else if (action == 0x0B)
+  {
+    for (uint8_t c = 0; c < 4; c++)
+    { Sim_Press(colorPins[c].port, colorPins[c].pin, 0); }
+    Sim_Press(JoyStick_SW_GPIO_Port, JoyStick_SW_Pin, 0);
+  }
+  else if ((action & 0xF0) == 0x10 || (action & 0xF0) == 0x20)
+  {
+    axes[(action >> 5) & 1] = (action & 0x0F) * FUZZ_AXIS_STEP;
+    Sim_Joystick(axes[0], axes[1]);
+  }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+  input = data;
+  inputSize = size;
+
+  // Power on, as main.c sets the board up
+  Sim_Reset();
+  Sim_UartTo(uart);
+  Sim_OnTim2(tim2Update);
+  Cycles_Init();
+  SWTimer_Init();
+  LCD_Init();
+  Joystick_Init(&joystick, &hadc1, ADC_CHANNEL_7, ADC_CHANNEL_8,
+                JoyStick_SW_GPIO_Port, JoyStick_SW_Pin);
+  Joystick_Calibrate(&joystick);
+  Game_Init(&play);
+  axes[0] = SIM_ADC_CENTER;
+  axes[1] = SIM_ADC_CENTER;
+
+  for (size_t i = 0; i + 1 < size; i += 2)
+  {
+    runUntil(Sim_Now() + (uint64_t)data[i] * SIM_TIM2_PERIOD_US);
+    act(data[i + 1]);
+  }
+  runUntil(Sim_Now() + FUZZ_TAIL_TICKS * SIM_TIM2_PERIOD_US);
+  input = NULL;
+  return 0;
+}
+
+/**
+ * @brief  FNV-1a hash of an input, names its crash file.
+ */
+static uint32_t hash(const uint8_t* data, size_t size)
+{
+  uint32_t h = 2166136261u;
+
+  while (size--)
+  { h = (h ^ *data++) * 16777619u; }
+  return h;
+}
+
+/**
+ * @brief  Save the input under way and print how to reproduce it, from a
+ *         failed check or a sanitizer report.
+ */
+static void saveCrash(void)
+{
+  char name[32];
+  FILE* out;
+
+  if (!input)
+  { return; }
+  snprintf(name, sizeof(name), "crash-%08lx", (unsigned long)hash(input, inputSize));
+  out = fopen(name, "wb");
+  if (out)
+  {
+    fwrite(input, 1, inputSize, out);
+    fclose(out);
+  }
+  fprintf(stderr, "fuzz repro: %s %s\n", self, name);
+  input = NULL;
+}
+
+/**
+ * @brief  SIGABRT handler, Error_Handler of the simulated board aborts.
+ */
+static void onAbort(int sig)
+{
+  saveCrash();
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+// Sanitizer reports abort, so that onAbort saves the input of each of them
+const char* __asan_default_options(void)
+{
+  return "abort_on_error=1";
+}
+
+const char* __ubsan_default_options(void)
+{
+  return "abort_on_error=1:print_stacktrace=1";
+}
+
+/**
+ * @brief  Fail the run.
+ * @param  why: Check that failed.
+ */
+static void crash(const char* why)
+{
+  fprintf(stderr, "fuzz: %s at %llu us, state=%u round=%u\n", why,
+          (unsigned long long)Sim_Now(), play.state, play.info.round);
+  saveCrash();
+  abort();
+}
+
+#ifndef FUZZ_LIBFUZZER
+
+typedef struct
+{
+  uint8_t* data;
+  size_t size;
+} Input;
+
+static uint8_t edges[FUZZ_EDGES];       // edges hit by the current run
+static uint8_t seenEdges[FUZZ_EDGES];   // edges hit by any kept input
+static uintptr_t prevPc;
+static Input corpus[FUZZ_CORPUS_MAX];
+static uint32_t corpusSize;
+static uint64_t rng = 0x9E3779B97F4A7C15ull;
+
+// Called by every basic block of the game code, -fsanitize-coverage=trace-pc
+void __sanitizer_cov_trace_pc(void)
+{
+  uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+
+  edges[(pc ^ prevPc) % FUZZ_EDGES] = 1;
+  prevPc = pc >> 1;
+}
+
+/**
+ * @brief  Random number of the mutator, fixed seed so runs repeat.
+ */
+static uint32_t random32(void)
+{
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return (uint32_t)(rng >> 32);
+}
+
+/**
+ * @brief  Run an input and count the edges no kept input reached.
+ * @return Number of new edges, which are then marked seen.
+ */
+static uint32_t runCovered(const uint8_t* data, size_t size)
+{
+  uint32_t fresh = 0;
+
+  memset(edges, 0, sizeof(edges));
+  prevPc = 0;
+  LLVMFuzzerTestOneInput(data, size);
+  for (uint32_t i = 0; i < FUZZ_EDGES; i++)
+  {
+    if (edges[i] && !seenEdges[i])
+    {
+      seenEdges[i] = 1;
+      fresh++;
+    }
+  }
+  return fresh;
+}
+
+/**
+ * @brief  Keep an input in the corpus.
+ */
+static void keep(const uint8_t* data, size_t size)
+{
+  if (corpusSize == FUZZ_CORPUS_MAX)
+  { return; }
+  corpus[corpusSize].data = malloc(size ? size : 1);
+  memcpy(corpus[corpusSize].data, data, size);
+  corpus[corpusSize].size = size;
+  corpusSize++;
+}
+
+/**
+ * @brief  Read a whole file.
+ * @return Its bytes, malloc'ed, NULL if it cannot be read.
+ */
+static uint8_t* readFile(const char* path, size_t* size)
+{
+  FILE* in = fopen(path, "rb");
+  uint8_t* data = malloc(FUZZ_MAX_LEN);
+
+  if (!in || !data)
+  {
+    if (in)
+    { fclose(in); }
+    free(data);
+    return NULL;
+  }
+  *size = fread(data, 1, FUZZ_MAX_LEN, in);
+  fclose(in);
+  return data;
+}
+
+/**
+ * @brief  Make a mutant of a kept input: change, insert or delete a
+ *         record, or splice in the tail of another input.
+ * @return Length of the mutant in out.
+ */
+static size_t mutate(const Input* from, uint8_t* out)
+{
+  size_t size = from->size & ~(size_t)1;
+  uint32_t records = size / 2;
+  uint32_t at = records ? random32() % records : 0;
+
+  memcpy(out, from->data, size);
+  switch (random32() % 5)
+  {
+    case 0:   // new wait
+      if (records)
+      { out[2 * at] = random32() % ((random32() & 1) ? 16 : 256); }
+      break;
+    case 1:   // new action
+      if (records)
+      { out[2 * at + 1] = random32() % 0x30; }
+      break;
+    case 2:   // insert a record
+      if (size + 2 <= FUZZ_MAX_LEN)
+      {
+        memmove(out + 2 * at + 2, out + 2 * at, size - 2 * at);
+        out[2 * at] = random32() % 32;
+        out[2 * at + 1] = random32() % 0x30;
+        size += 2;
+      }
+      break;
+    case 3:   // delete a record
+      if (records)
+      {
+        memmove(out + 2 * at, out + 2 * at + 2, size - 2 * at - 2);
+        size -= 2;
+      }
+      break;
+    default:  // splice
+    {
+      const Input* other = &corpus[random32() % corpusSize];
+      size_t tail = (other->size & ~(size_t)1) / 2;
+      size_t from2 = tail ? 2 * (random32() % tail) : 0;
+      size_t add = other->size - from2;
+      if (2 * at + add > FUZZ_MAX_LEN)
+      { add = FUZZ_MAX_LEN - 2 * at; }
+      memcpy(out + 2 * at, other->data + from2, add);
+      size = (2 * at + add) & ~(size_t)1;
+      break;
+    }
+  }
+  return size;
+}
+
+/**
+ * @brief  Load every file of a directory into the corpus, running each.
+ */
+static void loadCorpus(const char* dir)
+{
+  DIR* d = opendir(dir);
+  struct dirent* entry;
+
+  if (!d)
+  {
+    fprintf(stderr, "fuzz: cannot open %s\n", dir);
+    exit(2);
+  }
+  while ((entry = readdir(d)) != NULL)
+  {
+    char path[512];
+    size_t size;
+    uint8_t* data;
+
+    if (entry->d_name[0] == '.')
+    { continue; }
+    snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+    data = readFile(path, &size);
+    if (!data)
+    { continue; }
+    runCovered(data, size);
+    keep(data, size);
+    free(data);
+  }
+  closedir(d);
+}
+
+int main(int argc, char** argv)
+{
+  static uint8_t mutant[FUZZ_MAX_LEN];
+  uint32_t runs = 0;
+
+  self = argv[0];
+  __sanitizer_set_death_callback(saveCrash);
+  signal(SIGABRT, onAbort);
+
+  if (argc == 4 && strcmp(argv[1], "-n") == 0)
+  {
+    runs = strtoul(argv[2], NULL, 0);
+    loadCorpus(argv[3]);
+    if (!corpusSize)
+    { keep((const uint8_t*)"", 0); }
+    for (uint32_t run = 1; run <= runs; run++)
+    {
+      size_t size = mutate(&corpus[random32() % corpusSize], mutant);
+      uint32_t fresh = runCovered(mutant, size);
+      if (fresh)
+      {
+        keep(mutant, size);
+        printf("fuzz run=%lu new=%lu corpus=%lu len=%lu\n", (unsigned long)run,
+               (unsigned long)fresh, (unsigned long)corpusSize, (unsigned long)size);
+      }
+    }
+    printf("fuzz done runs=%lu corpus=%lu\n", (unsigned long)runs, (unsigned long)corpusSize);
+    return 0;
+  }
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s [-q] file... | %s -n runs corpus\n", argv[0], argv[0]);
+    return 2;
+  }
+  uart = stdout;
+  if (strcmp(argv[1], "-q") == 0)
+  {
+    uart = NULL;
+    argc--;
+    argv++;
+  }
+  for (int i = 1; i < argc; i++)
+  {
+    size_t size;
+    uint8_t* data = readFile(argv[i], &size);
+    if (!data)
+    {
+      fprintf(stderr, "fuzz: cannot read %s\n", argv[i]);
+      return 2;
+    }
+    LLVMFuzzerTestOneInput(data, size);
+    printf("fuzz %s ok, state=%u round=%u at %llu ms\n", argv[i], play.state, play.info.round,
+           (unsigned long long)(Sim_Now() / 1000));
+    free(data);
+  }
+  return 0;
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef STM32WBXX_HAL_H
+#define STM32WBXX_HAL_H
+
+/*
+ * Host stand-in for the part of the STM32WB HAL the game core uses, so the
+ * CubeMX headers of Core/Inc compile unchanged on the host. The peripherals
+ * are simulated by sim.c on a virtual clock, see sim.h.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HAL_MAX_DELAY  0xFFFFFFFFu
+
+typedef enum
+{
+  HAL_OK = 0,
+  HAL_ERROR,
+  HAL_BUSY,
+  HAL_TIMEOUT
+} HAL_StatusTypeDef;
+
+// GPIO. A port only names its slot in the simulation, so the pin tables of
+// the game stay constant initializers
+
+#define SIM_PORTS  5
+
+typedef struct
+{
+  uint8_t index;
+} GPIO_TypeDef;
+
+typedef enum
+{
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET
+} GPIO_PinState;
+
+extern GPIO_TypeDef Sim_Ports[SIM_PORTS];
+
+#define GPIOA  (&Sim_Ports[0])
+#define GPIOB  (&Sim_Ports[1])
+#define GPIOC  (&Sim_Ports[2])
+#define GPIOD  (&Sim_Ports[3])
+#define GPIOE  (&Sim_Ports[4])
+
+#define GPIO_PIN_0   ((uint16_t)0x0001)
+#define GPIO_PIN_1   ((uint16_t)0x0002)
+#define GPIO_PIN_2   ((uint16_t)0x0004)
+#define GPIO_PIN_3   ((uint16_t)0x0008)
+#define GPIO_PIN_4   ((uint16_t)0x0010)
+#define GPIO_PIN_5   ((uint16_t)0x0020)
+#define GPIO_PIN_6   ((uint16_t)0x0040)
+#define GPIO_PIN_7   ((uint16_t)0x0080)
+#define GPIO_PIN_8   ((uint16_t)0x0100)
+#define GPIO_PIN_9   ((uint16_t)0x0200)
+#define GPIO_PIN_10  ((uint16_t)0x0400)
+#define GPIO_PIN_11  ((uint16_t)0x0800)
+#define GPIO_PIN_12  ((uint16_t)0x1000)
+#define GPIO_PIN_13  ((uint16_t)0x2000)
+#define GPIO_PIN_14  ((uint16_t)0x4000)
+#define GPIO_PIN_15  ((uint16_t)0x8000)
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state);
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin);
+
+// SysTick
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t delay);
+
+// Timers. TIM2 runs the 10 ms game tick, TIM16 the button tones
+
+typedef struct
+{
+  uint8_t index;
+} TIM_TypeDef;
+
+typedef struct
+{
+  TIM_TypeDef* Instance;
+} TIM_HandleTypeDef;
+
+extern TIM_TypeDef Sim_Timers[2];
+
+#define TIM2           (&Sim_Timers[0])
+#define TIM16          (&Sim_Timers[1])
+#define TIM_CHANNEL_1  0x00000000u
+
+#define __HAL_TIM_GET_AUTORELOAD(handle)        Sim_TimAutoreload(handle)
+#define __HAL_TIM_GET_COUNTER(handle)           Sim_TimCounter(handle)
+#define __HAL_TIM_SET_PRESCALER(handle, value)  Sim_TimPrescaler((handle), (value))
+
+uint32_t Sim_TimAutoreload(TIM_HandleTypeDef* htim);
+uint32_t Sim_TimCounter(TIM_HandleTypeDef* htim);
+void Sim_TimPrescaler(TIM_HandleTypeDef* htim, uint32_t prescaler);
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t channel);
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t channel);
+
+// USART1 log at 9600 baud
+
+typedef struct
+{
+  uint8_t index;
+} UART_HandleTypeDef;
+
+typedef struct
+{
+  uint8_t index;
+} DMA_HandleTypeDef;
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data,
+                                    uint16_t size, uint32_t timeout);
+
+// ADC1, the joystick axes
+
+typedef struct
+{
+  uint8_t index;
+} ADC_HandleTypeDef;
+
+typedef struct
+{
+  uint32_t Channel;
+  uint32_t Rank;
+  uint32_t SamplingTime;
+} ADC_ChannelConfTypeDef;
+
+#define ADC_CHANNEL_7               7u    // joystick X
+#define ADC_CHANNEL_8               8u    // joystick Y
+#define ADC_REGULAR_RANK_1          1u
+#define ADC_SAMPLETIME_247CYCLES_5  7u
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* hadc, ADC_ChannelConfTypeDef* config);
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef* hadc);
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef* hadc, uint32_t timeout);
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef* hadc);
+HAL_StatusTypeDef HAL_ADC_Stop(ADC_HandleTypeDef* hadc);
+
+// I2C1 with its TX DMA channel, the LCD backpack of LCD_I2C builds
+
+typedef struct
+{
+  uint8_t index;
+} I2C_TypeDef;
+
+typedef struct
+{
+  I2C_TypeDef* Instance;
+} I2C_HandleTypeDef;
+
+typedef enum
+{
+  HAL_I2C_STATE_READY = 0x20,
+  HAL_I2C_STATE_BUSY_TX = 0x21
+} HAL_I2C_StateTypeDef;
+
+extern I2C_TypeDef Sim_I2c1;
+
+#define I2C1  (&Sim_I2c1)
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef* hi2c, uint16_t address,
+                                              uint8_t* data, uint16_t size);
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef* hi2c, uint16_t address);
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c);
+
+// Core: interrupt masking, sleep and the DWT cycle counter
+
+typedef struct
+{
+  uint32_t CTRL;
+  uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct
+{
+  uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT                          Sim_Dwt()
+#define CoreDebug                    Sim_CoreDebug()
+#define DWT_CTRL_CYCCNTENA_Msk       0x00000001u
+#define CoreDebug_DEMCR_TRCENA_Msk   0x01000000u
+#define SystemCoreClock              32000000u
+
+DWT_Type* Sim_Dwt(void);
+CoreDebug_Type* Sim_CoreDebug(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+void __WFI(void);
+
+// Milliseconds of real time, for the speed of a run
+uint32_t Sim_WallMs(void);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef STM32WBXX_HAL_GPIO_H
+#define STM32WBXX_HAL_GPIO_H
+
+// joystick.h includes the GPIO driver by name, the stand-in has it all in
+// stm32wbxx_hal.h
+#include "stm32wbxx_hal.h"
+
+#endif
@@ -0,0 +1,409 @@
+/*
+ * Simulated board for the host builds, see sim.h. Stands in for the HAL
+ * drivers, for stm32wbxx_it.c, which times the TIM2 handler for the CPU
+ * load, and for the flash store, which keeps its values in RAM.
+ */
+
+#include "sim.h"
+#include "cpuload.h"
+#include "flashstore.h"
+#include "board.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SIM_IRQ_TIM2  0x01
+#define SIM_IRQ_I2C   0x02
+
+typedef struct
+{
+  uint64_t now;                 // virtual time in us
+  uint64_t nextUpdate;          // virtual time of the next TIM2 update
+  uint32_t primask;
+  uint64_t i2cEnd;              // virtual time the I2C1 transfer ends, 0 if none
+  uint8_t inHandler;            // a handler runs, the others wait
+  uint8_t pending;              // SIM_IRQ_* waiting for their handler to run
+  uint16_t odr[SIM_PORTS];      // output levels
+  uint16_t pullUp[SIM_PORTS];   // inputs with a pull-up
+  uint16_t low[SIM_PORTS];      // inputs held low
+  uint16_t axes[2];             // joystick X and Y
+  uint32_t adcChannel;
+  uint64_t randNext;            // newlib rand() state
+  uint64_t dwtAt;               // virtual time of the last DWT reading
+  DWT_Type dwt;
+  CoreDebug_Type coreDebug;
+  uint32_t store[STORE_KEY_COUNT];
+  uint8_t storePresent;
+  FILE* uart;
+  void (*tim2)(void);
+  void (*idle)(void);
+  void (*update)(void);
+} Sim;
+
+GPIO_TypeDef Sim_Ports[SIM_PORTS] = {{0}, {1}, {2}, {3}, {4}};
+TIM_TypeDef Sim_Timers[2] = {{0}, {1}};
+I2C_TypeDef Sim_I2c1 = {0};
+
+ADC_HandleTypeDef hadc1;
+TIM_HandleTypeDef htim2 = {TIM2};
+TIM_HandleTypeDef htim16 = {TIM16};
+UART_HandleTypeDef huart1;
+I2C_HandleTypeDef hi2c1 = {I2C1};
+DMA_HandleTypeDef hdma_i2c1_tx;
+
+static BOARD_STATE Sim sim;   // one board per thread, see batch.c
+
+/**
+ * @brief  Run the handlers of the interrupts that wait, if nothing holds
+ *         them back, timing them like stm32wbxx_it.c does. TIM2 has the
+ *         lower IRQ number, so it goes first.
+ */
+static void runPending(void)
+{
+  while (sim.pending && !sim.primask && !sim.inHandler)
+  {
+    sim.inHandler = 1;
+    uint32_t start = DWT->CYCCNT;
+    if (sim.pending & SIM_IRQ_TIM2)
+    {
+      sim.pending &= ~SIM_IRQ_TIM2;
+      if (sim.tim2)
+      { sim.tim2(); }
+      CpuLoad_Isr(CPULOAD_TIM2, start);
+    }
+    else
+    {
+      sim.pending &= ~SIM_IRQ_I2C;
+      HAL_I2C_MasterTxCpltCallback(&hi2c1);
+      CpuLoad_Isr(CPULOAD_I2C, start);
+    }
+    sim.inHandler = 0;
+  }
+}
+
+/**
+ * @brief  Virtual time of the next interrupt.
+ * @return The end of the I2C1 transfer if it comes before the TIM2 update.
+ */
+static uint64_t nextInterrupt(void)
+{
+  return (sim.i2cEnd && sim.i2cEnd < sim.nextUpdate) ? sim.i2cEnd : sim.nextUpdate;
+}
+
+/**
+ * @brief  Move the virtual clock forward, raising the TIM2 updates and the
+ *         end of the I2C1 transfer on the way. A handler may move it
+ *         further itself.
+ * @param  us: Microseconds to wait.
+ */
+static void advance(uint64_t us)
+{
+  uint64_t end = sim.now + us;
+  uint64_t at;
+
+  while ((at = nextInterrupt()) <= end)
+  {
+    if (sim.now < at)
+    { sim.now = at; }
+    if (at == sim.i2cEnd)
+    {
+      sim.i2cEnd = 0;
+      sim.pending |= SIM_IRQ_I2C;
+    }
+    else
+    {
+      sim.nextUpdate += SIM_TIM2_PERIOD_US;
+      if (sim.update)
+      { sim.update(); }
+      sim.pending |= SIM_IRQ_TIM2;
+    }
+    runPending();
+  }
+  if (sim.now < end)
+  { sim.now = end; }
+}
+
+void Sim_Reset(void)
+{
+  memset(&sim, 0, sizeof(sim));
+  sim.nextUpdate = SIM_TIM2_PERIOD_US;
+  sim.pullUp[RedButton_GPIO_Port->index] |= RedButton_Pin;
+  sim.pullUp[BlueButton_GPIO_Port->index] |= BlueButton_Pin;
+  sim.pullUp[YellowButtonm_GPIO_Port->index] |= YellowButtonm_Pin;
+  sim.pullUp[GreenButton_GPIO_Port->index] |= GreenButton_Pin;
+  sim.pullUp[JoyStick_SW_GPIO_Port->index] |= JoyStick_SW_Pin;
+  sim.axes[0] = SIM_ADC_CENTER;
+  sim.axes[1] = SIM_ADC_CENTER;
+  sim.randNext = 1;
+  sim.uart = stdout;
+}
+
+void Sim_OnTim2(void (*handler)(void))
+{
+  sim.tim2 = handler;
+}
+
+void Sim_OnIdle(void (*hook)(void))
+{
+  sim.idle = hook;
+}
+
+void Sim_OnUpdate(void (*hook)(void))
+{
+  sim.update = hook;
+}
+
+void Sim_UartTo(FILE* out)
+{
+  sim.uart = out;
+}
+
+uint64_t Sim_Now(void)
+{
+  return sim.now;
+}
+
+void Sim_Busy(uint32_t us)
+{
+  advance(us);
+}
+
+void Sim_Press(GPIO_TypeDef* port, uint16_t pin, uint8_t pressed)
+{
+  if (pressed)
+  { sim.low[port->index] |= pin; }
+  else
+  { sim.low[port->index] &= ~pin; }
+}
+
+uint8_t Sim_Output(GPIO_TypeDef* port, uint16_t pin)
+{
+  return (sim.odr[port->index] & pin) != 0;
+}
+
+void Sim_Joystick(uint16_t x, uint16_t y)
+{
+  sim.axes[0] = x & 0x0FFF;
+  sim.axes[1] = y & 0x0FFF;
+}
+
+int Sim_Rand(void)
+{
+  sim.randNext = sim.randNext * 6364136223846793005ULL + 1;
+  return (int)((sim.randNext >> 32) & 0x7FFFFFFF);
+}
+
+void Sim_Srand(unsigned int seed)
+{
+  sim.randNext = seed;
+}
+
+uint32_t Sim_WallMs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// HAL stand-in
+
+void HAL_GPIO_WritePin(GPIO_TypeDef* port, uint16_t pin, GPIO_PinState state)
+{
+  if (state == GPIO_PIN_SET)
+  { sim.odr[port->index] |= pin; }
+  else
+  { sim.odr[port->index] &= ~pin; }
+}
+
+GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef* port, uint16_t pin)
+{
+  if (sim.low[port->index] & pin)
+  { return GPIO_PIN_RESET; }
+  if (sim.pullUp[port->index] & pin)
+  { return GPIO_PIN_SET; }
+  return (sim.odr[port->index] & pin) ? GPIO_PIN_SET : GPIO_PIN_RESET;
+}
+
+uint32_t HAL_GetTick(void)
+{
+  advance(1);
+  return (uint32_t)(sim.now / 1000);
+}
+
+void HAL_Delay(uint32_t delay)
+{
+  // As the HAL, wait one more tick to cover the one under way
+  if (delay < HAL_MAX_DELAY)
+  { delay++; }
+  advance((uint64_t)delay * 1000);
+}
+
+uint32_t Sim_TimAutoreload(TIM_HandleTypeDef* htim)
+{
+  return (htim->Instance == TIM2) ? SIM_TIM2_PERIOD_US - 1 : 0;
+}
+
+uint32_t Sim_TimCounter(TIM_HandleTypeDef* htim)
+{
+  if (htim->Instance != TIM2)
+  { return 0; }
+  advance(1);
+  return (uint32_t)(SIM_TIM2_PERIOD_US - (sim.nextUpdate - sim.now));
+}
+
+void Sim_TimPrescaler(TIM_HandleTypeDef* htim, uint32_t prescaler)
+{
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Start(TIM_HandleTypeDef* htim, uint32_t channel)
+{
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_PWM_Stop(TIM_HandleTypeDef* htim, uint32_t channel)
+{
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef* huart, const uint8_t* data,
+                                    uint16_t size, uint32_t timeout)
+{
+  if (sim.uart)
+  { fwrite(data, 1, size, sim.uart); }
+  // Start bit, 8 data bits and a stop bit per byte
+  advance(((uint64_t)size * 10 * 1000000 + SIM_BAUD - 1) / SIM_BAUD);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Transmit_DMA(I2C_HandleTypeDef* hi2c, uint16_t address,
+                                              uint8_t* data, uint16_t size)
+{
+  if (HAL_I2C_GetState(hi2c) != HAL_I2C_STATE_READY)
+  { return HAL_BUSY; }
+  // Start, the address and data bytes with their acknowledge, and stop
+  sim.i2cEnd = sim.now + (uint64_t)(size + 1) * SIM_I2C_BYTE_US + SIM_I2C_BIT_US;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Abort_IT(I2C_HandleTypeDef* hi2c, uint16_t address)
+{
+  sim.i2cEnd = 0;
+  sim.pending &= ~SIM_IRQ_I2C;
+  return HAL_OK;
+}
+
+HAL_I2C_StateTypeDef HAL_I2C_GetState(I2C_HandleTypeDef* hi2c)
+{
+  // As the HAL, the handle is ready again right before the callback runs
+  return (sim.i2cEnd || (sim.pending & SIM_IRQ_I2C)) ? HAL_I2C_STATE_BUSY_TX : HAL_I2C_STATE_READY;
+}
+
+// Weak as in the HAL, lcdi2c.c has the callbacks of LCD_I2C builds
+__attribute__((weak)) void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef* hi2c)
+{
+}
+
+__attribute__((weak)) void HAL_I2C_ErrorCallback(I2C_HandleTypeDef* hi2c)
+{
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef* hadc, ADC_ChannelConfTypeDef* config)
+{
+  sim.adcChannel = config->Channel;
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef* hadc)
+{
+  advance(SIM_ADC_US);
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_PollForConversion(ADC_HandleTypeDef* hadc, uint32_t timeout)
+{
+  return HAL_OK;
+}
+
+uint32_t HAL_ADC_GetValue(ADC_HandleTypeDef* hadc)
+{
+  return (sim.adcChannel == ADC_CHANNEL_8) ? sim.axes[1] : sim.axes[0];
+}
+
+HAL_StatusTypeDef HAL_ADC_Stop(ADC_HandleTypeDef* hadc)
+{
+  return HAL_OK;
+}
+
+DWT_Type* Sim_Dwt(void)
+{
+  // The counter only runs once Cycles_Init enabled it, as on the core
+  if ((sim.coreDebug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (sim.dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk))
+  { sim.dwt.CYCCNT += (uint32_t)((sim.now - sim.dwtAt) * (SystemCoreClock / 1000000)); }
+  sim.dwtAt = sim.now;
+  return &sim.dwt;
+}
+
+CoreDebug_Type* Sim_CoreDebug(void)
+{
+  return &sim.coreDebug;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+  return sim.primask;
+}
+
+void __set_PRIMASK(uint32_t primask)
+{
+  sim.primask = primask & 1;
+  runPending();
+}
+
+void __disable_irq(void)
+{
+  sim.primask = 1;
+}
+
+void __enable_irq(void)
+{
+  sim.primask = 0;
+  runPending();
+}
+
+void __WFI(void)
+{
+  if (sim.idle)
+  { sim.idle(); }
+  // An interrupt pending behind PRIMASK wakes the core up right away
+  if (!sim.pending)
+  { advance(nextInterrupt() - sim.now); }
+}
+
+void Error_Handler(void)
+{
+  fprintf(stderr, "Error_Handler at %llu us\n", (unsigned long long)sim.now);
+  abort();
+}
+
+// Flash store, in RAM
+
+void Store_Init(void)
+{
+}
+
+uint8_t Store_Get(StoreKey key, uint32_t* value)
+{
+  if (key >= STORE_KEY_COUNT || !(sim.storePresent & (1u << key)))
+  { return 0; }
+  *value = sim.store[key];
+  return 1;
+}
+
+HAL_StatusTypeDef Store_Put(StoreKey key, uint32_t value)
+{
+  if (key >= STORE_KEY_COUNT)
+  { return HAL_ERROR; }
+  sim.store[key] = value;
+  sim.storePresent |= 1u << key;
+  return HAL_OK;
+}
@@ -0,0 +1,69 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "main.h"
+
+/*
+ * Simulated board for the host builds: the peripherals of the HAL
+ * stand-in in hal/stm32wbxx_hal.h on a virtual clock in microseconds.
+ *
+ * Time only moves when the firmware waits for it: HAL_Delay, each poll of
+ * HAL_GetTick or of the TIM2 counter (1 us), an ADC conversion, the bytes
+ * of HAL_UART_Transmit at 9600 baud, and WFI, which sleeps until the next
+ * TIM2 update. TIM2 updates every 10 ms and runs the handler set with
+ * Sim_OnTim2 as the interrupt would: right away, once PRIMASK is cleared,
+ * and never inside a running handler. An I2C1 DMA transfer runs on its own
+ * at 100 kHz and ends with HAL_I2C_MasterTxCpltCallback, an interrupt of
+ * its own that also wakes WFI. A run is fully determined by its inputs.
+ *
+ * The firmware code itself runs in no time, handlers included, so the
+ * handler timing of cpuload.c reads 0 unless Sim_Busy charges some.
+ */
+
+#define SIM_TIM2_PERIOD_US    10000   // TIM2 update period, the game tick
+#define SIM_BAUD              9600    // USART1
+#define SIM_ADC_US            8       // one conversion of 247.5 cycles
+#define SIM_ADC_CENTER        2048    // joystick axes at rest
+#define SIM_I2C_BIT_US        10      // I2C1 at 100 kHz
+#define SIM_I2C_BYTE_US       (9 * SIM_I2C_BIT_US)   // a byte and its acknowledge
+
+// Reset the board: time 0, pins released, joystick centered, rand()
+// seeded with 1, USART1 to stdout
+void Sim_Reset(void);
+
+// Handler of the TIM2 update interrupt
+void Sim_OnTim2(void (*handler)(void));
+
+// Called by WFI before the clock runs to the next TIM2 update
+void Sim_OnIdle(void (*hook)(void));
+
+// Called at each TIM2 update, before the handler, to change the inputs
+void Sim_OnUpdate(void (*hook)(void));
+
+// Where USART1 goes, NULL to drop it
+void Sim_UartTo(FILE* out);
+
+// Virtual time in microseconds since Sim_Reset
+uint64_t Sim_Now(void);
+
+// Keep the core busy for a number of microseconds, as code that computes
+// would. Inside a handler the interrupts that come up meanwhile wait
+void Sim_Busy(uint32_t us);
+
+// Hold an input pin low or let its pull-up take it high again
+void Sim_Press(GPIO_TypeDef* port, uint16_t pin, uint8_t pressed);
+
+// Level of an output pin
+uint8_t Sim_Output(GPIO_TypeDef* port, uint16_t pin);
+
+// Set the joystick axes, 0 to 4095
+void Sim_Joystick(uint16_t x, uint16_t y);
+
+// rand() and srand() of the firmware, the newlib generator with its state
+// kept per board so target traces replay the same sequences
+int Sim_Rand(void);
+void Sim_Srand(unsigned int seed);
+
+#endif
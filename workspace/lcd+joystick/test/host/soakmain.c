@@ -0,0 +1,129 @@
+/*
+ * Host main of the soak builds: sets the simulated board up as main.c sets
+ * up the real one and lets the soak driver play, until the number of games
+ * asked for or the end of the replayed trace.
+ *
+ *   build/soak [-g] [-s us] [games] [seed]
+ *
+ * Exits with 1 if the run had violations, or with -g if it never showed one
+ * of the golden frames of soak.c, which make test uses to fail on a screen
+ * that no longer draws as it should. A handler run over its budget of
+ * cpuload.h is a violation too; -s keeps the TIM2 handler busy for that
+ * many more microseconds, which make budget uses to check they are caught.
+ * Without -s every handler reads max=0us: the simulation charges their
+ * code no time, so only the target checks the real handlers against their
+ * budgets.
+ */
+
+#include "sim.h"
+#include "soak.h"
+#include "swtimer.h"
+#include "lcd1602.h"
+#include "cycles.h"
+#include "adc.h"
+#include "cpuload.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SOAK_HOST_GAMES  10000    // games of a run without arguments
+
+static Game play;
+static uint32_t slowTim2Us;    // extra time in the TIM2 handler, -s
+
+static const char* const isrNames[CPULOAD_ISRS] = {"tim2", "systick", "uart", "i2c"};
+
+/**
+ * @brief  TIM2 update handler, HAL_TIM_PeriodElapsedCallback of main.c.
+ */
+static void tim2Update(void)
+{
+  SWTimer_Tick();
+  Game_Tick(&play);
+  if (slowTim2Us)
+  { Sim_Busy(slowTim2Us); }
+}
+
+/**
+ * @brief  Whether the run is over.
+ * @param  games: Games to play.
+ */
+static uint8_t finished(uint32_t games)
+{
+#ifdef SIMON_REPLAY
+  (void)games;
+  return Soak_ReplayDone();
+#else
+  return Soak_Stats()->played >= games;
+#endif
+}
+
+/**
+ * @brief  Print the timing of the handlers that ran.
+ * @return Runs over their budget, of all handlers.
+ */
+static uint32_t reportHandlers(void)
+{
+  uint32_t over = 0;
+
+  for (uint8_t isr = 0; isr < CPULOAD_ISRS; isr++)
+  {
+    const CpuLoadIsrStats* timing = CpuLoad_IsrStats(isr);
+    if (timing->runs == 0)
+    { continue; }
+    printf("soak isr %s runs=%lu max=%luus budget=%luus over=%lu\n", isrNames[isr],
+           (unsigned long)timing->runs, (unsigned long)(Cycles_ToNs(timing->maxCycles) / 1000),
+           (unsigned long)(Cycles_ToNs(timing->budgetCycles) / 1000),
+           (unsigned long)timing->violations);
+    over += timing->violations;
+  }
+  return over;
+}
+
+int main(int argc, char** argv)
+{
+  uint8_t golden = 0;
+  uint32_t games, seed, over;
+  Joystick_HandleTypeDef joystick;
+
+  for (; argc > 1 && argv[1][0] == '-'; argc--, argv++)
+  {
+    if (strcmp(argv[1], "-g") == 0)
+    { golden = 1; }
+    else if (strcmp(argv[1], "-s") == 0 && argc > 2)
+    {
+      slowTim2Us = strtoul(argv[2], NULL, 0);
+      argc--;
+      argv++;
+    }
+    else
+    {
+      fprintf(stderr, "usage: %s [-g] [-s us] [games] [seed]\n", argv[0]);
+      return 2;
+    }
+  }
+  games = (argc > 1) ? strtoul(argv[1], NULL, 0) : SOAK_HOST_GAMES;
+  seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : SOAK_SEED;
+
+  Sim_Reset();
+  Sim_OnTim2(tim2Update);
+  Cycles_Init();
+  SWTimer_Init();
+  LCD_Init();
+  Joystick_Init(&joystick, &hadc1, ADC_CHANNEL_7, ADC_CHANNEL_8,
+                JoyStick_SW_GPIO_Port, JoyStick_SW_Pin);
+  Joystick_Calibrate(&joystick);
+  Soak_Init(seed);
+  Game_Init(&play);
+
+  while (!finished(games))
+  { Game_Run(&play, &joystick); }
+
+  over = reportHandlers();
+  if (golden)
+  {
+    Soak_Report(Soak_Stats());
+    if (Soak_GoldenUnseen(Soak_Stats(), 1))
+    { return 1; }
+  }
+  return (Soak_Stats()->violations || over) ? 1 : 0;
+}
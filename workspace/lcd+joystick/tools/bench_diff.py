@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Store VARIANT=BENCH reports and compare them with a baseline.
+
+Capture USART1 while the bench build boots, then:
+
+    python3 tools/bench_diff.py capture.log --save before.json
+    ... change the driver, rebuild, capture again ...
+    python3 tools/bench_diff.py capture.log --baseline before.json
+
+The comparison uses the minimum cycle count of each kernel, the figure
+the interrupts disturb least. It exits with status 1 when a kernel got
+slower than the threshold.
+"""
+
+import argparse
+import json
+import sys
+
+
+def read_report(path):
+    results = {}
+    with open(path, errors="replace") as capture:
+        for line in capture:
+            fields = line.split()
+            if len(fields) < 2 or fields[0] != "bench" or not fields[1].startswith("name="):
+                continue
+            values = dict(field.split("=", 1) for field in fields[1:])
+            name = values.pop("name")
+            results[name] = {key: int(value) for key, value in values.items()}
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="USART1 capture of a bench build")
+    parser.add_argument("--save", metavar="JSON", help="store the results")
+    parser.add_argument("--baseline", metavar="JSON", help="results to compare with")
+    parser.add_argument("--threshold", type=float, default=5.0,
+                        help="slowdown in percent reported as a regression (default 5)")
+    args = parser.parse_args()
+
+    results = read_report(args.capture)
+    if not results:
+        sys.exit("no bench lines in " + args.capture)
+
+    if args.save:
+        with open(args.save, "w") as out:
+            json.dump(results, out, indent=2, sort_keys=True)
+
+    if not args.baseline:
+        for name, values in results.items():
+            print("%-18s %10d cycles %10d ns" % (name, values["min"], values["ns"]))
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    regressions = 0
+    print("%-18s %10s %10s %8s" % ("kernel", "before", "after", "change"))
+    for name in sorted(set(baseline) | set(results)):
+        if name not in results or name not in baseline:
+            print("%-18s %s" % (name, "only in baseline" if name in baseline else "new"))
+            continue
+        before = baseline[name]["min"]
+        after = results[name]["min"]
+        change = (after - before) * 100.0 / before if before else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  slower"
+            regressions += 1
+        print("%-18s %10d %10d %+7.1f%%%s" % (name, before, after, change, flag))
+
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
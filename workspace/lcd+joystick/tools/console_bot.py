@@ -0,0 +1,96 @@
+#!/usr/bin/env python3
+"""Play one player games through the command console of a CONSOLE=UART build.
+
+The bot asks the board for "info", pushes the joystick through the menus
+and presses the color the player's turn waits for, read from Simon's
+sequence in the reply. It misses on purpose once a game reaches --rounds,
+so games keep coming:
+
+    python3 tools/console_bot.py /dev/ttyACM0 --games 5 --rounds 8 --seed 42 --speed 100
+"""
+
+import argparse
+import os
+import re
+import sys
+import termios
+import time
+import tty
+
+# GameState values reported by info
+START, PLAYER_SELECT, ONE_PLAYER, GAME_RESULT, PLAY_AGAIN, SLEEP, WAKE_UP = 1, 3, 4, 6, 7, 8, 9
+MENUS = (START, PLAYER_SELECT, PLAY_AGAIN, SLEEP, WAKE_UP)
+
+
+class Console:
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(self.fd)
+        attrs = termios.tcgetattr(self.fd)
+        attrs[4] = attrs[5] = termios.B9600
+        termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+        self.pending = b""
+
+    def command(self, line):
+        """Send a command and return the fields of its reply."""
+        os.write(self.fd, line.encode() + b"\n")
+        while True:
+            while b"\n" not in self.pending:
+                self.pending += os.read(self.fd, 256)
+            reply, self.pending = self.pending.split(b"\n", 1)
+            # Skip what the firmware logs on the same port, and telemetry
+            # frames of a TELEMETRY=UART build ahead of the reply
+            reply = re.search(r"(ok|err)((?: [^ =]+=\S*)*)$", reply.decode("latin-1").rstrip())
+            if reply and reply.group(1) == "err":
+                sys.exit("board refused: " + line)
+            if reply:
+                return dict(field.split("=", 1) for field in reply.group(2).split())
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("port", help="serial port of the ST-LINK")
+    parser.add_argument("--games", type=int, default=1)
+    parser.add_argument("--rounds", type=int, default=5, help="round the bot misses in")
+    parser.add_argument("--seed", type=int, help="rand() seed, 1 to 4095")
+    parser.add_argument("--speed", type=int, help="length of Simon's notes in ms")
+    args = parser.parse_args()
+
+    console = Console(args.port)
+    if args.seed is not None:
+        console.command("seed %d" % args.seed)
+    if args.speed is not None:
+        console.command("speed %d" % args.speed)
+
+    games = 0
+    playing = False
+    last_press = None
+    while games < args.games:
+        info = console.command("info")
+        state = int(info["state"])
+        if state in MENUS:
+            if playing:
+                games += 1
+                playing = False
+                print("game %d over in round %s" % (games, info["round"]))
+                if games == args.games:
+                    break
+            console.command("joy press")
+            time.sleep(0.3)
+        elif state == ONE_PLAYER:
+            playing = True
+            awaiting = int(info["awaiting"])
+            press = (info["round"], awaiting)
+            if awaiting >= 0 and press != last_press:
+                color = info["seq"][awaiting]
+                if int(info["round"]) >= args.rounds and awaiting == int(info["length"]) - 1:
+                    color = "rbyg"[("rbyg".index(color) + 1) % 4]
+                console.command("press " + color)
+                last_press = press
+        else:
+            time.sleep(0.1)
+
+
+if __name__ == "__main__":
+    main()
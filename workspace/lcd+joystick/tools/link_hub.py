@@ -0,0 +1,318 @@
+#!/usr/bin/env python3
+"""Stand in for the wiring of a LINK=UART build on the host.
+
+The hub opens pseudo-terminals and, optionally, real serial ports, and
+sends every byte received on one endpoint to all the others, as a bus of
+boards would see it. Simulated boards speaking the frame protocol of
+Core/Inc/link.h can join, so one real board has peers to play against:
+
+    python3 tools/link_hub.py --serial /dev/ttyACM0 --boards 2 --play
+    python3 tools/link_hub.py --ptys 2 --boards 1 --seconds 30
+
+Every pty name is printed on start. The simulated boards time the
+acknowledgement of each frame they send and the hub times its own
+forwarding; both are reported on exit, against the 5 ms latency budget.
+"""
+
+import argparse
+import os
+import random
+import select
+import sys
+import termios
+import time
+import tty
+
+SOF = 0x7E
+HEADER = 5
+PAYLOAD_MAX = 32
+HELLO, ACK, START, START_REQ, INPUT, SCORE = range(6)
+TYPE_NAMES = ["HELLO", "ACK", "START", "START_REQ", "INPUT", "SCORE"]
+HELLO_S = 0.5
+PEER_TIMEOUT_S = 1.6
+RETRY_S = 0.02
+RETRIES = 5
+SEQUENCE_MAX = 100
+BUDGET_MS = 5.0
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def frame(node, seq, kind, payload=b""):
+    body = bytes([node, seq, kind, len(payload)]) + bytes(payload)
+    return bytes([SOF]) + body + bytes([crc8(body)])
+
+
+class Decoder:
+    """Byte stream to (node, seq, type, payload) frames, as link.c decodes."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.errors = 0
+
+    def feed(self, data):
+        frames = []
+        for byte in data:
+            if not self.buffer and byte != SOF:
+                continue
+            self.buffer.append(byte)
+            if len(self.buffer) == HEADER and self.buffer[4] > PAYLOAD_MAX:
+                self.errors += 1
+                self.buffer.clear()
+            elif len(self.buffer) > HEADER and len(self.buffer) == HEADER + self.buffer[4] + 1:
+                if crc8(self.buffer[1:-1]) == self.buffer[-1]:
+                    frames.append((self.buffer[1], self.buffer[2], self.buffer[3],
+                                   bytes(self.buffer[HEADER:-1])))
+                else:
+                    self.errors += 1
+                self.buffer.clear()
+        return frames
+
+
+class Board:
+    """A board on the link: heartbeat, election, acknowledged frames and a
+    bot playing the linked games Simon starts."""
+
+    def __init__(self, name, uid, play):
+        self.name = name
+        self.uid = uid
+        self.boot = random.getrandbits(32)   # a new one each run, as the boot count of a board
+        self.node = (uid ^ uid >> 8 ^ uid >> 16 ^ uid >> 24) & 0xFF
+        self.play = play
+        self.decoder = Decoder()
+        self.peers = {}           # node: [uid, last seen, last seq, boot]
+        self.outbox = []          # (type, payload) waiting for their turn
+        self.current = None       # [frame, awaiting nodes, tries, sent at]
+        self.seq = 0
+        self.hello_at = 0.0
+        self.requested_at = 0.0
+        self.game = None          # [sequence, round, index, next press at, last round]
+        self.rtts = []
+        self.lost = 0
+        self.tx = []
+
+    def is_simon(self):
+        return all(peer[0] > self.uid for peer in self.peers.values())
+
+    def send(self, kind, payload=b""):
+        if self.peers:
+            self.outbox.append((kind, bytes(payload)))
+
+    def receive(self, data, now):
+        for node, seq, kind, payload in self.decoder.feed(data):
+            if node == self.node:
+                continue
+            if kind == HELLO:
+                if len(payload) < 8:
+                    continue
+                uid = int.from_bytes(payload[:4], "little")
+                boot = int.from_bytes(payload[4:8], "little")
+                peer = self.peers.get(node)
+                if peer is None or peer[0] != uid or peer[3] != boot:
+                    self.peers[node] = [uid, now, 0, boot]
+                    print("%s: board %08x joined, %d linked, %s" % (self.name, uid, len(self.peers),
+                          "Simon" if self.is_simon() else "follower"))
+                self.peers[node][1] = now
+                continue
+            if node not in self.peers:
+                continue
+            self.peers[node][1] = now
+            if kind == ACK:
+                if self.current and payload[0] == self.node and payload[1] == self.current[0][2]:
+                    if node in self.current[1]:
+                        self.current[1].discard(node)
+                        self.rtts.append((now - self.current[3]) * 1000)
+                continue
+            self.tx.append(frame(self.node, 0, ACK, bytes([node, seq])))
+            if seq == self.peers[node][2]:
+                continue
+            self.peers[node][2] = seq
+            self.deliver(kind, payload, now)
+
+    def deliver(self, kind, payload, now):
+        if kind == START and self.play:
+            if not payload or len(payload) < 1 + (payload[0] + 3) // 4:
+                return   # a bad sequence length, as link.c drops it
+            length = payload[0]
+            sequence = [(payload[1 + i // 4] >> (2 * (i % 4))) & 3 for i in range(length)]
+            self.start(sequence, now)
+        elif kind == START_REQ and self.play and self.is_simon() and self.game is None:
+            self.start_as_simon(now)
+        elif kind == SCORE:
+            print("%s: score %d round %d%s" % (self.name, payload[1] | payload[2] << 8, payload[0],
+                  " final" if payload[3] else ""))
+
+    def start_as_simon(self, now):
+        sequence = [random.randrange(4) for _ in range(SEQUENCE_MAX)]
+        packed = bytearray(1 + (SEQUENCE_MAX + 3) // 4)
+        packed[0] = SEQUENCE_MAX
+        for i, color in enumerate(sequence):
+            packed[1 + i // 4] |= color << (2 * (i % 4))
+        self.send(START, packed)
+        self.start(sequence, now)
+
+    def start(self, sequence, now):
+        print("%s: linked game starts" % self.name)
+        self.game = [sequence, 1, 0, now + 2.0, random.randint(3, 15)]
+
+    def bot(self, now):
+        if not self.play:
+            return
+        if self.game is None:
+            # Followers ask Simon for a game once they have company
+            if self.peers and not self.is_simon() and now - self.requested_at > 5.0:
+                self.requested_at = now
+                self.send(START_REQ)
+            elif self.peers and self.is_simon() and now - self.requested_at > 5.0:
+                self.requested_at = now
+                self.start_as_simon(now)
+            return
+        sequence, round_, index, press_at, last = self.game
+        if now < press_at:
+            return
+        wrong = round_ == last and index == round_ - 1
+        color = (sequence[index] + 1) % 4 if wrong else sequence[index]
+        self.send(INPUT, [round_, index, color])
+        if wrong or index + 1 == round_:
+            score = round_ * (round_ + 1) // 2 - (1 if wrong else 0)
+            self.send(SCORE, [round_, score & 0xFF, score >> 8, 1 if wrong else 0])
+            if wrong:
+                self.game = None
+                self.requested_at = now
+                return
+            self.game = [sequence, round_ + 1, 0, now + 2.0 + 0.5 * round_, last]
+        else:
+            self.game[2] = index + 1
+            self.game[3] = now + 0.3
+
+    def poll(self, now):
+        for node in [node for node, peer in self.peers.items() if now - peer[1] > PEER_TIMEOUT_S]:
+            del self.peers[node]
+            if self.current:
+                self.current[1].discard(node)
+            print("%s: a board left, %d linked" % (self.name, len(self.peers)))
+        if now - self.hello_at >= HELLO_S:
+            self.hello_at = now
+            self.tx.append(frame(self.node, 0, HELLO, self.uid.to_bytes(4, "little") +
+                                 self.boot.to_bytes(4, "little")))
+        self.bot(now)
+
+        # One acknowledged frame on the wire at a time, like link.c
+        while True:
+            if self.current is None:
+                if not self.outbox or not self.peers:
+                    return
+                kind, payload = self.outbox.pop(0)
+                self.seq = self.seq % 255 + 1
+                self.current = [frame(self.node, self.seq, kind, payload), set(self.peers), 0, 0.0]
+            elif not self.current[1]:
+                self.current = None
+                continue
+            elif now - self.current[3] < RETRY_S:
+                return
+            elif self.current[2] > RETRIES:
+                self.lost += 1
+                self.current = None
+                continue
+            self.tx.append(self.current[0])
+            self.current[2] += 1
+            self.current[3] = now
+            return
+
+
+def open_serial(path):
+    fd = os.open(path, os.O_RDWR | os.O_NOCTTY | os.O_NONBLOCK)
+    tty.setraw(fd)
+    attrs = termios.tcgetattr(fd)
+    attrs[4] = attrs[5] = termios.B115200
+    termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def open_pty():
+    master, slave = os.openpty()
+    tty.setraw(slave)
+    os.set_blocking(master, False)
+    return master, os.ttyname(slave)
+
+
+def report(name, samples):
+    if not samples:
+        print("%s: no samples" % name)
+        return
+    samples = sorted(samples)
+    worst = samples[-1]
+    print("%s: n=%d min=%.2fms avg=%.2fms p99=%.2fms max=%.2fms %s" %
+          (name, len(samples), samples[0], sum(samples) / len(samples),
+           samples[int(len(samples) * 0.99)], worst,
+           "within budget" if worst < BUDGET_MS else "OVER %.0f ms budget" % BUDGET_MS))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--serial", action="append", default=[], help="serial port of a board, repeatable")
+    parser.add_argument("--ptys", type=int, default=0, help="pseudo-terminals to open for host programs")
+    parser.add_argument("--boards", type=int, default=0, help="simulated boards to join")
+    parser.add_argument("--play", action="store_true", help="simulated boards play linked games")
+    parser.add_argument("--seconds", type=float, default=0, help="stop after this long, 0 runs until Ctrl-C")
+    parser.add_argument("--seed", type=int, default=None)
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    fds = [open_serial(path) for path in args.serial]
+    for _ in range(args.ptys):
+        master, name = open_pty()
+        print("pty %s" % name)
+        fds.append(master)
+    boards = [Board("sim%d" % i, random.getrandbits(32) or 1, args.play) for i in range(args.boards)]
+    if len(fds) + len(boards) < 2:
+        sys.exit("the hub needs at least two endpoints")
+
+    forwarding = []
+    start = time.monotonic()
+    try:
+        while not args.seconds or time.monotonic() - start < args.seconds:
+            ready, _, _ = select.select(fds, [], [], 0.002)
+            now = time.monotonic()
+            chunks = []
+            for fd in ready:
+                try:
+                    chunks.append((fd, os.read(fd, 512)))
+                except OSError:
+                    pass   # pty with nothing attached yet
+            for board in boards:
+                board.poll(now)
+                chunks.extend((board, data) for data in board.tx)
+                board.tx.clear()
+
+            for source, data in chunks:
+                for fd in fds:
+                    if fd != source:
+                        try:
+                            os.write(fd, data)
+                        except OSError:
+                            pass
+                for board in boards:
+                    if board is not source:
+                        board.receive(data, now)
+                if source in fds:
+                    forwarding.append((time.monotonic() - now) * 1000)
+    except KeyboardInterrupt:
+        pass
+
+    report("hub forwarding", forwarding)
+    for board in boards:
+        report("%s ack round trip" % board.name, board.rtts)
+        if board.lost or board.decoder.errors:
+            print("%s: frames lost=%d rx errors=%d" % (board.name, board.lost, board.decoder.errors))
+
+
+if __name__ == "__main__":
+    main()
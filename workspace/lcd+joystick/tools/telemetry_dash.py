@@ -0,0 +1,197 @@
+#!/usr/bin/env python3
+"""Live dashboard of the telemetry frames of a TELEMETRY=UART build.
+
+Reads the ST-LINK serial port (or a capture file), rebuilds the game state
+from the delta frames of Core/Inc/telemetry.h and redraws it in the
+terminal with a trace of CPU load, input latency and queue depth:
+
+    python3 tools/telemetry_dash.py /dev/ttyACM0
+    python3 tools/telemetry_dash.py /dev/ttyACM0 --csv session.csv
+    python3 tools/telemetry_dash.py capture.bin --once
+
+Text on the same port, from the console or the logs, is skipped.
+"""
+
+import argparse
+import collections
+import os
+import stat
+import sys
+import termios
+import time
+import tty
+
+SOF = 0x7E
+HEADER = 7
+# TelemetryField order and sizes, the scores come last
+FIELDS = [("state", 1), ("round", 1), ("length", 1), ("players", 1), ("player", 1),
+          ("left", 1), ("queue", 1), ("queue_peak", 1), ("dropped", 2), ("tx_queued", 2),
+          ("latency_us", 2), ("latency_max_us", 2), ("load", 2), ("load_10s", 2),
+          ("isr_tim2", 2), ("isr_systick", 2), ("isr_uart", 2), ("isr_i2c", 2),
+          ("max_tim2", 2), ("max_systick", 2), ("max_uart", 2), ("max_i2c", 2),
+          ("jitter_tim2", 2), ("jitter_systick", 2), ("over_budget", 2)]
+SCORES = len(FIELDS)
+STATES = ["WELCOME", "START", "PLAYER_MENU", "PLAYER_SELECT", "ONE_PLAYER", "MULTI_PLAYER",
+          "GAME_RESULT", "PLAY_AGAIN", "SLEEP", "WAKE_UP", "MENU"]
+SPARKS = " .:-=+*#%@"
+HISTORY = 60
+
+
+def crc8(data):
+    crc = 0
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+class Decoder:
+    """Finds frames in the byte stream and applies them to the state."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.values = {}
+        self.scores = []
+        self.synced = False      # a keyframe arrived
+        self.frames = 0
+        self.errors = 0
+        self.lost = 0
+        self.seq = None
+
+    def feed(self, data):
+        self.buffer += data
+        updates = 0
+        while True:
+            start = self.buffer.find(SOF)
+            if start < 0:
+                self.buffer.clear()
+                return updates
+            del self.buffer[:start]
+            if len(self.buffer) < 2:
+                return updates
+            end = 2 + self.buffer[1]
+            if len(self.buffer) < end + 1:
+                return updates
+            if self.buffer[1] < 3 or crc8(self.buffer[1:end]) != self.buffer[end]:
+                # Not a frame, or a damaged one: hunt from the next byte
+                self.errors += 1
+                del self.buffer[:1]
+                continue
+            frame = bytes(self.buffer[:end])
+            del self.buffer[:end + 1]
+            if self.apply(frame):
+                updates += 1
+
+    def apply(self, frame):
+        seq = frame[2]
+        mask = int.from_bytes(frame[3:7], "little")
+        keyframe = mask & ((1 << (SCORES + 1)) - 1) == (1 << (SCORES + 1)) - 1
+        if self.seq is not None and seq != (self.seq + 1) & 0xFF:
+            self.lost += (seq - self.seq - 1) & 0xFF
+            if not keyframe:
+                self.synced = False   # the deltas in between are gone
+        self.seq = seq
+        if keyframe:
+            self.synced = True
+
+        at = HEADER
+        for index, (name, size) in enumerate(FIELDS):
+            if mask & (1 << index):
+                self.values[name] = int.from_bytes(frame[at:at + size], "little")
+                at += size
+        if mask & (1 << SCORES):
+            count = frame[at]
+            self.scores = [int.from_bytes(frame[at + 1 + 2 * i:at + 3 + 2 * i], "little")
+                           for i in range(count)]
+        self.frames += 1
+        return self.synced
+
+
+def open_source(path):
+    fd = os.open(path, os.O_RDONLY | os.O_NOCTTY)
+    if stat.S_ISCHR(os.fstat(fd).st_mode) and os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[4] = attrs[5] = termios.B9600
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return fd
+
+
+def spark(history, top):
+    top = max(top, 1)
+    return "".join(SPARKS[min(len(SPARKS) - 1, value * (len(SPARKS) - 1) // top)] for value in history)
+
+
+def draw(decoder, history):
+    values = decoder.values
+    state = values.get("state", 0)
+    lines = [
+        "Simon telemetry   frames=%d crc errors=%d lost=%d%s" %
+        (decoder.frames, decoder.errors, decoder.lost, "" if decoder.synced else "   waiting for a keyframe"),
+        "",
+        "state   %-14s round %3d   sequence %3d" %
+        (STATES[state] if state < len(STATES) else state, values.get("round", 0), values.get("length", 0)),
+        "players %d  current P%d  left %d   scores %s" %
+        (values.get("players", 0), values.get("player", 0) + 1, values.get("left", 0),
+         " ".join("P%d=%d" % (i + 1, s) for i, s in enumerate(decoder.scores))),
+        "events  queued %2d  peak %2d  dropped %d   USART1 tx queued %d" %
+        (values.get("queue", 0), values.get("queue_peak", 0), values.get("dropped", 0),
+         values.get("tx_queued", 0)),
+        "",
+        "load    %5.1f%%    |%s|  10 s %.1f%%" % (values.get("load", 0) / 10, spark(history["load"], 1000),
+                                              values.get("load_10s", 0) / 10),
+        "        handlers TIM2 %.1f%%  SysTick %.1f%%  UART %.1f%%  I2C %.1f%%" %
+        tuple(values.get(name, 0) / 10 for name in ("isr_tim2", "isr_systick", "isr_uart", "isr_i2c")),
+        "        longest  TIM2 %d us  SysTick %d us  UART %d us  I2C %d us" %
+        tuple(values.get(name, 0) for name in ("max_tim2", "max_systick", "max_uart", "max_i2c")),
+        "        jitter   TIM2 %d us  SysTick %d us   over budget %d%s" %
+        (values.get("jitter_tim2", 0), values.get("jitter_systick", 0), values.get("over_budget", 0),
+         "  !" if values.get("over_budget", 0) else ""),
+        "latency %5d us  |%s|  max %d us" % (values.get("latency_us", 0),
+                                            spark(history["latency_us"], max(history["latency_us"], default=1)),
+                                            values.get("latency_max_us", 0)),
+        "queue   %3d       |%s|" % (values.get("queue", 0),
+                                    spark(history["queue"], max(history["queue"], default=1))),
+    ]
+    sys.stdout.write("\x1b[H\x1b[J" + "\n".join(lines) + "\n")
+    sys.stdout.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("source", help="serial port or capture file")
+    parser.add_argument("--csv", help="append every update to this CSV file")
+    parser.add_argument("--once", action="store_true", help="print the final state at the end of a capture")
+    args = parser.parse_args()
+
+    fd = open_source(args.source)
+    decoder = Decoder()
+    history = {name: collections.deque(maxlen=HISTORY) for name in ("load", "latency_us", "queue")}
+    csv = open(args.csv, "a") if args.csv else None
+    if csv and csv.tell() == 0:
+        csv.write("time," + ",".join(name for name, _ in FIELDS) + ",scores\n")
+
+    try:
+        while True:
+            data = os.read(fd, 256)
+            if not data:
+                break
+            if not decoder.feed(data):
+                continue
+            for name in history:
+                history[name].append(decoder.values.get(name, 0))
+            if csv:
+                csv.write("%.3f,%s,%s\n" % (time.time(), ",".join(str(decoder.values.get(name, 0))
+                                                              for name, _ in FIELDS),
+                                           " ".join(map(str, decoder.scores))))
+            if not args.once:
+                draw(decoder, history)
+    except KeyboardInterrupt:
+        pass
+    if args.once:
+        draw(decoder, history)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,70 @@
+#!/usr/bin/env python3
+"""Turn the trace lines of a USART1 capture into Core/Inc/replaytrace.h.
+
+A VARIANT=TRACE build sends the inputs of each game as lines of
+"trace DDDDVVVV ..." records when the game ends. Capture the serial port
+from power-on, then build VARIANT=REPLAY with the generated header to play
+the session back on virtual time:
+
+    python3 tools/trace2h.py capture.log > Core/Inc/replaytrace.h
+    make -f STM32Make.make VARIANT=REPLAY
+
+On the target, the board needs a game to end before it sends anything;
+capture the ST-LINK virtual COM port, which carries USART1, at 9600 8N1:
+
+    stty -F /dev/ttyACM0 9600 raw && cat /dev/ttyACM0 > capture.log
+
+make -C test/host trace runs the same path without a board: the host
+harness built as VARIANT=TRACE plays TRACE_INPUT, this script turns its
+capture into build/<size>/replaytrace.h and a replay build of it has to
+show the screens the recording showed.
+"""
+
+import sys
+
+TRACE_TYPES = {1: "joy press", 2: "joy up", 3: "joy down", 5: "button",
+               14: "wait", 15: "seed"}
+
+
+def read_records(lines):
+    records = []
+    for line in lines:
+        fields = line.split()
+        if not fields or fields[0] != "trace":
+            continue
+        if fields[1].startswith("dropped="):
+            sys.exit("capture lost records (%s), the replay would diverge" % fields[1])
+        for field in fields[1:]:
+            records.append((int(field[:4], 16), int(field[4:], 16)))
+    return records
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: trace2h.py CAPTURE")
+
+    with open(sys.argv[1], errors="replace") as capture:
+        records = read_records(capture)
+    if not records:
+        sys.exit("no trace lines in " + sys.argv[1])
+
+    print("#ifndef REPLAYTRACE_H")
+    print("#define REPLAYTRACE_H")
+    print()
+    print("// Generated by tools/trace2h.py from %s, %d records"
+          % (sys.argv[1].split("/")[-1], len(records)))
+    print()
+    print('#include "trace.h"')
+    print()
+    print("static const TraceRecord replayTrace[] =")
+    print("{")
+    for delta, value in records:
+        kind = TRACE_TYPES.get(value >> 12, "type %d" % (value >> 12))
+        print("  {%5d, 0x%04x},   // %s %d" % (delta, value, kind, value & 0x0FFF))
+    print("};")
+    print()
+    print("#endif")
+
+
+if __name__ == "__main__":
+    main()